@@ -22,6 +22,7 @@
 #include <QtDebug>
 
 #include <QtKOAuth>
+#include <kqoauthgui.h>
 
 #include "twittercli.h"
 
@@ -156,6 +157,7 @@ void TwitterCLI::showHelp() {
 int main(int argc, char *argv[])
 {
     QCoreApplication app(argc, argv);
+    KQOAuthGui::install();      // Open the authorization page in the browser.
     QCoreApplication::setOrganizationName("kQOAuth");
     QCoreApplication::setApplicationName("TwitterCLI");
 
@@ -9,17 +9,19 @@ CONFIG += kqoauth
 
 macx {
     CONFIG -= app_bundle
+    LIBS += -L../../lib -lkqoauthgui
     QMAKE_POST_LINK += install_name_tool -change kqoauth.framework/Versions/0/kqoauth \
                        ../../lib/kqoauth.framework/Versions/0/kqoauth $${TARGET}
 }
 else:unix {
   # the second argument (after colon) is for
   # being able to run make check from the root source directory
-  LIBS += -L../../lib:lib
+  LIBS += -L../../lib:lib -lkqoauthgui
 } else:windows {
-  LIBS += -L../../lib -lkqoauthd0
+  LIBS += -L../../lib -lkqoauthd0 -lkqoauthguid0
 }
 
+INCLUDEPATH += ../../gui
 #INCLUDEPATH += . ../../src
 HEADERS += twittercli.h
 SOURCES += twittercli.cpp
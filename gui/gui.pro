@@ -0,0 +1,57 @@
+TARGET = kqoauthgui
+DESTDIR = ../lib
+win32:DLLDESTDIR = $${DESTDIR}
+
+VERSION = 0.97
+
+TEMPLATE = lib
+QT += gui network
+CONFIG += \
+    create_prl
+
+!macx: CONFIG += static_and_shared
+
+OBJECTS_DIR = tmp
+MOC_DIR = tmp
+
+INCLUDEPATH += . ../src
+
+HEADERS += kqoauthgui.h
+SOURCES += kqoauthgui.cpp
+
+DEFINES += KQOAUTHGUI
+
+macx {
+    LIBS += -F../lib -framework kqoauth
+}
+else:unix {
+    LIBS += -L../lib -lkqoauth
+}
+else:windows {
+    LIBS += -L../lib -lkqoauthd0
+}
+
+headers.files = kqoauthgui.h
+
+unix:!macx {
+    isEmpty( PREFIX ):INSTALL_PREFIX = /usr
+    else:INSTALL_PREFIX = $${PREFIX}
+
+    contains(QMAKE_HOST.arch, x86_64) {
+      target.path = $${INSTALL_PREFIX}/lib64
+    } else {
+      target.path = $${INSTALL_PREFIX}/lib
+    }
+
+    headers.path = $${INSTALL_PREFIX}/include/QtKOAuth
+    INSTALLS += \
+        target \
+        headers
+}
+
+CONFIG(debug_and_release) {
+    build_pass:CONFIG(debug, debug|release) {
+        unix: TARGET = $$join(TARGET,,,_debug)
+        else: TARGET = $$join(TARGET,,,d)
+    }
+}
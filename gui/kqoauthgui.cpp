@@ -0,0 +1,42 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QDesktopServices>
+#include <QUrl>
+
+#include "kqoauthgui.h"
+#include "kqoauthmanager.h"
+
+namespace
+{
+    struct AutoInstall
+    {
+        AutoInstall() { KQOAuthGui::install(); }
+    };
+
+    AutoInstall autoInstall;
+}
+
+void KQOAuthGui::install() {
+    KQOAuthManager::setAuthorizationUrlOpener(&KQOAuthGui::openUrl);
+}
+
+bool KQOAuthGui::openUrl(const QUrl &url) {
+    return QDesktopServices::openUrl(url);
+}
@@ -0,0 +1,50 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHGUI_H
+#define KQOAUTHGUI_H
+
+#include <QtGlobal>
+
+#if defined(KQOAUTHGUI)
+#  define KQOAUTHGUI_EXPORT Q_DECL_EXPORT
+#else
+#  define KQOAUTHGUI_EXPORT Q_DECL_IMPORT
+#endif
+
+class QUrl;
+
+/**
+ * Optional add-on for desktop applications. Opens the authorization page of
+ * KQOAuthManager::getUserAuthorization() in the user's default browser.
+ *
+ * With the shared library the opener is installed when the library is loaded.
+ * The static library (built next to the shared one on all platforms but Mac)
+ * gets linked in only for the symbols the application uses, and its load-time
+ * initializer is not one of them, so call install() at start-up. Calling it is
+ * safe with the shared library as well.
+ */
+class KQOAUTHGUI_EXPORT KQOAuthGui
+{
+public:
+    static void install();
+    static bool openUrl(const QUrl &url);
+};
+
+#endif // KQOAUTHGUI_H
@@ -1,6 +1,6 @@
 TEMPLATE = subdirs
 
-SUBDIRS += src examples tests
+SUBDIRS += src gui examples tests
 
 CONFIG += ordered
 
@@ -8,3 +8,26 @@ CONFIG += ordered
 # check.commands = ( cd tests/ut_interface && ./ut_interface ) && ( cd tests/ft_interface && ./ft_interface )
 # check.depends = sub-tests
 # QMAKE_EXTRA_TARGETS += check
+
+# 'make benchmark' runs tests/bench_kqoauth and writes the results to bench_kqoauth.xml
+# in the build directory. Keep the file of each release to compare them.
+benchmark.target = benchmark
+benchmark.commands = cd tests/bench_kqoauth && ./bench_kqoauth -xml -o $$OUT_PWD/bench_kqoauth.xml
+benchmark.depends = sub-tests
+QMAKE_EXTRA_TARGETS += benchmark
+
+# 'make startup-benchmark' starts a program linked against the core library only, and one
+# also linked against kqoauthgui, 50 times each and prints their start-up time and memory.
+startup-benchmark.target = startup-benchmark
+startup-benchmark.commands = cd tests/startupprobe && ./startupprobe_core --runs 50 && ./startupprobe_gui --runs 50
+startup-benchmark.depends = sub-tests
+QMAKE_EXTRA_TARGETS += startup-benchmark
+
+# 'make record-budgets' builds tests/ut_allocations, measures the heap use it checks and
+# writes it, plus a margin, to tests/ut_allocations/budgets.txt. Commit the updated file.
+record-budgets.target = record-budgets
+record-budgets.commands = mkdir -p tests/ut_allocations && cd tests/ut_allocations \
+                          && $(QMAKE) $$PWD/tests/ut_allocations/ut_allocations.pro && $(MAKE) \
+                          && KQOAUTH_RECORD_BUDGETS=1 ./ut_allocations
+record-budgets.depends = sub-src
+QMAKE_EXTRA_TARGETS += record-budgets
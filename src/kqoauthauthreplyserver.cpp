@@ -17,15 +17,25 @@
  *  You should have received a copy of the GNU Lesser General Public License
  *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <QMetaObject>
 #include <QTcpSocket>
-#include <QStringList>
-#include <QUrl>
+#include <QTimer>
 
 #include "kqoauthauthreplyserver.h"
 #include "kqoauthauthreplyserver_p.h"
+#include "kqoauthformparser.h"
+#include "kqoauthperthread.h"
+
+namespace
+{
+    KQOAuthAuthReplyServer *createSharedServer() {
+        return new KQOAuthAuthReplyServer(0);
+    }
+}
 
 KQOAuthAuthReplyServerPrivate::KQOAuthAuthReplyServerPrivate(KQOAuthAuthReplyServer *parent):
-    q_ptr(parent)
+    q_ptr(parent),
+    idleTimeout(30 * 1000)
 {
 
 }
@@ -38,50 +48,201 @@ KQOAuthAuthReplyServerPrivate::~KQOAuthAuthReplyServerPrivate()
 void KQOAuthAuthReplyServerPrivate::onIncomingConnection() {
     Q_Q(KQOAuthAuthReplyServer);
 
-    socket = q->nextPendingConnection();
-    connect(socket, SIGNAL(readyRead()),
-            this, SLOT(onBytesReady()), Qt::UniqueConnection);
+    // Browsers often open a few connections at once, so serve them all.
+    while (q->hasPendingConnections()) {
+        QTcpSocket *socket = q->nextPendingConnection();
+        buffers.insert(socket, QByteArray());
+
+        // Browsers keep idle and preconnected sockets open for long, close them ourselves.
+        QTimer *idleTimer = new QTimer(socket);
+        idleTimer->setSingleShot(true);
+        connect(idleTimer, SIGNAL(timeout()), this, SLOT(onIdleTimeout()));
+        idleTimer->start(idleTimeout);
+        idleTimers.insert(socket, idleTimer);
+
+        connect(socket, SIGNAL(readyRead()),
+                this, SLOT(onBytesReady()), Qt::UniqueConnection);
+        connect(socket, SIGNAL(disconnected()),
+                this, SLOT(onDisconnected()), Qt::UniqueConnection);
+    }
 }
 
 void KQOAuthAuthReplyServerPrivate::onBytesReady() {
-    Q_Q(KQOAuthAuthReplyServer);
-    
-    QByteArray reply;
-    QByteArray content;
-    content.append("<HTML></HTML>");
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if (socket == 0 || !buffers.contains(socket)) {
+        return;
+    }
 
-    reply.append("HTTP/1.0 200 OK \r\n");
-    reply.append("Content-Type: text/html; charset=\"utf-8\"\r\n");
-    reply.append(QString("Content-Length: %1\r\n").arg(content.size()));
-    reply.append("\r\n");
-    reply.append(content);
-    socket->write(reply);
-    
-    QByteArray data = socket->readAll();
-    QMultiMap<QString, QString> queryParams = parseQueryParams(&data);
+    buffers[socket].append(socket->readAll());
+    if (processRequests(socket) && idleTimers.contains(socket)) {
+        idleTimers.value(socket)->start(idleTimeout);
+    }
+}
+
+void KQOAuthAuthReplyServerPrivate::onDisconnected() {
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if (socket == 0) {
+        return;
+    }
 
+    buffers.remove(socket);
+    idleTimers.remove(socket);
+    socket->deleteLater();
+}
+
+void KQOAuthAuthReplyServerPrivate::onIdleTimeout() {
+    QTimer *idleTimer = qobject_cast<QTimer *>(sender());
+    QTcpSocket *socket = idleTimer ? qobject_cast<QTcpSocket *>(idleTimer->parent()) : 0;
+    if (socket == 0) {
+        return;
+    }
+
+    buffers.remove(socket);
     socket->disconnectFromHost();
-    q->close();
+}
+
+bool KQOAuthAuthReplyServerPrivate::processRequests(QTcpSocket *socket) {
+    const int maxHeaderSize = 16 * 1024;
+    // Callbacks have no body, anything larger is not a callback.
+    const qint64 maxBodySize = 4 * 1024;
+
+    // The loop handles pipelined requests.
+    for (;;) {
+        QByteArray &buffer = buffers[socket];
+
+        int headerEnd = buffer.indexOf("\r\n\r\n");
+        if (headerEnd < 0) {
+            if (buffer.size() > maxHeaderSize) {
+                writeResponse(socket, "431 Request Header Fields Too Large", QByteArray(), false);
+                return false;
+            }
+            return true;        // Wait for the rest of the header.
+        }
+
+        QList<QByteArray> lines = buffer.left(headerEnd).split('\n');
+        QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+        if (requestLine.size() != 3 || !requestLine.at(2).startsWith("HTTP/1.")) {
+            writeResponse(socket, "400 Bad Request", QByteArray(), false);
+            return false;
+        }
+
+        qint64 contentLength = 0;
+        QByteArray connection;
+        for (int i = 1; i < lines.size(); i++) {
+            int colon = lines.at(i).indexOf(':');
+            if (colon < 0) {
+                continue;
+            }
+
+            QByteArray name = lines.at(i).left(colon).trimmed().toLower();
+            if (name == "content-length") {
+                bool ok = false;
+                contentLength = lines.at(i).mid(colon + 1).trimmed().toLongLong(&ok);
+                if (!ok || contentLength < 0) {
+                    writeResponse(socket, "400 Bad Request", QByteArray(), false);
+                    return false;
+                }
+            } else if (name == "connection") {
+                connection = lines.at(i).mid(colon + 1).trimmed().toLower();
+            }
+        }
+
+        if (contentLength > maxBodySize) {
+            writeResponse(socket, "413 Payload Too Large", QByteArray(), false);
+            return false;
+        }
+
+        // Skip the body, callbacks do not have one.
+        qint64 requestSize = headerEnd + 4 + contentLength;
+        if (buffer.size() < requestSize) {
+            return true;
+        }
+        buffer.remove(0, int(requestSize));
+
+        bool keepAlive = (requestLine.at(2) == "HTTP/1.1")
+                         ? !connection.contains("close")
+                         : connection.contains("keep-alive");
+
+        handleRequest(socket, requestLine.at(0), requestLine.at(1), keepAlive);
+        if (!keepAlive) {
+            return false;
+        }
+    }
+}
+
+void KQOAuthAuthReplyServerPrivate::handleRequest(QTcpSocket *socket, const QByteArray &method,
+                                                  const QByteArray &target, bool keepAlive) {
+    Q_Q(KQOAuthAuthReplyServer);
+
+    bool head = (method == "HEAD");
+    if (method != "GET" && !head) {
+        writeResponse(socket, "405 Method Not Allowed", QByteArray(), keepAlive);
+        return;
+    }
+
+    // Anything but a callback of a pending flow, like favicon.ico, gets a 404. A provider
+    // redirects with 'denied' instead of 'oauth_token' when the user refuses access, and
+    // that too ends the flow.
+    QMultiMap<QString, QString> queryParams = parseQueryParams(target);
+    QString token = queryParams.value("oauth_token");
+    if (token.isEmpty()) {
+        token = queryParams.value("denied");
+    }
+    QHash<QString, QPointer<QObject> >::iterator flow = flows.find(token);
+    if (token.isEmpty() || flow == flows.end() || flow.value().isNull()) {
+        writeResponse(socket, "404 Not Found", QByteArray(), keepAlive, !head);
+        return;
+    }
+
+    writeResponse(socket, "200 OK", QByteArray("<HTML></HTML>"), keepAlive, !head);
+
+    // A HEAD request is not the real callback, the browser will follow with a GET.
+    if (head) {
+        return;
+    }
+
+    QPointer<QObject> receiver = flow.value();
+    flows.erase(flow);
+
+    // Q_ARG() does not cope with the comma in the type name.
+    QMetaObject::invokeMethod(receiver, "onVerificationReceived", Qt::DirectConnection,
+                              QGenericArgument("QMultiMap<QString,QString>", &queryParams));
     emit q->verificationReceived(queryParams);
 }
 
-QMultiMap<QString, QString> KQOAuthAuthReplyServerPrivate::parseQueryParams(QByteArray *data) {
-    QString splitGetLine = QString(*data).split("\r\n").first();   // Retrieve the first line with query params.
-    splitGetLine.remove("GET ");                                   // Clean the line from GET
-    splitGetLine.remove("HTTP/1.1");                               // From HTTP
-    splitGetLine.remove("\r\n");                                   // And from rest.
-    splitGetLine.prepend("http://localhost");                      // Now, make it a URL
+void KQOAuthAuthReplyServerPrivate::writeResponse(QTcpSocket *socket, const QByteArray &status,
+                                                  const QByteArray &content, bool keepAlive, bool withBody) {
+    QByteArray reply;
+    reply.append("HTTP/1.1 " + status + "\r\n");
+    reply.append("Content-Type: text/html; charset=\"utf-8\"\r\n");
+    reply.append("Content-Length: " + QByteArray::number(content.size()) + "\r\n");
+    reply.append(keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n");
+    reply.append("\r\n");
+    if (withBody) {
+        reply.append(content);
+    }
 
-    QUrl getTokenUrl(splitGetLine);
-    QList< QPair<QString, QString> > tokens = getTokenUrl.queryItems();  // Ask QUrl to do our work.
+    socket->write(reply);
+    if (!keepAlive) {
+        buffers.remove(socket);
+        socket->disconnectFromHost();
+    }
+}
 
-    QMultiMap<QString, QString> queryParams;
-    QPair<QString, QString> tokenPair;
-    foreach (tokenPair, tokens) {
-        queryParams.insert(tokenPair.first.trimmed(), tokenPair.second.trimmed());
+QMultiMap<QString, QString> KQOAuthAuthReplyServerPrivate::parseQueryParams(const QByteArray &target) {
+    // The request target is "/path?query", maybe followed by a fragment.
+    int queryStart = target.indexOf('?');
+    if (queryStart < 0) {
+        return QMultiMap<QString, QString>();
     }
+    queryStart++;
 
-    return queryParams;
+    int queryEnd = target.indexOf('#', queryStart);
+    if (queryEnd < 0) {
+        queryEnd = target.size();
+    }
+
+    return KQOAuthFormParser::parseToMap(target.constData() + queryStart, queryEnd - queryStart);
 }
 
 
@@ -102,3 +263,33 @@ KQOAuthAuthReplyServer::~KQOAuthAuthReplyServer()
 }
 
 
+
+KQOAuthAuthReplyServer *KQOAuthAuthReplyServer::sharedServer() {
+    // QTcpServer can only be used from its own thread, hence one per thread.
+    return KQOAuthPerThread<KQOAuthAuthReplyServer>::instance(createSharedServer);
+}
+
+void KQOAuthAuthReplyServer::registerFlow(const QString &token, QObject *receiver) {
+    Q_D(KQOAuthAuthReplyServer);
+    d->flows.insert(token, QPointer<QObject>(receiver));
+}
+
+void KQOAuthAuthReplyServer::unregisterFlow(const QString &token) {
+    Q_D(KQOAuthAuthReplyServer);
+    d->flows.remove(token);
+}
+
+void KQOAuthAuthReplyServer::setIdleTimeout(int milliseconds) {
+    Q_D(KQOAuthAuthReplyServer);
+    d->idleTimeout = milliseconds;
+}
+
+int KQOAuthAuthReplyServer::idleTimeout() const {
+    Q_D(const KQOAuthAuthReplyServer);
+    return d->idleTimeout;
+}
+
+int KQOAuthAuthReplyServer::flowCount() const {
+    Q_D(const KQOAuthAuthReplyServer);
+    return d->flows.size();
+}
@@ -32,6 +32,22 @@ public:
     explicit KQOAuthAuthReplyServer(QObject *parent);
     ~KQOAuthAuthReplyServer();
 
+    // The listener shared by all managers of the calling thread. It is created on first use
+    // and stays bound to one port for the lifetime of the thread. The main thread's one is
+    // deleted with QCoreApplication.
+    static KQOAuthAuthReplyServer *sharedServer();
+
+    // A callback carrying 'token' as its oauth_token, or as 'denied' when the user refused
+    // access, is delivered to the receiver's onVerificationReceived(QMultiMap<QString, QString>)
+    // slot, and the flow is removed. Other requests get a 404.
+    void registerFlow(const QString &token, QObject *receiver);
+    void unregisterFlow(const QString &token);
+    int flowCount() const;
+
+    // Connections that send nothing for this long are closed. Defaults to 30 seconds.
+    void setIdleTimeout(int milliseconds);
+    int idleTimeout() const;
+
 Q_SIGNALS:
     void verificationReceived(QMultiMap<QString, QString>);
 
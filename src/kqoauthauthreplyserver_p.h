@@ -23,26 +23,44 @@
 #define KQOAUTHAUTHREPLYSERVER_P_H
 
 #include "kqoauthauthreplyserver.h"
+#include <QByteArray>
+#include <QHash>
 #include <QMultiMap>
+#include <QPointer>
 #include <QString>
 
+class QTcpSocket;
+class QTimer;
+
 class KQOAUTH_EXPORT KQOAuthAuthReplyServerPrivate: public QObject
 {
     Q_OBJECT
 public:
     KQOAuthAuthReplyServerPrivate( KQOAuthAuthReplyServer * parent );
     ~KQOAuthAuthReplyServerPrivate();
-    QMultiMap<QString, QString> parseQueryParams(QByteArray *sdata);
+    QMultiMap<QString, QString> parseQueryParams(const QByteArray &target);
+
+    // Handles the complete requests in the socket's buffer. Returns false if the
+    // connection is being closed.
+    bool processRequests(QTcpSocket *socket);
+    void handleRequest(QTcpSocket *socket, const QByteArray &method, const QByteArray &target, bool keepAlive);
+    void writeResponse(QTcpSocket *socket, const QByteArray &status, const QByteArray &content,
+                       bool keepAlive, bool withBody = true);
 
 public Q_SLOTS:
     void onIncomingConnection();
     void onBytesReady();
+    void onDisconnected();
+    void onIdleTimeout();
 
 public:
     KQOAuthAuthReplyServer * q_ptr;
     Q_DECLARE_PUBLIC(KQOAuthAuthReplyServer);
-    QTcpSocket *socket;
 
+    QHash<QTcpSocket *, QByteArray> buffers;      // Unprocessed input of each connection.
+    QHash<QString, QPointer<QObject> > flows;     // oauth_tokens waiting for their callback.
+    QHash<QTcpSocket *, QTimer *> idleTimers;     // Owned by their sockets.
+    int idleTimeout;
 };
 
 #endif // KQOAUTHAUTHREPLYSERVER_P_H
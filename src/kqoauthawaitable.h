@@ -0,0 +1,115 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHAWAITABLE_H
+#define KQOAUTHAWAITABLE_H
+
+#include "kqoauthmanager.h"
+
+/**
+ * Completion state of a request awaited with co_await manager->send(). It lives in the
+ * awaitable, and so in the coroutine frame; the manager keeps a pointer to it while the
+ * request is in flight. Not meant to be used directly.
+ */
+struct KQOAuthAwaitState
+{
+    KQOAuthAwaitState() : manager(0), networkReply(0), finished(false), resume(0), context(0) {}
+
+    // Called by the manager when the reply arrives, or with ManagerError when the manager
+    // is destroyed first.
+    void complete(KQOAuthManager::KQOAuthError error, const KQOAuthManager::KQOAuthReply *result = 0) {
+        manager = 0;
+        networkReply = 0;
+        if (result) {
+            reply = *result;
+        }
+        reply.error = error;
+        finished = true;
+        if (resume) {
+            resume(context);
+        }
+    }
+
+    KQOAuthManager *manager;            // Set while the manager holds on to this state.
+    QNetworkReply *networkReply;
+    KQOAuthManager::KQOAuthReply reply;
+    bool finished;
+    void (*resume)(void *context);      // Set while a coroutine waits for the reply.
+    void *context;
+};
+
+#ifdef KQOAUTH_HAVE_COROUTINES
+
+#include <coroutine>
+
+/**
+ * Awaitable returned by KQOAuthManager::send().
+ *
+ * The completion state is kept in the awaitable itself, so awaiting a request allocates
+ * nothing besides the coroutine frame. The awaitable can be kept and awaited later, also
+ * after the request has finished, but it can be neither copied nor moved, since the
+ * manager points to it. Await it in the manager's thread. If the manager is destroyed
+ * while the coroutine waits, the coroutine is resumed with ManagerError.
+ */
+class KQOAuthReplyAwaitable
+{
+public:
+    KQOAuthReplyAwaitable(KQOAuthManager *manager, KQOAuthRequest *request, const QVariant &userData) {
+        manager->awaitRequest(request, userData, &state);
+    }
+
+    ~KQOAuthReplyAwaitable() {
+        // Destroyed before the reply arrived, like a coroutine destroyed while it waits.
+        if (state.manager) {
+            state.manager->forgetAwaitState(&state);
+        }
+    }
+
+    bool await_ready() const {
+        return state.finished;
+    }
+
+    void await_suspend(std::coroutine_handle<> awaiting) {
+        state.resume = &KQOAuthReplyAwaitable::resume;
+        state.context = awaiting.address();
+    }
+
+    KQOAuthManager::KQOAuthReply await_resume() const {
+        return state.reply;
+    }
+
+private:
+    KQOAuthReplyAwaitable(const KQOAuthReplyAwaitable &) = delete;
+    KQOAuthReplyAwaitable &operator=(const KQOAuthReplyAwaitable &) = delete;
+
+    static void resume(void *context) {
+        std::coroutine_handle<>::from_address(context).resume();
+    }
+
+    KQOAuthAwaitState state;
+};
+
+inline KQOAuthReplyAwaitable KQOAuthManager::send(KQOAuthRequest *request, const QVariant& userData) {
+    // Returned without a copy or a move, which C++17 guarantees.
+    return KQOAuthReplyAwaitable(this, request, userData);
+}
+
+#endif // KQOAUTH_HAVE_COROUTINES
+
+#endif // KQOAUTHAWAITABLE_H
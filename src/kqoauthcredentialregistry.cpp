@@ -0,0 +1,149 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QtDebug>
+
+#include "kqoauthcredentialregistry.h"
+#include "kqoauthcredentialregistry_p.h"
+#include "kqoauthutils.h"
+
+/////////////// Credential handle ////////////////
+
+KQOAuthCredentials::KQOAuthCredentials()
+{
+
+}
+
+KQOAuthCredentials::KQOAuthCredentials(KQOAuthCredentialEntry *entry) :
+    d(entry)
+{
+
+}
+
+KQOAuthCredentials::KQOAuthCredentials(const KQOAuthCredentials &other) :
+    d(other.d)
+{
+
+}
+
+KQOAuthCredentials &KQOAuthCredentials::operator=(const KQOAuthCredentials &other) {
+    d = other.d;
+    return *this;
+}
+
+KQOAuthCredentials::~KQOAuthCredentials()
+{
+
+}
+
+bool KQOAuthCredentials::isValid() const {
+    return d;
+}
+
+QString KQOAuthCredentials::consumerKey() const {
+    if (!d) {
+        return QString();
+    }
+
+    return QString::fromUtf8(d->data.constData(), d->tokenOffset);
+}
+
+QString KQOAuthCredentials::token() const {
+    if (!d) {
+        return QString();
+    }
+
+    return QString::fromUtf8(d->data.constData() + d->tokenOffset, d->signingKeyOffset - d->tokenOffset);
+}
+
+QByteArray KQOAuthCredentials::signingKey() const {
+    if (!d) {
+        return QByteArray();
+    }
+
+    return d->data.mid(d->signingKeyOffset);
+}
+
+/////////////// Registry ////////////////
+
+KQOAuthCredentialRegistry::KQOAuthCredentialRegistry() :
+    d_ptr(new KQOAuthCredentialRegistryPrivate)
+{
+
+}
+
+KQOAuthCredentialRegistry::~KQOAuthCredentialRegistry()
+{
+    delete d_ptr;
+}
+
+void KQOAuthCredentialRegistry::insert(const QString &userId,
+                                       const QString &consumerKey, const QString &consumerSecret,
+                                       const QString &token, const QString &tokenSecret) {
+    Q_D(KQOAuthCredentialRegistry);
+
+    QByteArray consumerKeyBytes = consumerKey.toUtf8();
+    QByteArray tokenBytes = token.toUtf8();
+    QByteArray signingKey = KQOAuthUtils::hmac_sha1_key(consumerSecret, tokenSecret);
+
+    if (consumerKeyBytes.size() + tokenBytes.size() > 0xffff) {
+        qWarning() << "Consumer key and token are too long. Cannot add credentials for" << userId;
+        return;
+    }
+
+    KQOAuthCredentialEntry *entry = new KQOAuthCredentialEntry;
+    entry->data.reserve(consumerKeyBytes.size() + tokenBytes.size() + signingKey.size());
+    entry->data.append(consumerKeyBytes);
+    entry->data.append(tokenBytes);
+    entry->data.append(signingKey);
+    entry->tokenOffset = consumerKeyBytes.size();
+    entry->signingKeyOffset = consumerKeyBytes.size() + tokenBytes.size();
+
+    d->entries.insert(userId, QExplicitlySharedDataPointer<KQOAuthCredentialEntry>(entry));
+}
+
+bool KQOAuthCredentialRegistry::remove(const QString &userId) {
+    Q_D(KQOAuthCredentialRegistry);
+    return d->entries.remove(userId) > 0;
+}
+
+void KQOAuthCredentialRegistry::clear() {
+    Q_D(KQOAuthCredentialRegistry);
+    d->entries.clear();
+}
+
+void KQOAuthCredentialRegistry::reserve(int size) {
+    Q_D(KQOAuthCredentialRegistry);
+    d->entries.reserve(size);
+}
+
+bool KQOAuthCredentialRegistry::contains(const QString &userId) const {
+    Q_D(const KQOAuthCredentialRegistry);
+    return d->entries.contains(userId);
+}
+
+int KQOAuthCredentialRegistry::count() const {
+    Q_D(const KQOAuthCredentialRegistry);
+    return d->entries.count();
+}
+
+KQOAuthCredentials KQOAuthCredentialRegistry::credentials(const QString &userId) const {
+    Q_D(const KQOAuthCredentialRegistry);
+    return KQOAuthCredentials(d->entries.value(userId).data());
+}
@@ -0,0 +1,95 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHCREDENTIALREGISTRY_H
+#define KQOAUTHCREDENTIALREGISTRY_H
+
+#include <QExplicitlySharedDataPointer>
+#include <QString>
+
+#include "kqoauthglobals.h"
+
+class KQOAuthCredentialEntry;
+class KQOAuthCredentialRegistryPrivate;
+
+/**
+ * Handle to the credentials of one user in a KQOAuthCredentialRegistry. Handles
+ * are cheap to copy and stay usable even if the user is removed from the registry.
+ * Pass the handle to KQOAuthManager::sendAuthorizedRequest().
+ */
+class KQOAUTH_EXPORT KQOAuthCredentials
+{
+public:
+    KQOAuthCredentials();
+    KQOAuthCredentials(const KQOAuthCredentials &other);
+    KQOAuthCredentials &operator=(const KQOAuthCredentials &other);
+    ~KQOAuthCredentials();
+
+    // False for the default constructed handle, or if the user was not found.
+    bool isValid() const;
+
+    QString consumerKey() const;
+    QString token() const;
+
+private:
+    explicit KQOAuthCredentials(KQOAuthCredentialEntry *entry);
+
+    // The prepared HMAC-SHA1 key of the consumer and token secrets.
+    QByteArray signingKey() const;
+
+    QExplicitlySharedDataPointer<KQOAuthCredentialEntry> d;
+
+    friend class KQOAuthCredentialRegistry;
+    friend class KQOAuthManager;
+};
+
+/**
+ * Keeps the OAuth credentials of many users, keyed by a user id of your choice.
+ * Lookups are constant time, and the HMAC-SHA1 signing key of each user is computed
+ * once when the user is inserted. The secrets themselves are not kept.
+ *
+ * The registry is not thread safe.
+ */
+class KQOAUTH_EXPORT KQOAuthCredentialRegistry
+{
+public:
+    KQOAuthCredentialRegistry();
+    ~KQOAuthCredentialRegistry();
+
+    // Replaces the credentials if the user already exists.
+    void insert(const QString &userId,
+                const QString &consumerKey, const QString &consumerSecret,
+                const QString &token, const QString &tokenSecret);
+    bool remove(const QString &userId);
+    void clear();
+    void reserve(int size);
+
+    bool contains(const QString &userId) const;
+    int count() const;
+
+    // Returns an invalid handle if the user is not in the registry.
+    KQOAuthCredentials credentials(const QString &userId) const;
+
+private:
+    KQOAuthCredentialRegistryPrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(KQOAuthCredentialRegistry);
+    Q_DISABLE_COPY(KQOAuthCredentialRegistry);
+};
+
+#endif // KQOAUTHCREDENTIALREGISTRY_H
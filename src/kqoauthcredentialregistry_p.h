@@ -0,0 +1,47 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHCREDENTIALREGISTRY_P_H
+#define KQOAUTHCREDENTIALREGISTRY_P_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QSharedData>
+#include <QString>
+
+#include "kqoauthcredentialregistry.h"
+
+// Credentials of one user. Everything is packed in one buffer, so an entry costs
+// a single allocation besides the entry itself:
+// consumer key (UTF-8) | token (UTF-8) | signing key
+class KQOAuthCredentialEntry : public QSharedData
+{
+public:
+    QByteArray data;
+    quint16 tokenOffset;
+    quint16 signingKeyOffset;
+};
+
+class KQOAuthCredentialRegistryPrivate
+{
+public:
+    QHash<QString, QExplicitlySharedDataPointer<KQOAuthCredentialEntry> > entries;
+};
+
+#endif // KQOAUTHCREDENTIALREGISTRY_P_H
@@ -0,0 +1,176 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QByteArray>
+
+#include "kqoauthformparser.h"
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#  define KQOAUTH_SSE2_SCAN
+#  include <emmintrin.h>
+#endif
+
+namespace
+{
+    inline bool isSpecial(char c) {
+        return c == '&' || c == '=' || c == '%';
+    }
+
+    // Returns the first '&', '=' or '%' in [begin, end), or end.
+    const char *findSpecial(const char *begin, const char *end) {
+        const char *p = begin;
+
+#ifdef KQOAUTH_SSE2_SCAN
+        const __m128i ampersand = _mm_set1_epi8('&');
+        const __m128i equals = _mm_set1_epi8('=');
+        const __m128i percent = _mm_set1_epi8('%');
+
+        while (end - p >= 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, ampersand),
+                                                     _mm_cmpeq_epi8(chunk, equals)),
+                                        _mm_cmpeq_epi8(chunk, percent));
+            int mask = _mm_movemask_epi8(hits);
+            if (mask != 0) {
+                return p + __builtin_ctz(mask);
+            }
+            p += 16;
+        }
+#endif
+
+        while (p < end && !isSpecial(*p)) {
+            p++;
+        }
+
+        return p;
+    }
+
+    inline int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+}
+
+void KQOAuthFormParser::parse(const char *data, int size, KQOAuthFormFields *fields) {
+    const char *end = data + size;
+    const char *p = data;
+
+    KQOAuthFormField field;
+    field.key = p;
+    field.value = 0;
+    field.keyEncoded = false;
+    field.valueEncoded = false;
+
+    for (;;) {
+        const char *special = findSpecial(p, end);
+
+        if (special != end && *special == '%') {
+            if (field.value) {
+                field.valueEncoded = true;
+            } else {
+                field.keyEncoded = true;
+            }
+            p = special + 1;
+            continue;
+        }
+
+        if (special != end && *special == '=') {
+            // Only the first '=' separates the key, the rest belong to the value.
+            if (!field.value) {
+                field.keyLength = special - field.key;
+                field.value = special + 1;
+            }
+            p = special + 1;
+            continue;
+        }
+
+        // End of the field.
+        if (field.value) {
+            field.valueLength = special - field.value;
+        } else {
+            field.keyLength = special - field.key;
+            field.value = special;
+            field.valueLength = 0;
+        }
+
+        if (field.keyLength > 0 || field.valueLength > 0) {
+            fields->append(field);
+        }
+
+        if (special == end) {
+            break;
+        }
+
+        p = special + 1;
+        field.key = p;
+        field.value = 0;
+        field.keyEncoded = false;
+        field.valueEncoded = false;
+    }
+}
+
+QString KQOAuthFormParser::decode(const char *data, int size, bool encoded) {
+    if (!encoded) {
+        return QString::fromUtf8(data, size);
+    }
+
+    QByteArray decoded;
+    decoded.resize(size);
+    char *out = decoded.data();
+
+    for (int i = 0; i < size; i++) {
+        int high, low;
+        if (data[i] == '%' && i + 2 < size
+            && (high = hexValue(data[i + 1])) >= 0 && (low = hexValue(data[i + 2])) >= 0) {
+            *out++ = static_cast<char>((high << 4) | low);
+            i += 2;
+        } else {
+            // Malformed escapes are kept as they are.
+            *out++ = data[i];
+        }
+    }
+
+    return QString::fromUtf8(decoded.constData(), out - decoded.constData());
+}
+
+QString KQOAuthFormParser::key(const KQOAuthFormField &field) {
+    return decode(field.key, field.keyLength, field.keyEncoded);
+}
+
+QString KQOAuthFormParser::value(const KQOAuthFormField &field) {
+    return decode(field.value, field.valueLength, field.valueEncoded);
+}
+
+QMultiMap<QString, QString> KQOAuthFormParser::parseToMap(const QByteArray &data) {
+    return parseToMap(data.constData(), data.size());
+}
+
+QMultiMap<QString, QString> KQOAuthFormParser::parseToMap(const char *data, int size) {
+    KQOAuthFormFields fields;
+    parse(data, size, &fields);
+
+    QMultiMap<QString, QString> result;
+    for (int i = 0; i < fields.size(); i++) {
+        result.insert(key(fields.at(i)), value(fields.at(i)));
+    }
+
+    return result;
+}
@@ -0,0 +1,67 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHFORMPARSER_H
+#define KQOAUTHFORMPARSER_H
+
+#include <QMultiMap>
+#include <QString>
+#include <QVarLengthArray>
+
+#include "kqoauthglobals.h"
+
+class QByteArray;
+
+// One 'key=value' pair of a form-urlencoded string. The views point into the parsed
+// buffer and are valid as long as it is.
+struct KQOAuthFormField
+{
+    const char *key;
+    int keyLength;
+    const char *value;
+    int valueLength;
+    bool keyEncoded;        // Contains percent escapes.
+    bool valueEncoded;
+};
+
+typedef QVarLengthArray<KQOAuthFormField, 8> KQOAuthFormFields;
+
+/**
+ * Single pass parser for application/x-www-form-urlencoded data, such as token
+ * responses and callback query strings. The buffer is scanned for '&', '=' and '%'
+ * 16 bytes at a time where SSE2 is available. Fields are returned as views and
+ * only decoded on demand; decoded bytes are interpreted as UTF-8.
+ * '+' is not turned into a space, since OAuth values are percent encoded.
+ */
+class KQOAUTH_EXPORT KQOAuthFormParser
+{
+public:
+    // Appends the non-empty fields of 'data' to 'fields'.
+    static void parse(const char *data, int size, KQOAuthFormFields *fields);
+
+    static QString decode(const char *data, int size, bool encoded);
+    static QString key(const KQOAuthFormField &field);
+    static QString value(const KQOAuthFormField &field);
+
+    // Convenience for callers that want the decoded fields in a map.
+    static QMultiMap<QString, QString> parseToMap(const QByteArray &data);
+    static QMultiMap<QString, QString> parseToMap(const char *data, int size);
+};
+
+#endif // KQOAUTHFORMPARSER_H
@@ -28,6 +28,19 @@
 #  define KQOAUTH_EXPORT Q_DECL_IMPORT
 #endif
 
+// Set when the compiler supports C++20 coroutines. Enables KQOAuthManager::send().
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#  define KQOAUTH_HAVE_COROUTINES
+#endif
+
+// Set when QtNetwork can save and restore TLS sessions. Enables KQOAuthSessionCache.
+#if QT_VERSION >= 0x050200
+#  include <QtNetwork/qtnetworkglobal.h>
+#endif
+#if QT_VERSION >= 0x050200 && !defined(QT_NO_SSL)
+#  define KQOAUTH_HAVE_SESSION_TICKETS
+#endif
+
 //////////// Static constant definitions ///////////
 const QString OAUTH_KEY_CONSUMER("oauth_consumer");
 const QString OAUTH_KEY_CONSUMER_KEY("oauth_consumer_key");
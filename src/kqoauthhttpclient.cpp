@@ -0,0 +1,735 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QMetaObject>
+#include <QtDebug>
+
+#include <string.h>
+
+#ifndef QT_NO_SSL
+#include <QSslSocket>
+#endif
+
+#include "kqoauthhttpclient.h"
+
+namespace
+{
+    const int defaultMaximumConnections = 6;
+    const int defaultPipeliningDepth = 4;
+
+    QNetworkReply::NetworkError errorFromSocket(QAbstractSocket::SocketError error) {
+        switch (error) {
+        case QAbstractSocket::ConnectionRefusedError:
+            return QNetworkReply::ConnectionRefusedError;
+        case QAbstractSocket::RemoteHostClosedError:
+            return QNetworkReply::RemoteHostClosedError;
+        case QAbstractSocket::HostNotFoundError:
+            return QNetworkReply::HostNotFoundError;
+        case QAbstractSocket::SocketTimeoutError:
+            return QNetworkReply::TimeoutError;
+        case QAbstractSocket::SslHandshakeFailedError:
+            return QNetworkReply::SslHandshakeFailedError;
+        default:
+            return QNetworkReply::UnknownNetworkError;
+        }
+    }
+
+    bool isHopByHopHeader(const QByteArray &name) {
+        return qstricmp(name.constData(), "host") == 0
+            || qstricmp(name.constData(), "connection") == 0
+            || qstricmp(name.constData(), "content-length") == 0;
+    }
+}
+
+/////////////// KQOAuthHttpReply ////////////////
+
+KQOAuthHttpReply::KQOAuthHttpReply(QNetworkAccessManager::Operation operation,
+                                   const QNetworkRequest &request, KQOAuthHttpClient *client) :
+    QNetworkReply(client),
+    client(client),
+    connection(0),
+    readOffset(0),
+    responseStarted(false),
+    retried(false),
+    done(false)
+{
+    setOperation(operation);
+    setRequest(request);
+    setUrl(request.url());
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+KQOAuthHttpReply::~KQOAuthHttpReply() {
+    if (client && !done) {
+        client->remove(this);
+    }
+}
+
+void KQOAuthHttpReply::abort() {
+    if (done) {
+        return;
+    }
+
+    if (client) {
+        client->remove(this);
+    }
+
+    fail(QNetworkReply::OperationCanceledError, "Operation canceled");
+}
+
+qint64 KQOAuthHttpReply::bytesAvailable() const {
+    // Like readData(), nothing before the whole response is in.
+    if (!done) {
+        return 0;
+    }
+
+    return content.size() - readOffset + QNetworkReply::bytesAvailable();
+}
+
+bool KQOAuthHttpReply::isSequential() const {
+    return true;
+}
+
+qint64 KQOAuthHttpReply::readData(char *data, qint64 maxSize) {
+    // Nothing is readable before the whole response is in.
+    if (!done) {
+        return 0;
+    }
+
+    qint64 count = qMin(maxSize, content.size() - readOffset);
+    if (count <= 0) {
+        return -1;
+    }
+
+    memcpy(data, content.constData() + readOffset, count);
+    readOffset += count;
+    return count;
+}
+
+bool KQOAuthHttpReply::isIdempotent() const {
+    return operation() == QNetworkAccessManager::GetOperation
+        || operation() == QNetworkAccessManager::HeadOperation;
+}
+
+void KQOAuthHttpReply::setResponseHeader(const QByteArray &name, const QByteArray &value) {
+    // Also sets the known headers, like ContentTypeHeader.
+    setRawHeader(name, value);
+}
+
+void KQOAuthHttpReply::finish(int statusCode, const QByteArray &reasonPhrase) {
+    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, statusCode);
+    setAttribute(QNetworkRequest::HttpReasonPhraseAttribute, reasonPhrase);
+    if (statusCode >= 400) {
+        setError(KQOAuthTransport::errorForStatusCode(statusCode), QString::fromLatin1(reasonPhrase));
+    }
+
+    done = true;
+    connection = 0;
+    QMetaObject::invokeMethod(this, "emitSignals", Qt::QueuedConnection);
+}
+
+void KQOAuthHttpReply::fail(QNetworkReply::NetworkError code, const QString &message) {
+    if (done) {
+        return;
+    }
+
+    setError(code, message);
+    done = true;
+    connection = 0;
+    QMetaObject::invokeMethod(this, "emitSignals", Qt::QueuedConnection);
+}
+
+// Always emitted from the event loop, like QNetworkAccessManager does, so the caller can
+// connect to the reply after get() or post() has returned.
+void KQOAuthHttpReply::emitSignals() {
+    setFinished(true);
+
+    if (error() != QNetworkReply::NoError) {
+#if QT_VERSION >= 0x050f00
+        emit errorOccurred(error());
+#endif
+#if QT_VERSION < 0x060000
+        emit error(error());
+#endif
+    }
+
+    if (!content.isEmpty()) {
+        emit readyRead();
+    }
+    emit finished();
+}
+
+/////////////// KQOAuthHttpConnection ////////////////
+
+KQOAuthHttpConnection::KQOAuthHttpConnection(KQOAuthHttpClient *client, const QString &hostKey) :
+    QObject(client),
+    hostKey(hostKey),
+    socket(0),
+    served(0),
+    client(client),
+    ready(false),
+    keepAlive(true),
+    closing(false),
+    state(StatusLine),
+    position(0),
+    chunked(false),
+    statusCode(0),
+    remaining(-1)
+{
+
+}
+
+KQOAuthHttpConnection::~KQOAuthHttpConnection() {
+    // The socket is a child of this connection. The replies are not ours to touch here.
+}
+
+void KQOAuthHttpConnection::connectToHost(const QUrl &url) {
+#ifndef QT_NO_SSL
+    if (url.scheme() == "https") {
+        QSslSocket *sslSocket = new QSslSocket(this);
+        socket = sslSocket;
+        connect(sslSocket, SIGNAL(encrypted()), this, SLOT(onReady()));
+        sslSocket->connectToHostEncrypted(url.host(), url.port(443));
+    } else
+#endif
+    {
+        socket = new QTcpSocket(this);
+        connect(socket, SIGNAL(connected()), this, SLOT(onReady()));
+        socket->connectToHost(url.host(), url.port(80));
+    }
+
+    connect(socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+    connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+#if QT_VERSION >= 0x060000
+    connect(socket, SIGNAL(errorOccurred(QAbstractSocket::SocketError)),
+            this, SLOT(onError(QAbstractSocket::SocketError)));
+#else
+    connect(socket, SIGNAL(error(QAbstractSocket::SocketError)),
+            this, SLOT(onError(QAbstractSocket::SocketError)));
+#endif
+}
+
+bool KQOAuthHttpConnection::isIdle() const {
+    return !closing && inFlight.isEmpty();
+}
+
+// Only once the server has shown it keeps the connection open, and never behind a POST.
+bool KQOAuthHttpConnection::canPipeline(int depth) const {
+    if (closing || !keepAlive || served == 0 || inFlight.size() >= depth) {
+        return false;
+    }
+
+    foreach (KQOAuthHttpReply *reply, inFlight) {
+        if (!reply->isIdempotent()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void KQOAuthHttpConnection::send(KQOAuthHttpReply *reply) {
+    inFlight.append(reply);
+    reply->connection = this;
+
+    if (ready) {
+        socket->write(reply->head);
+        if (!reply->outgoing.isEmpty()) {
+            socket->write(reply->outgoing);
+        }
+    }
+}
+
+// A written request cannot be taken back, and its response would be read as the response
+// to the next one, so the connection is dropped.
+void KQOAuthHttpConnection::detach(KQOAuthHttpReply *reply) {
+    inFlight.removeAll(reply);
+    reply->connection = 0;
+    close(QNetworkReply::OperationCanceledError, "Operation canceled", true);
+}
+
+void KQOAuthHttpConnection::onReady() {
+    ready = true;
+    socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+    foreach (KQOAuthHttpReply *reply, inFlight) {
+        socket->write(reply->head);
+        if (!reply->outgoing.isEmpty()) {
+            socket->write(reply->outgoing);
+        }
+    }
+}
+
+void KQOAuthHttpConnection::onReadyRead() {
+    if (closing) {
+        return;
+    }
+
+    buffer.append(socket->readAll());
+    if (parse()) {
+        buffer.remove(0, position);
+        position = 0;
+    }
+}
+
+void KQOAuthHttpConnection::onDisconnected() {
+    if (closing) {
+        return;
+    }
+
+    // A response without a length ends with the connection.
+    if (state == BodyUntilClose && !inFlight.isEmpty()) {
+        completeResponse();
+    }
+
+    close(QNetworkReply::RemoteHostClosedError, "Connection closed");
+}
+
+void KQOAuthHttpConnection::onError(QAbstractSocket::SocketError error) {
+    // Handled in onDisconnected().
+    if (closing || error == QAbstractSocket::RemoteHostClosedError) {
+        return;
+    }
+
+    close(errorFromSocket(error), socket->errorString());
+}
+
+// Returns false if the connection was closed while parsing.
+bool KQOAuthHttpConnection::parse() {
+    forever {
+        if (state == BodyUntilClose) {
+            inFlight.first()->content.append(buffer.constData() + position, buffer.size() - position);
+            position = buffer.size();
+            return true;
+        }
+
+        if (state == Body || state == ChunkData) {
+            qint64 count = qMin<qint64>(remaining, buffer.size() - position);
+            inFlight.first()->content.append(buffer.constData() + position, count);
+            position += count;
+            remaining -= count;
+            if (remaining > 0) {
+                return true;
+            }
+
+            if (state == ChunkData) {
+                state = ChunkSize;
+            } else if (!completeResponse()) {
+                return false;
+            }
+            continue;
+        }
+
+        // The rest of the states are line based.
+        int end = buffer.indexOf("\r\n", position);
+        if (end < 0) {
+            return true;
+        }
+        QByteArray line = buffer.mid(position, end - position);
+        position = end + 2;
+
+        switch (state) {
+        case StatusLine: {
+            if (inFlight.isEmpty() || !line.startsWith("HTTP/1.") || line.size() < 12) {
+                close(QNetworkReply::ProtocolFailure, "Invalid HTTP response");
+                return false;
+            }
+
+            // HTTP/1.0 closes the connection unless told otherwise.
+            keepAlive = line.at(7) == '1';
+            int space = line.indexOf(' ', 9);
+            statusCode = line.mid(9, space < 0 ? -1 : space - 9).toInt();
+            reasonPhrase = space < 0 ? QByteArray() : line.mid(space + 1);
+            chunked = false;
+            remaining = -1;
+            inFlight.first()->responseStarted = true;
+            state = Headers;
+            break;
+        }
+
+        case Headers: {
+            if (!line.isEmpty()) {
+                int colon = line.indexOf(':');
+                if (colon <= 0) {
+                    break;
+                }
+
+                QByteArray name = line.left(colon).trimmed();
+                QByteArray value = line.mid(colon + 1).trimmed();
+                if (qstricmp(name.constData(), "content-length") == 0) {
+                    remaining = value.toLongLong();
+                } else if (qstricmp(name.constData(), "transfer-encoding") == 0) {
+                    chunked = value.toLower().contains("chunked");
+                } else if (qstricmp(name.constData(), "connection") == 0) {
+                    QByteArray token = value.toLower();
+                    if (token.contains("close")) {
+                        keepAlive = false;
+                    } else if (token.contains("keep-alive")) {
+                        keepAlive = true;
+                    }
+                }
+
+                inFlight.first()->setResponseHeader(name, value);
+                break;
+            }
+
+            // End of the headers. Interim responses, like 100 Continue, are skipped.
+            if (statusCode >= 100 && statusCode < 200) {
+                state = StatusLine;
+                break;
+            }
+
+            if (inFlight.first()->operation() == QNetworkAccessManager::HeadOperation
+                || statusCode == 204 || statusCode == 304 || remaining == 0) {
+                if (!completeResponse()) {
+                    return false;
+                }
+            } else if (chunked) {
+                state = ChunkSize;
+            } else if (remaining > 0) {
+                state = Body;
+            } else {
+                keepAlive = false;
+                state = BodyUntilClose;
+            }
+            break;
+        }
+
+        case ChunkSize: {
+            // The line break after the data of the previous chunk.
+            if (line.isEmpty()) {
+                break;
+            }
+
+            int extension = line.indexOf(';');
+            bool ok = false;
+            remaining = line.left(extension).trimmed().toLongLong(&ok, 16);
+            if (!ok || remaining < 0) {
+                close(QNetworkReply::ProtocolFailure, "Invalid chunk size");
+                return false;
+            }
+
+            state = remaining == 0 ? ChunkTrailer : ChunkData;
+            break;
+        }
+
+        case ChunkTrailer:
+            if (line.isEmpty() && !completeResponse()) {
+                return false;
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+// Returns false if the connection was closed, since it is not kept alive.
+bool KQOAuthHttpConnection::completeResponse() {
+    KQOAuthHttpReply *reply = inFlight.takeFirst();
+    reply->finish(statusCode, reasonPhrase);
+    served++;
+
+    state = StatusLine;
+    remaining = -1;
+
+    if (!keepAlive) {
+        close(QNetworkReply::RemoteHostClosedError, "Connection closed");
+        return false;
+    }
+
+    client->dispatch(hostKey);
+    return true;
+}
+
+void KQOAuthHttpConnection::close(QNetworkReply::NetworkError code, const QString &message, bool requeueAll) {
+    if (closing) {
+        return;
+    }
+    closing = true;
+
+    // Requests the server never started to answer are sent again on a new connection,
+    // but only the idempotent ones, once, and only if the connection used to work.
+    QList<KQOAuthHttpReply *> replies = inFlight;
+    QList<KQOAuthHttpReply *> retries;
+    inFlight.clear();
+    foreach (KQOAuthHttpReply *reply, replies) {
+        reply->connection = 0;
+        bool retry = !reply->responseStarted
+                  && (requeueAll || (served > 0 && reply->isIdempotent() && !reply->retried));
+        if (retry) {
+            reply->retried = reply->retried || !requeueAll;
+            retries.append(reply);
+        } else {
+            reply->fail(code, message);
+        }
+    }
+
+    // As a block, so they are sent again in the order they were sent first.
+    if (!retries.isEmpty()) {
+        client->requeue(hostKey, retries);
+    }
+
+    if (socket) {
+        socket->disconnect(this);
+        socket->abort();
+    }
+
+    client->connectionClosed(this);
+}
+
+/////////////// KQOAuthHttpClient ////////////////
+
+KQOAuthHttpClient::KQOAuthHttpClient(QObject *parent) :
+    QObject(parent),
+    maximumConnections(defaultMaximumConnections),
+    pipeliningDepth(defaultPipeliningDepth)
+{
+
+}
+
+KQOAuthHttpClient::~KQOAuthHttpClient() {
+    // Replies and connections are children, and deleted with us.
+}
+
+QNetworkReply *KQOAuthHttpClient::get(const QNetworkRequest &request) {
+    return createReply(QNetworkAccessManager::GetOperation, request, QByteArray());
+}
+
+QNetworkReply *KQOAuthHttpClient::head(const QNetworkRequest &request) {
+    return createReply(QNetworkAccessManager::HeadOperation, request, QByteArray());
+}
+
+QNetworkReply *KQOAuthHttpClient::post(const QNetworkRequest &request, const QByteArray &data) {
+    return createReply(QNetworkAccessManager::PostOperation, request, data);
+}
+
+void KQOAuthHttpClient::preconnect(const QUrl &url) {
+    QString key = hostKey(url);
+    if (key.isEmpty()) {
+        return;
+    }
+
+    HostPool &hostPool = pool(url);
+    if (hostPool.connections.isEmpty()) {
+        KQOAuthHttpConnection *connection = new KQOAuthHttpConnection(this, key);
+        hostPool.connections.append(connection);
+        connection->connectToHost(hostPool.origin);
+    }
+}
+
+void KQOAuthHttpClient::setMaximumConnectionsPerHost(int count) {
+    maximumConnections = qMax(1, count);
+}
+
+void KQOAuthHttpClient::setPipeliningDepth(int depth) {
+    pipeliningDepth = qMax(1, depth);
+}
+
+int KQOAuthHttpClient::connectionCount() const {
+    int count = 0;
+    foreach (const HostPool &hostPool, pools) {
+        count += hostPool.connections.size();
+    }
+
+    return count;
+}
+
+// Empty for the URLs this client cannot serve.
+QString KQOAuthHttpClient::hostKey(const QUrl &url) {
+    QString scheme = url.scheme().toLower();
+    if (url.host().isEmpty()) {
+        return QString();
+    }
+
+#ifdef QT_NO_SSL
+    if (scheme != "http") {
+        return QString();
+    }
+#else
+    if (scheme != "http" && scheme != "https") {
+        return QString();
+    }
+#endif
+
+    return scheme + "://" + url.host().toLower() + ':'
+         + QString::number(url.port(scheme == "https" ? 443 : 80));
+}
+
+KQOAuthHttpClient::HostPool &KQOAuthHttpClient::pool(const QUrl &url) {
+    QString key = hostKey(url);
+
+    QHash<QString, HostPool>::iterator it = pools.find(key);
+    if (it == pools.end()) {
+        HostPool hostPool;
+        hostPool.origin = url;
+
+        // Internationalized host names go out in their ASCII form.
+        QString hostName = url.host().toLower();
+        QByteArray host;
+        if (hostName.contains(':')) {
+            host = '[' + hostName.toLatin1() + ']';
+        } else {
+            host = QUrl::toAce(hostName);
+        }
+        if (url.port() != -1) {
+            host += ':' + QByteArray::number(url.port());
+        }
+        hostPool.hostHeaders = "Host: " + host + "\r\nConnection: keep-alive\r\n";
+
+        it = pools.insert(key, hostPool);
+    }
+
+    return it.value();
+}
+
+KQOAuthHttpReply *KQOAuthHttpClient::createReply(QNetworkAccessManager::Operation operation,
+                                                 const QNetworkRequest &request, const QByteArray &data) {
+    KQOAuthHttpReply *reply = new KQOAuthHttpReply(operation, request, this);
+
+    QUrl url = request.url();
+    QString key = hostKey(url);
+    if (key.isEmpty()) {
+        qWarning() << "Unsupported URL for the lean HTTP client:" << url;
+        reply->fail(QNetworkReply::ProtocolUnknownError, "Unsupported URL");
+        return reply;
+    }
+
+    HostPool &hostPool = pool(url);
+
+    QByteArray target = url.toEncoded(QUrl::RemoveScheme | QUrl::RemoveAuthority | QUrl::RemoveFragment);
+    if (target.isEmpty()) {
+        target = "/";
+    }
+
+    const char *method = "GET ";
+    if (operation == QNetworkAccessManager::HeadOperation) {
+        method = "HEAD ";
+    } else if (operation == QNetworkAccessManager::PostOperation) {
+        method = "POST ";
+    }
+
+    // Size the head first, so it is written in one allocation.
+    QList<QByteArray> names = request.rawHeaderList();
+    int size = 6 + target.size() + 11 + hostPool.hostHeaders.size() + 2 + 32;
+    foreach (const QByteArray &name, names) {
+        size += name.size() + request.rawHeader(name).size() + 4;
+    }
+
+    QByteArray &head = reply->head;
+    head.reserve(size);
+    head.append(method);
+    head.append(target);
+    head.append(" HTTP/1.1\r\n");
+    head.append(hostPool.hostHeaders);
+    foreach (const QByteArray &name, names) {
+        if (isHopByHopHeader(name)) {
+            continue;
+        }
+        head.append(name);
+        head.append(": ");
+        head.append(request.rawHeader(name));
+        head.append("\r\n");
+    }
+    if (operation == QNetworkAccessManager::PostOperation) {
+        head.append("Content-Length: ");
+        head.append(QByteArray::number(data.size()));
+        head.append("\r\n");
+    }
+    head.append("\r\n");
+
+    reply->outgoing = data;
+    hostPool.queue.append(reply);
+    dispatch(key);
+
+    return reply;
+}
+
+void KQOAuthHttpClient::dispatch(const QString &key) {
+    QHash<QString, HostPool>::iterator it = pools.find(key);
+    if (it == pools.end()) {
+        return;
+    }
+    HostPool &hostPool = it.value();
+
+    while (!hostPool.queue.isEmpty()) {
+        KQOAuthHttpReply *reply = hostPool.queue.first();
+
+        // An idle connection first, then the shortest pipeline, then a new connection.
+        KQOAuthHttpConnection *target = 0;
+        foreach (KQOAuthHttpConnection *connection, hostPool.connections) {
+            if (connection->isIdle()) {
+                target = connection;
+                break;
+            }
+        }
+
+        if (target == 0 && reply->isIdempotent()) {
+            foreach (KQOAuthHttpConnection *connection, hostPool.connections) {
+                if (connection->canPipeline(pipeliningDepth)
+                    && (target == 0 || connection->inFlight.size() < target->inFlight.size())) {
+                    target = connection;
+                }
+            }
+        }
+
+        if (target == 0 && hostPool.connections.size() < maximumConnections) {
+            target = new KQOAuthHttpConnection(this, key);
+            hostPool.connections.append(target);
+            target->connectToHost(hostPool.origin);
+        }
+
+        if (target == 0) {
+            return;
+        }
+
+        hostPool.queue.removeFirst();
+        target->send(reply);
+    }
+}
+
+void KQOAuthHttpClient::requeue(const QString &key, const QList<KQOAuthHttpReply *> &replies) {
+    QHash<QString, HostPool>::iterator it = pools.find(key);
+    if (it != pools.end()) {
+        it.value().queue = replies + it.value().queue;
+    }
+}
+
+void KQOAuthHttpClient::remove(KQOAuthHttpReply *reply) {
+    if (reply->connection) {
+        reply->connection->detach(reply);
+        return;
+    }
+
+    QHash<QString, HostPool>::iterator it = pools.find(hostKey(reply->url()));
+    if (it != pools.end()) {
+        it.value().queue.removeAll(reply);
+    }
+}
+
+void KQOAuthHttpClient::connectionClosed(KQOAuthHttpConnection *connection) {
+    QHash<QString, HostPool>::iterator it = pools.find(connection->hostKey);
+    if (it != pools.end()) {
+        it.value().connections.removeAll(connection);
+    }
+
+    connection->deleteLater();
+    dispatch(connection->hostKey);
+}
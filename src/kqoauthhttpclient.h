@@ -0,0 +1,187 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHHTTPCLIENT_H
+#define KQOAUTHHTTPCLIENT_H
+
+#include <QHash>
+#include <QList>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QPointer>
+#include <QTcpSocket>
+
+#include "kqoauthglobals.h"
+#include "kqoauthtransport.h"
+
+class KQOAuthHttpClient;
+class KQOAuthHttpConnection;
+
+/**
+ * Reply of KQOAuthHttpClient. Looks like any other QNetworkReply to KQOAuthManager:
+ * error() and finished() are emitted once the whole response is in.
+ */
+class KQOAUTH_EXPORT KQOAuthHttpReply : public QNetworkReply
+{
+    Q_OBJECT
+public:
+    KQOAuthHttpReply(QNetworkAccessManager::Operation operation, const QNetworkRequest &request,
+                     KQOAuthHttpClient *client);
+    ~KQOAuthHttpReply();
+
+    void abort();
+    qint64 bytesAvailable() const;
+    bool isSequential() const;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+
+private Q_SLOTS:
+    void emitSignals();
+
+private:
+    friend class KQOAuthHttpClient;
+    friend class KQOAuthHttpConnection;
+
+    bool isIdempotent() const;
+    void setResponseHeader(const QByteArray &name, const QByteArray &value);
+    void finish(int statusCode, const QByteArray &reasonPhrase);
+    void fail(QNetworkReply::NetworkError code, const QString &message);
+
+    QPointer<KQOAuthHttpClient> client;
+    KQOAuthHttpConnection *connection;   // Connection the request is written to, 0 while queued.
+    QByteArray head;                    // Serialized request line and headers.
+    QByteArray outgoing;                // Request body.
+    QByteArray content;                 // Response body.
+    qint64 readOffset;
+    bool responseStarted;
+    bool retried;
+    bool done;
+};
+
+/**
+ * One keep-alive connection of KQOAuthHttpClient. Responses are matched to the written
+ * requests in order, so idempotent requests may be pipelined.
+ */
+class KQOAUTH_EXPORT KQOAuthHttpConnection : public QObject
+{
+    Q_OBJECT
+public:
+    KQOAuthHttpConnection(KQOAuthHttpClient *client, const QString &hostKey);
+    ~KQOAuthHttpConnection();
+
+    void connectToHost(const QUrl &url);
+    bool isIdle() const;
+    bool canPipeline(int depth) const;
+    void send(KQOAuthHttpReply *reply);
+    void detach(KQOAuthHttpReply *reply);
+
+    QString hostKey;
+    QTcpSocket *socket;
+    QList<KQOAuthHttpReply *> inFlight;     // Written requests, oldest first.
+    int served;
+
+private Q_SLOTS:
+    void onReady();
+    void onReadyRead();
+    void onDisconnected();
+    void onError(QAbstractSocket::SocketError error);
+
+private:
+    enum ParseState {
+        StatusLine,
+        Headers,
+        Body,
+        ChunkSize,
+        ChunkData,
+        ChunkTrailer,
+        BodyUntilClose
+    };
+
+    bool parse();
+    bool completeResponse();
+    // Fails or requeues the requests in flight and drops the connection from the pool.
+    void close(QNetworkReply::NetworkError code, const QString &message, bool requeueAll = false);
+
+    KQOAuthHttpClient *client;
+    bool ready;
+    bool keepAlive;
+    bool closing;
+    ParseState state;
+    QByteArray buffer;
+    int position;                       // Parsed up to here in the buffer.
+    bool chunked;
+    int statusCode;
+    QByteArray reasonPhrase;
+    qint64 remaining;
+};
+
+/**
+ * Lean HTTP/1.1 client used by KQOAuthManager::LeanHttpBackend instead of
+ * QNetworkAccessManager. It has no cookie jar, cache, proxy or redirect handling; it only
+ * keeps a few keep-alive connections per host, pipelines GET and HEAD requests on them
+ * and writes each request head in one go.
+ */
+class KQOAUTH_EXPORT KQOAuthHttpClient : public QObject, public KQOAuthTransport
+{
+    Q_OBJECT
+public:
+    explicit KQOAuthHttpClient(QObject *parent = 0);
+    ~KQOAuthHttpClient();
+
+    QNetworkReply *get(const QNetworkRequest &request);
+    QNetworkReply *head(const QNetworkRequest &request);
+    QNetworkReply *post(const QNetworkRequest &request, const QByteArray &data);
+
+    // Opens a connection to the host of 'url' and keeps it in the pool.
+    void preconnect(const QUrl &url);
+
+    // Defaults to 6 connections per host and 4 pipelined requests per connection.
+    void setMaximumConnectionsPerHost(int count);
+    void setPipeliningDepth(int depth);
+    int connectionCount() const;
+
+private:
+    friend class KQOAuthHttpReply;
+    friend class KQOAuthHttpConnection;
+
+    struct HostPool
+    {
+        QUrl origin;
+        QByteArray hostHeaders;         // Headers shared by every request to the host.
+        QList<KQOAuthHttpConnection *> connections;
+        QList<KQOAuthHttpReply *> queue;
+    };
+
+    static QString hostKey(const QUrl &url);
+    KQOAuthHttpReply *createReply(QNetworkAccessManager::Operation operation,
+                                  const QNetworkRequest &request, const QByteArray &data);
+    HostPool &pool(const QUrl &url);
+    void dispatch(const QString &key);
+    // Puts 'replies' back to the front of the queue of host 'key', in the same order.
+    void requeue(const QString &key, const QList<KQOAuthHttpReply *> &replies);
+    void remove(KQOAuthHttpReply *reply);
+    void connectionClosed(KQOAuthHttpConnection *connection);
+
+    QHash<QString, HostPool> pools;
+    int maximumConnections;
+    int pipeliningDepth;
+};
+
+#endif // KQOAUTHHTTPCLIENT_H
@@ -0,0 +1,221 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QThread>
+#include <QTimer>
+
+#include <string.h>
+
+#include "kqoauthloopbacktransport.h"
+#include "kqoauthloopbacktransport_p.h"
+
+/////////////// KQOAuthLoopbackReply ////////////////
+
+KQOAuthLoopbackReply::KQOAuthLoopbackReply(QNetworkAccessManager::Operation operation,
+                                           const QNetworkRequest &request,
+                                           const KQOAuthLoopbackResponse &response,
+                                           int latency, QObject *parent) :
+    QNetworkReply(parent),
+    content(response.data),
+    readOffset(0),
+    statusCode(response.statusCode),
+    done(false)
+{
+    setOperation(operation);
+    setRequest(request);
+    setUrl(request.url());
+    if (!response.contentType.isEmpty()) {
+        setRawHeader("Content-Type", response.contentType);
+    }
+    setRawHeader("Content-Length", QByteArray::number(content.size()));
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+
+    QTimer::singleShot(latency, this, SLOT(complete()));
+}
+
+void KQOAuthLoopbackReply::abort() {
+    if (done) {
+        return;
+    }
+
+    content.clear();
+    setError(QNetworkReply::OperationCanceledError, "Operation canceled");
+    complete();
+}
+
+qint64 KQOAuthLoopbackReply::bytesAvailable() const {
+    return content.size() - readOffset + QNetworkReply::bytesAvailable();
+}
+
+bool KQOAuthLoopbackReply::isSequential() const {
+    return true;
+}
+
+qint64 KQOAuthLoopbackReply::readData(char *data, qint64 maxSize) {
+    if (!done) {
+        return 0;
+    }
+
+    qint64 count = qMin(maxSize, content.size() - readOffset);
+    if (count <= 0) {
+        return -1;
+    }
+
+    memcpy(data, content.constData() + readOffset, count);
+    readOffset += count;
+    return count;
+}
+
+void KQOAuthLoopbackReply::complete() {
+    if (done) {
+        return;
+    }
+    done = true;
+
+    if (error() == QNetworkReply::NoError) {
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, statusCode);
+        if (statusCode >= 400) {
+            setError(KQOAuthTransport::errorForStatusCode(statusCode), "Scripted error reply");
+        }
+    }
+    setFinished(true);
+
+    if (error() != QNetworkReply::NoError) {
+#if QT_VERSION >= 0x050f00
+        emit errorOccurred(error());
+#endif
+#if QT_VERSION < 0x060000
+        emit error(error());
+#endif
+    }
+
+    if (!content.isEmpty()) {
+        emit readyRead();
+    }
+    emit finished();
+}
+
+//////////// Private d_ptr implementation /////////
+
+KQOAuthLoopbackTransportPrivate::KQOAuthLoopbackTransportPrivate() :
+    q_ptr(0),
+    latency(0),
+    requestCount(0)
+{
+
+}
+
+QNetworkReply *KQOAuthLoopbackTransportPrivate::reply(QNetworkAccessManager::Operation operation,
+                                                      const QNetworkRequest &request,
+                                                      const QByteArray &data) {
+    QMutexLocker locker(&mutex);
+
+    requestCount++;
+    lastRequest = request;
+    lastRequestBody = data;
+
+    QHash<QString, KQOAuthLoopbackResponse>::const_iterator it = responses.constFind(request.url().path());
+    if (it == responses.constEnd()) {
+        it = responses.constFind(QString());
+    }
+
+    KQOAuthLoopbackResponse response;
+    if (it != responses.constEnd()) {
+        response = it.value();
+    }
+
+    int replyLatency = latency;
+    locker.unlock();
+
+    // A QObject can only have a parent in its own thread.
+    QObject *parent = QThread::currentThread() == q_ptr->thread() ? q_ptr : 0;
+    return new KQOAuthLoopbackReply(operation, request, response, replyLatency, parent);
+}
+
+/////////////// Public implementation ////////////////
+
+KQOAuthLoopbackTransport::KQOAuthLoopbackTransport(QObject *parent) :
+    QObject(parent),
+    d_ptr(new KQOAuthLoopbackTransportPrivate)
+{
+    d_ptr->q_ptr = this;
+}
+
+KQOAuthLoopbackTransport::~KQOAuthLoopbackTransport() {
+    delete d_ptr;
+}
+
+void KQOAuthLoopbackTransport::setReply(const QString &path, int statusCode, const QByteArray &data,
+                                        const QByteArray &contentType) {
+    Q_D(KQOAuthLoopbackTransport);
+
+    KQOAuthLoopbackResponse response;
+    response.statusCode = statusCode;
+    response.data = data;
+    response.contentType = contentType;
+
+    QMutexLocker locker(&d->mutex);
+    d->responses.insert(path, response);
+}
+
+void KQOAuthLoopbackTransport::clearReplies() {
+    Q_D(KQOAuthLoopbackTransport);
+    QMutexLocker locker(&d->mutex);
+    d->responses.clear();
+}
+
+void KQOAuthLoopbackTransport::setLatency(int milliseconds) {
+    Q_D(KQOAuthLoopbackTransport);
+    QMutexLocker locker(&d->mutex);
+    d->latency = qMax(0, milliseconds);
+}
+
+int KQOAuthLoopbackTransport::latency() const {
+    Q_D(const KQOAuthLoopbackTransport);
+    QMutexLocker locker(&d->mutex);
+    return d->latency;
+}
+
+int KQOAuthLoopbackTransport::requestCount() const {
+    Q_D(const KQOAuthLoopbackTransport);
+    QMutexLocker locker(&d->mutex);
+    return d->requestCount;
+}
+
+QNetworkRequest KQOAuthLoopbackTransport::lastRequest() const {
+    Q_D(const KQOAuthLoopbackTransport);
+    QMutexLocker locker(&d->mutex);
+    return d->lastRequest;
+}
+
+QByteArray KQOAuthLoopbackTransport::lastRequestBody() const {
+    Q_D(const KQOAuthLoopbackTransport);
+    QMutexLocker locker(&d->mutex);
+    return d->lastRequestBody;
+}
+
+QNetworkReply *KQOAuthLoopbackTransport::get(const QNetworkRequest &request) {
+    Q_D(KQOAuthLoopbackTransport);
+    return d->reply(QNetworkAccessManager::GetOperation, request, QByteArray());
+}
+
+QNetworkReply *KQOAuthLoopbackTransport::post(const QNetworkRequest &request, const QByteArray &data) {
+    Q_D(KQOAuthLoopbackTransport);
+    return d->reply(QNetworkAccessManager::PostOperation, request, data);
+}
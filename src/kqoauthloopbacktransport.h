@@ -0,0 +1,72 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHLOOPBACKTRANSPORT_H
+#define KQOAUTHLOOPBACKTRANSPORT_H
+
+#include <QObject>
+
+#include "kqoauthtransport.h"
+
+class KQOAuthLoopbackTransportPrivate;
+
+/**
+ * In-memory transport that answers every request with a scripted reply, without any
+ * sockets. Meant for tests and for benchmarking KQOAuthManager on its own:
+ *
+ *   KQOAuthLoopbackTransport transport;
+ *   transport.setReply("/oauth/request_token", 200, "oauth_token=t&oauth_token_secret=s");
+ *   manager->setTransport(&transport);
+ *
+ * Replies complete from the event loop, after the latency set with setLatency().
+ * The transport is thread safe, so the worker threads of a KQOAuthThreadedManager can
+ * share it; each reply then completes in the thread that sent the request.
+ */
+class KQOAUTH_EXPORT KQOAuthLoopbackTransport : public QObject, public KQOAuthTransport
+{
+    Q_OBJECT
+public:
+    explicit KQOAuthLoopbackTransport(QObject *parent = 0);
+    ~KQOAuthLoopbackTransport();
+
+    // Reply to the requests for URL path 'path'. An empty path matches the requests no
+    // other path matches; without one they get a 404.
+    void setReply(const QString &path, int statusCode, const QByteArray &data,
+                  const QByteArray &contentType = "application/x-www-form-urlencoded");
+    void clearReplies();
+
+    // Milliseconds before a reply completes. Defaults to 0, the next pass of the event loop.
+    void setLatency(int milliseconds);
+    int latency() const;
+
+    // Number of requests received, and the last one of them with its body.
+    int requestCount() const;
+    QNetworkRequest lastRequest() const;
+    QByteArray lastRequestBody() const;
+
+    QNetworkReply *get(const QNetworkRequest &request);
+    QNetworkReply *post(const QNetworkRequest &request, const QByteArray &data);
+
+private:
+    KQOAuthLoopbackTransportPrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(KQOAuthLoopbackTransport);
+    Q_DISABLE_COPY(KQOAuthLoopbackTransport);
+};
+
+#endif // KQOAUTHLOOPBACKTRANSPORT_H
@@ -0,0 +1,85 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHLOOPBACKTRANSPORT_P_H
+#define KQOAUTHLOOPBACKTRANSPORT_P_H
+
+#include <QHash>
+#include <QMutex>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+
+#include "kqoauthloopbacktransport.h"
+
+struct KQOAuthLoopbackResponse
+{
+    KQOAuthLoopbackResponse() : statusCode(404) {}
+
+    int statusCode;
+    QByteArray data;
+    QByteArray contentType;
+};
+
+class KQOAuthLoopbackTransportPrivate {
+
+public:
+    KQOAuthLoopbackTransportPrivate();
+
+    QNetworkReply *reply(QNetworkAccessManager::Operation operation,
+                         const QNetworkRequest &request, const QByteArray &data);
+
+    KQOAuthLoopbackTransport *q_ptr;
+
+    // Guards the members below, since the managers of several threads may share the transport.
+    mutable QMutex mutex;
+    QHash<QString, KQOAuthLoopbackResponse> responses;
+    int latency;
+    int requestCount;
+    QNetworkRequest lastRequest;
+    QByteArray lastRequestBody;
+};
+
+/**
+ * Reply of KQOAuthLoopbackTransport, completed with a scripted response.
+ */
+class KQOAuthLoopbackReply : public QNetworkReply
+{
+    Q_OBJECT
+public:
+    KQOAuthLoopbackReply(QNetworkAccessManager::Operation operation, const QNetworkRequest &request,
+                         const KQOAuthLoopbackResponse &response, int latency, QObject *parent);
+
+    void abort();
+    qint64 bytesAvailable() const;
+    bool isSequential() const;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+
+private Q_SLOTS:
+    void complete();
+
+private:
+    QByteArray content;
+    qint64 readOffset;
+    int statusCode;
+    bool done;
+};
+
+#endif // KQOAUTHLOOPBACKTRANSPORT_P_H
@@ -18,14 +18,51 @@
  *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <QtCore>
-#include <QDesktopServices>
+#include <QSslConfiguration>
+#include <QNetworkCookie>
+#include <QNetworkCookieJar>
 
 #include "kqoauthmanager.h"
 #include "kqoauthmanager_p.h"
+#include "kqoauthcredentialregistry.h"
+#include "kqoauthformparser.h"
+#include "kqoauthperthread.h"
 
 namespace
 {
     const QNetworkRequest::Attribute userDataAttribute = static_cast<QNetworkRequest::Attribute>(QNetworkRequest::User + 1);
+    // Set on https requests when a session cache is in use.
+    const QNetworkRequest::Attribute sendTimeAttribute = static_cast<QNetworkRequest::Attribute>(QNetworkRequest::User + 2);
+    const QNetworkRequest::Attribute ticketOfferedAttribute = static_cast<QNetworkRequest::Attribute>(QNetworkRequest::User + 3);
+
+    // Set with KQOAuthManager::setAuthorizationUrlOpener().
+    KQOAuthManager::UrlOpener urlOpener = 0;
+
+    // Posted to the manager when the first request of a batch is put to the submission queue.
+    QEvent::Type submissionEventType() {
+        static const QEvent::Type type = static_cast<QEvent::Type>(QEvent::registerEventType());
+        return type;
+    }
+
+    // Given to the shared network access manager, so a service can not see the cookies
+    // another manager of the thread got from its own service.
+    class KQOAuthNoCookieJar : public QNetworkCookieJar
+    {
+    public:
+        QList<QNetworkCookie> cookiesForUrl(const QUrl &) const {
+            return QList<QNetworkCookie>();
+        }
+
+        bool setCookiesFromUrl(const QList<QNetworkCookie> &, const QUrl &) {
+            return false;
+        }
+    };
+
+    QNetworkAccessManager *createSharedNetworkManager() {
+        QNetworkAccessManager *manager = new QNetworkAccessManager;
+        manager->setCookieJar(new KQOAuthNoCookieJar);
+        return manager;
+    }
 }
 
 ////////////// Private d_ptr implementation ////////////////
@@ -33,28 +70,110 @@ namespace
 KQOAuthManagerPrivate::KQOAuthManagerPrivate(KQOAuthManager *parent) :
     error(KQOAuthManager::NoError) ,
     r(0) ,
-    opaqueRequest(new KQOAuthRequest) ,
+    opaqueRequest(0) ,
     q_ptr(parent) ,
-    callbackServer(new KQOAuthAuthReplyServer(parent)) ,
+    callbackServer(0) ,
+    callbackPort(0) ,
     isVerified(false) ,
     isAuthorized(false) ,
     autoAuth(false),
-    networkManager(new QNetworkAccessManager),
-    managerUserSet(false)
+    networkManager(0),
+    managerUserSet(false),
+    httpBackend(KQOAuthManager::NetworkAccessManagerBackend),
+    httpClient(0),
+    customTransport(0),
+    nextDeadlineId(1),
+    deadlineTimerWakeup(-1),
+    tokenStore(0),
+    sessionCache(0),
+    http2Enabled(false),
+    automaticFlow(false)
 {
-
+    deadlineTimer.setSingleShot(true);
+    clock.start();
 }
 
 KQOAuthManagerPrivate::~KQOAuthManagerPrivate() {
+    // Threads waiting in executeBlocking() without a timeout would wait forever, and
+    // suspended coroutines would never be resumed or destroyed. The blocking calls still
+    // queued are completed by the submission queue.
+    QHash<QNetworkReply*, KQOAuthPendingRequest> unfinished = pendingReplies;
+    pendingReplies.clear();
+    foreach (const KQOAuthPendingRequest &pending, unfinished) {
+        if (pending.blockingCall) {
+            pending.blockingCall->fail(KQOAuthManager::ManagerError);
+        }
+        if (pending.awaitState) {
+            pending.awaitState->complete(KQOAuthManager::ManagerError);
+        }
+    }
+
+    // The callback server is shared, so only drop our own flows from it.
+    if (callbackServer) {
+        foreach (const QString &token, callbackFlows) {
+            callbackServer->unregisterFlow(token);
+        }
+    }
+
     delete opaqueRequest;
     opaqueRequest = 0;
 
+    delete httpClient;
+    httpClient = 0;
+
     if (!managerUserSet) {
         delete networkManager;
         networkManager = 0;
     }
 }
 
+// The network access manager and the opaque request are created on first use, since
+// many managers never need them, or get a network access manager from the application.
+QNetworkAccessManager *KQOAuthManagerPrivate::network() {
+    if (networkManager == 0) {
+        networkManager = new QNetworkAccessManager;
+        managerUserSet = false;
+    }
+
+    return networkManager;
+}
+
+// One network access manager per thread, so all the managers of the thread share its
+// connection pool.
+QNetworkAccessManager *KQOAuthManagerPrivate::sharedNetworkManager() {
+    return KQOAuthPerThread<QNetworkAccessManager>::instance(createSharedNetworkManager);
+}
+
+KQOAuthHttpClient *KQOAuthManagerPrivate::client() {
+    if (httpClient == 0) {
+        httpClient = new KQOAuthHttpClient;
+    }
+
+    return httpClient;
+}
+
+// The transport set with setTransport(), or else the one of the chosen backend.
+KQOAuthTransport *KQOAuthManagerPrivate::transport() {
+    if (customTransport) {
+        return customTransport;
+    }
+
+    if (httpBackend == KQOAuthManager::LeanHttpBackend) {
+        return client();
+    }
+
+    networkTransport.setNetworkManager(network());
+    return &networkTransport;
+}
+
+KQOAuthRequest *KQOAuthManagerPrivate::opaque() {
+    if (opaqueRequest == 0) {
+        opaqueRequest = new KQOAuthRequest;
+    }
+
+    return opaqueRequest;
+}
+
 QList< QPair<QString, QString> > KQOAuthManagerPrivate::createQueryParams(const KQOAuthParameters &requestParams) {
     QList<QString> requestKeys = requestParams.keys();
     QList<QString> requestValues = requestParams.values();
@@ -69,62 +188,56 @@ QList< QPair<QString, QString> > KQOAuthManagerPrivate::createQueryParams(const
     return result;
 }
 
+// The returned values are already percent decoded.
 QMultiMap<QString, QString> KQOAuthManagerPrivate::createTokensFromResponse(QByteArray reply) {
-    QMultiMap<QString, QString> result;
-    QString replyString(reply);
-
-    QStringList parameterPairs = replyString.split('&', QString::SkipEmptyParts);
-    foreach (const QString &parameterPair, parameterPairs) {
-        QStringList parameter = parameterPair.split('=');
-        result.insert(parameter.value(0), parameter.value(1));
-    }
-
-    return result;
+    return KQOAuthFormParser::parseToMap(reply);
 }
 
-bool KQOAuthManagerPrivate::setSuccessfulRequestToken(const QMultiMap<QString, QString> &request) {
-    if (currentRequestType == KQOAuthRequest::TemporaryCredentials) {
+bool KQOAuthManagerPrivate::setSuccessfulRequestToken(const QMultiMap<QString, QString> &request,
+                                                      KQOAuthRequest::RequestType requestType) {
+    if (requestType == KQOAuthRequest::TemporaryCredentials) {
         hasTemporaryToken = (!QString(request.value("oauth_token")).isEmpty() && !QString(request.value("oauth_token_secret")).isEmpty());
     } else {
         return false;
     }
 
     if (hasTemporaryToken) {
-        requestToken = QUrl::fromPercentEncoding( QString(request.value("oauth_token")).toLocal8Bit() );
-        requestTokenSecret =  QUrl::fromPercentEncoding( QString(request.value("oauth_token_secret")).toLocal8Bit() );
+        requestToken = request.value("oauth_token");
+        requestTokenSecret = request.value("oauth_token_secret");
     }
 
     return hasTemporaryToken;
 }
 
-bool KQOAuthManagerPrivate::setSuccessfulAuthorized(const QMultiMap<QString, QString> &request ) {
-    if (currentRequestType == KQOAuthRequest::AccessToken) {
+bool KQOAuthManagerPrivate::setSuccessfulAuthorized(const QMultiMap<QString, QString> &request,
+                                                    KQOAuthRequest::RequestType requestType) {
+    if (requestType == KQOAuthRequest::AccessToken) {
         isAuthorized = (!QString(request.value("oauth_token")).isEmpty() && !QString(request.value("oauth_token_secret")).isEmpty());
     } else {
         return false;
     }
 
     if (isAuthorized) {
-        requestToken = QUrl::fromPercentEncoding( QString(request.value("oauth_token")).toLocal8Bit() );
-        requestTokenSecret =  QUrl::fromPercentEncoding( QString(request.value("oauth_token_secret")).toLocal8Bit() );
+        requestToken = request.value("oauth_token");
+        requestTokenSecret = request.value("oauth_token_secret");
     }
 
     return isAuthorized;
 }
 
-void KQOAuthManagerPrivate::emitTokens() {
+void KQOAuthManagerPrivate::emitTokens(KQOAuthRequest::RequestType requestType) {
     Q_Q(KQOAuthManager);
 
     if (this->requestToken.isEmpty() || this->requestTokenSecret.isEmpty()) {
         error = KQOAuthManager::RequestUnauthorized;
     }
 
-    if (currentRequestType == KQOAuthRequest::TemporaryCredentials) {
+    if (requestType == KQOAuthRequest::TemporaryCredentials) {
         // Signal that we are ready to use the protected resources.
         emit q->temporaryTokenReceived(this->requestToken, this->requestTokenSecret);
     }
 
-    if (currentRequestType == KQOAuthRequest::AccessToken) {
+    if (requestType == KQOAuthRequest::AccessToken) {
         // Signal that we are ready to use the protected resources.
         emit q->accessTokenReceived(this->requestToken, this->requestTokenSecret);
     }
@@ -132,10 +245,200 @@ void KQOAuthManagerPrivate::emitTokens() {
     emit q->receivedToken(this->requestToken, this->requestTokenSecret);
 }
 
+void KQOAuthManagerPrivate::saveTokensToStore() {
+    if (tokenStore == 0) {
+        return;
+    }
+
+    KQOAuthTokenStore::Tokens tokens;
+    tokens.token = requestToken;
+    tokens.tokenSecret = requestTokenSecret;
+    tokens.consumerKey = consumerKey;
+    tokens.consumerSecret = consumerKeySecret;
+
+    if (!tokenStore->saveTokens(tokenStoreAccount, tokens)) {
+        qWarning() << "Could not save the access tokens of" << tokenStoreAccount;
+    }
+}
+
+// Transport options shared by all the requests of this manager.
+void KQOAuthManagerPrivate::prepareNetworkRequest(QNetworkRequest &networkRequest, KQOAuthRequest *request) {
+#if QT_VERSION >= 0x040700
+    switch (request->priority()) {
+    case KQOAuthRequest::HighPriority:
+        networkRequest.setPriority(QNetworkRequest::HighPriority);
+        break;
+    case KQOAuthRequest::LowPriority:
+        networkRequest.setPriority(QNetworkRequest::LowPriority);
+        break;
+    default:
+        break;
+    }
+#endif
+
+#if QT_VERSION >= 0x050800
+    if (http2Enabled) {
+        networkRequest.setAttribute(QNetworkRequest::HTTP2AllowedAttribute, true);
+    }
+#endif
+
+    applySessionTicket(networkRequest);
+}
+
+// Offers the saved TLS session of the host, and asks Qt to keep the new one for us.
+void KQOAuthManagerPrivate::applySessionTicket(QNetworkRequest &request) {
+#ifdef KQOAUTH_HAVE_SESSION_TICKETS
+    if (sessionCache == 0 || request.url().scheme() != "https") {
+        return;
+    }
+
+    QSslConfiguration configuration = request.sslConfiguration();
+    configuration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+
+    QByteArray ticket = sessionCache->sessionTicket(request.url().host());
+    if (!ticket.isEmpty()) {
+        configuration.setSessionTicket(ticket);
+    }
+
+    request.setSslConfiguration(configuration);
+    request.setAttribute(sendTimeAttribute, clock.elapsed());
+    request.setAttribute(ticketOfferedAttribute, !ticket.isEmpty());
+#else
+    Q_UNUSED(request);
+#endif
+}
+
+void KQOAuthManagerPrivate::watchHandshake(QNetworkReply *reply) {
+#ifdef KQOAUTH_HAVE_SESSION_TICKETS
+    // Only emitted for new connections, not for the ones reused from the pool.
+    if (reply->request().attribute(sendTimeAttribute).isValid()) {
+        QObject::connect(reply, SIGNAL(encrypted()), q_ptr, SLOT(onReplyEncrypted()));
+    }
+#else
+    Q_UNUSED(reply);
+#endif
+}
+
+void KQOAuthManagerPrivate::saveSessionTicket(QNetworkReply *reply) {
+#ifdef KQOAUTH_HAVE_SESSION_TICKETS
+    if (sessionCache == 0 || !reply->request().attribute(sendTimeAttribute).isValid()) {
+        return;
+    }
+
+    QByteArray ticket = reply->sslConfiguration().sessionTicket();
+    if (!ticket.isEmpty()) {
+        sessionCache->setSessionTicket(reply->url().host(), ticket);
+    }
+#else
+    Q_UNUSED(reply);
+#endif
+}
+
+// Opens the connection to 'endpoint' ahead of time, so the next real request
+// skips the DNS, TCP and TLS set up.
+void KQOAuthManagerPrivate::preconnect(const QUrl &endpoint) {
+    transport()->preconnect(endpoint);
+}
+
 bool KQOAuthManagerPrivate::setupCallbackServer() {
-    return callbackServer->listen();
+    if (callbackServer.isNull()) {
+        callbackServer = KQOAuthAuthReplyServer::sharedServer();
+    }
+
+    // Bound once, then the port stays the same for every flow.
+    if (callbackServer->isListening()) {
+        if (callbackPort != 0 && callbackPort != callbackServer->serverPort()) {
+            qWarning() << "The callback server of this thread already listens on port"
+                       << callbackServer->serverPort() << "- ignoring callback port" << callbackPort;
+        }
+        return true;
+    }
+
+    // The callback URL is always on localhost, so nobody else needs to reach the server.
+    if (callbackPort != 0 && callbackServer->listen(QHostAddress::LocalHost, callbackPort)) {
+        return true;
+    }
+
+    if (callbackPort != 0) {
+        qWarning() << "Callback port" << callbackPort << "is not available. Using any free port.";
+    }
+
+    return callbackServer->listen(QHostAddress::LocalHost);
 }
 
+// Returns the absolute deadline for the request on our clock, or -1 if the request has no timeout.
+// 'startTime' is when the request was given to us, also on our clock. A positive 'timeout'
+// replaces the request's own timeout if it is shorter.
+qint64 KQOAuthManagerPrivate::requestDeadline(KQOAuthRequest *request, qint64 startTime, int timeout) {
+    int requestTimeout = request->timeoutForManager();
+    if (requestTimeout > 0 && (timeout <= 0 || requestTimeout < timeout)) {
+        timeout = requestTimeout;
+    }
+
+    if (timeout <= 0) {
+        return -1;
+    }
+
+    return startTime + timeout;
+}
+
+void KQOAuthManagerPrivate::trackReply(QNetworkReply *reply, KQOAuthRequest *request, qint64 deadline) {
+    KQOAuthPendingRequest pending;
+    pending.request = request;
+    pending.requestType = request->requestType();
+
+    if (deadline >= 0) {
+        pending.deadlineId = nextDeadlineId++;
+        deadlineReplies.insert(pending.deadlineId, reply);
+        deadlines.schedule(pending.deadlineId, deadline, clock.elapsed());
+        armDeadlineTimer();
+    }
+
+    pendingReplies.insert(reply, pending);
+}
+
+KQOAuthPendingRequest KQOAuthManagerPrivate::untrackReply(QNetworkReply *reply) {
+    KQOAuthPendingRequest pending = pendingReplies.take(reply);
+    if (pending.deadlineId != 0) {
+        // The timer is left running; an early wakeup is cheaper than re-arming it here.
+        deadlines.cancel(pending.deadlineId);
+        deadlineReplies.remove(pending.deadlineId);
+    }
+
+    return pending;
+}
+
+void KQOAuthManagerPrivate::armDeadlineTimer() {
+    qint64 wakeup = deadlines.nextWakeup();
+    if (wakeup < 0) {
+        deadlineTimer.stop();
+        deadlineTimerWakeup = -1;
+        return;
+    }
+
+    if (deadlineTimer.isActive() && deadlineTimerWakeup <= wakeup) {
+        return;
+    }
+
+    deadlineTimerWakeup = wakeup;
+    deadlineTimer.start(static_cast<int>(qMax(Q_INT64_C(0), wakeup - clock.elapsed())));
+}
+
+void KQOAuthManagerPrivate::completeHandle(const KQOAuthPendingRequest &pending,
+                                           const KQOAuthManager::KQOAuthReply &reply) {
+    // The reply's own error, since 'error' may belong to a request sent from a slot by now.
+    if (pending.handle) {
+        pending.handle->complete(reply, reply.error);
+    }
+
+    if (pending.blockingCall) {
+        pending.blockingCall->complete(reply);
+    }
+
+    if (pending.awaitState) {
+        pending.awaitState->complete(reply.error, &reply);
+    }
+}
 
 /////////////// Public implementation ////////////////
 
@@ -143,7 +446,8 @@ KQOAuthManager::KQOAuthManager(QObject *parent) :
     QObject(parent) ,
     d_ptr(new KQOAuthManagerPrivate(this))
 {
-
+    connect(&d_ptr->deadlineTimer, SIGNAL(timeout()),
+            this, SLOT(onDeadlineTimerFired()));
 }
 
 KQOAuthManager::~KQOAuthManager()
@@ -154,24 +458,209 @@ KQOAuthManager::~KQOAuthManager()
 void KQOAuthManager::executeRequest(KQOAuthRequest *request, const QVariant& userData) {
     Q_D(KQOAuthManager);
 
+    sendRequest(request, userData, d->clock.elapsed());
+}
+
+KQOAuthPendingReply *KQOAuthManager::executeRequest(KQOAuthRequest *request, QObject *receiver,
+                                                    const char *member, const QVariant& userData) {
+    Q_D(KQOAuthManager);
+
+    KQOAuthPendingReply *handle = new KQOAuthPendingReply(this);
+    handle->then(receiver, member);
+
+    QNetworkReply *reply = sendRequest(request, userData, d->clock.elapsed());
+    if (reply == 0) {
+        handle->fail(d->error, userData);
+        return handle;
+    }
+
+    d->pendingReplies[reply].handle = handle;
+    return handle;
+}
+
+void KQOAuthManager::awaitRequest(KQOAuthRequest *request, const QVariant &userData, KQOAuthAwaitState *state) {
+    Q_D(KQOAuthManager);
+
+    state->reply.userData = userData;
+
+    // A request that cannot be sent is ready right away, so the coroutine does not suspend.
+    QNetworkReply *reply = sendRequest(request, userData, d->clock.elapsed());
+    if (reply == 0) {
+        state->complete(d->error);
+        return;
+    }
+
+    state->manager = this;
+    state->networkReply = reply;
+    d->pendingReplies[reply].awaitState = state;
+}
+
+void KQOAuthManager::forgetAwaitState(KQOAuthAwaitState *state) {
+    Q_D(KQOAuthManager);
+
+    // The request goes on, but nobody waits for it any more.
+    QHash<QNetworkReply*, KQOAuthPendingRequest>::iterator pending = d->pendingReplies.find(state->networkReply);
+    if (pending != d->pendingReplies.end() && pending.value().awaitState == state) {
+        pending.value().awaitState = 0;
+    }
+
+    state->manager = 0;
+    state->networkReply = 0;
+}
+
+void KQOAuthManager::postRequest(KQOAuthRequest *request, const QVariant& userData) {
+    Q_D(KQOAuthManager);
+
+    QElapsedTimer now;
+    now.start();
+
+    KQOAuthSubmission *submission = new KQOAuthSubmission;
+    submission->request = request;
+    submission->userData = userData;
+    submission->submittedAt = now.msecsSinceReference();
+
+    if (d->submissions.enqueue(submission)) {
+        QCoreApplication::postEvent(this, new QEvent(submissionEventType()));
+    }
+}
+
+void KQOAuthManager::customEvent(QEvent *event) {
+    Q_D(KQOAuthManager);
+
+    if (event->type() != submissionEventType()) {
+        QObject::customEvent(event);
+        return;
+    }
+
+    // Reset the wake-up first, so that requests posted while we drain post a new event.
+    d->submissions.beginDrain();
+
+    qint64 clockReference = d->clock.msecsSinceReference();
+    KQOAuthSubmission *submission;
+    while ((submission = d->submissions.dequeue()) != 0) {
+        if (submission->blockingCall.isNull()) {
+            QNetworkReply *reply = sendRequest(submission->request, submission->userData,
+                                               submission->submittedAt - clockReference,
+                                               submission->timeout);
+            if (reply == 0) {
+                // Nobody waits on the call, so the reply is the only way to hear about it.
+                KQOAuthReply failed;
+                failed.userData = submission->userData;
+                failed.error = d->error;
+                emit replyReceived(failed);
+            }
+            delete submission;
+            continue;
+        }
+
+        // The caller may have timed out and deleted the request already.
+        QMutexLocker requestLocker(&submission->blockingCall->requestLock);
+        if (!submission->blockingCall->cancelled) {
+            QNetworkReply *reply = sendRequest(submission->request, submission->userData,
+                                               submission->submittedAt - clockReference,
+                                               submission->timeout);
+            if (reply == 0) {
+                KQOAuthReply failed;
+                failed.userData = submission->userData;
+                failed.error = d->error;
+                submission->blockingCall->complete(failed);
+            } else {
+                d->pendingReplies[reply].blockingCall = submission->blockingCall;
+            }
+            if (d->r == submission->request) {
+                d->r = 0;
+            }
+        }
+        requestLocker.unlock();
+        delete submission;
+    }
+}
+
+KQOAuthManager::KQOAuthReply KQOAuthManager::executeBlocking(KQOAuthRequest *request, int timeoutMilliseconds,
+                                                             const QVariant& userData) {
+    Q_D(KQOAuthManager);
+
+    KQOAuthReply result;
+    result.userData = userData;
+
+    if (QThread::currentThread() == thread()) {
+        // Nobody would be left to run the request.
+        qWarning() << "executeBlocking() called from the manager's own thread. Cannot proceed.";
+        result.error = KQOAuthManager::ManagerError;
+        return result;
+    }
+
+    QElapsedTimer waited;
+    waited.start();
+
+    QSharedPointer<KQOAuthBlockingCall> call(new KQOAuthBlockingCall);
+    call->userData = userData;
+
+    KQOAuthSubmission *submission = new KQOAuthSubmission;
+    submission->request = request;
+    submission->userData = userData;
+    submission->submittedAt = waited.msecsSinceReference();
+    submission->timeout = qMax(0, timeoutMilliseconds);
+    submission->blockingCall = call;
+
+    if (d->submissions.enqueue(submission)) {
+        QCoreApplication::postEvent(this, new QEvent(submissionEventType()));
+    }
+
+    QMutexLocker locker(&call->mutex);
+    while (!call->finished) {
+        if (timeoutMilliseconds <= 0) {
+            call->done.wait(&call->mutex);
+            continue;
+        }
+
+        qint64 remaining = timeoutMilliseconds - waited.elapsed();
+        if (remaining <= 0) {
+            // Wait for the manager to be done with the request, then tell it to leave the
+            // request alone; the caller may delete it as soon as we return. The manager
+            // aborts the network request on the same deadline.
+            locker.unlock();
+            QMutexLocker requestLocker(&call->requestLock);
+            call->cancelled = true;
+            requestLocker.unlock();
+
+            locker.relock();
+            if (call->finished) {
+                return call->reply;
+            }
+            result.error = KQOAuthManager::RequestTimeout;
+            return result;
+        }
+        call->done.wait(&call->mutex, static_cast<unsigned long>(remaining));
+    }
+
+    return call->reply;
+}
+
+QNetworkReply *KQOAuthManager::sendRequest(KQOAuthRequest *request, const QVariant &userData, qint64 startTime,
+                                           int timeout) {
+    Q_D(KQOAuthManager);
+
     d->r = request;
 
     if (request == 0) {
         qWarning() << "Request is NULL. Cannot proceed.";
         d->error = KQOAuthManager::RequestError;
-        return;
+        return 0;
     }
 
+    qint64 deadline = d->requestDeadline(request, startTime, timeout);
+
     if (!request->requestEndpoint().isValid()) {
         qWarning() << "Request endpoint URL is not valid. Cannot proceed.";
         d->error = KQOAuthManager::RequestEndpointError;
-        return;
+        return 0;
     }
 
     if (!request->isValid()) {
         qWarning() << "Request is not valid. Cannot proceed.";
         d->error = KQOAuthManager::RequestValidationError;
-        return;
+        return 0;
     }
 
     d->currentRequestType = request->requestType();
@@ -181,9 +670,9 @@ void KQOAuthManager::executeRequest(KQOAuthRequest *request, const QVariant& use
     networkRequest.setAttribute(userDataAttribute, userData);
 
     if (d->autoAuth && d->currentRequestType == KQOAuthRequest::TemporaryCredentials) {
-        d->setupCallbackServer();
-        connect(d->callbackServer, SIGNAL(verificationReceived(QMultiMap<QString, QString>)),
-                this, SLOT( onVerificationReceived(QMultiMap<QString, QString>)));
+        if (!d->setupCallbackServer()) {
+            qWarning() << "Could not start the callback server.";
+        }
 
         QString serverString = "http://localhost:";
         serverString.append(QString::number(d->callbackServer->serverPort()));
@@ -206,12 +695,9 @@ void KQOAuthManager::executeRequest(KQOAuthRequest *request, const QVariant& use
         authHeader.append(header);
     }
     networkRequest.setRawHeader("Authorization", authHeader);
+    d->prepareNetworkRequest(networkRequest, request);
 
-    connect(d->networkManager, SIGNAL(finished(QNetworkReply *)),
-            this, SLOT(onRequestReplyReceived(QNetworkReply *)), Qt::UniqueConnection);
-    disconnect(d->networkManager, SIGNAL(finished(QNetworkReply *)),
-            this, SLOT(onAuthorizedRequestReplyReceived(QNetworkReply *)));
-
+    QNetworkReply *reply = 0;
     if (request->httpMethod() == KQOAuthRequest::GET) {
         // Get the requested additional params as a list of pairs we can give QUrl
         QList< QPair<QString, QString> > urlParams = d->createQueryParams(request->additionalParameters());
@@ -222,7 +708,7 @@ void KQOAuthManager::executeRequest(KQOAuthRequest *request, const QVariant& use
         networkRequest.setUrl(urlWithParams);
 
         // Submit the request including the params.
-        QNetworkReply *reply = d->networkManager->get(networkRequest);
+        reply = d->transport()->get(networkRequest);
         connect(reply, SIGNAL(error(QNetworkReply::NetworkError)),
                  this, SLOT(slotError(QNetworkReply::NetworkError)));
 
@@ -230,18 +716,24 @@ void KQOAuthManager::executeRequest(KQOAuthRequest *request, const QVariant& use
 
         networkRequest.setHeader(QNetworkRequest::ContentTypeHeader, request->contentType());
 
-        QNetworkReply *reply;
         if (request->contentType() == "application/x-www-form-urlencoded") {
-          reply = d->networkManager->post(networkRequest, request->requestBody());
+          reply = d->transport()->post(networkRequest, request->requestBody());
         } else {
-          reply = d->networkManager->post(networkRequest, request->rawData());
+          reply = d->transport()->post(networkRequest, request->rawData());
         }
 
         connect(reply, SIGNAL(error(QNetworkReply::NetworkError)),
                  this, SLOT(slotError(QNetworkReply::NetworkError)));
     }
 
-    d->r->requestTimerStart();
+    if (reply) {
+        // Connected per reply, since the network access manager may be shared with other managers.
+        connect(reply, SIGNAL(finished()), this, SLOT(onReplyFinished()));
+        d->trackReply(reply, request, deadline);
+        d->watchHandshake(reply);
+    }
+
+    return reply;
 }
 
 void KQOAuthManager::executeAuthorizedRequest(KQOAuthRequest *request, int id) {
@@ -255,6 +747,8 @@ void KQOAuthManager::executeAuthorizedRequest(KQOAuthRequest *request, int id) {
         return;
     }
 
+    qint64 deadline = d->requestDeadline(request, d->clock.elapsed(), 0);
+
     if (!request->requestEndpoint().isValid()) {
         qWarning() << "Request endpoint URL is not valid. Cannot proceed.";
         d->error = KQOAuthManager::RequestEndpointError;
@@ -295,14 +789,9 @@ void KQOAuthManager::executeAuthorizedRequest(KQOAuthRequest *request, int id) {
         authHeader.append(header);
     }
     networkRequest.setRawHeader("Authorization", authHeader);
+    d->prepareNetworkRequest(networkRequest, request);
 
-
-    disconnect(d->networkManager, SIGNAL(finished(QNetworkReply *)),
-            this, SLOT(onRequestReplyReceived(QNetworkReply *)));
-    connect(d->networkManager, SIGNAL(finished(QNetworkReply *)),
-            this, SLOT(onAuthorizedRequestReplyReceived(QNetworkReply*)), Qt::UniqueConnection);
-
-    QNetworkReply *reply;
+    QNetworkReply *reply = 0;
     if (request->httpMethod() == KQOAuthRequest::GET) {
         // Get the requested additional params as a list of pairs we can give QUrl
         QList< QPair<QString, QString> > urlParams = d->createQueryParams(request->additionalParameters());
@@ -313,7 +802,7 @@ void KQOAuthManager::executeAuthorizedRequest(KQOAuthRequest *request, int id) {
         networkRequest.setUrl(urlWithParams);
 
         // Submit the request including the params.
-        reply = d->networkManager->get(networkRequest);
+        reply = d->transport()->get(networkRequest);
         connect(reply, SIGNAL(error(QNetworkReply::NetworkError)),
                  this, SLOT(slotError(QNetworkReply::NetworkError)));
 
@@ -322,16 +811,20 @@ void KQOAuthManager::executeAuthorizedRequest(KQOAuthRequest *request, int id) {
         networkRequest.setHeader(QNetworkRequest::ContentTypeHeader, request->contentType());
 
         if (request->contentType() == "application/x-www-form-urlencoded") {
-          reply = d->networkManager->post(networkRequest, request->requestBody());
+          reply = d->transport()->post(networkRequest, request->requestBody());
         } else {
-          reply = d->networkManager->post(networkRequest, request->rawData());
+          reply = d->transport()->post(networkRequest, request->rawData());
         }
 
         connect(reply, SIGNAL(error(QNetworkReply::NetworkError)),
                  this, SLOT(slotError(QNetworkReply::NetworkError)));
     }
-    d->requestIds.insert(reply, id);
-    d->r->requestTimerStart();
+    if (reply) {
+        connect(reply, SIGNAL(finished()), this, SLOT(onAuthorizedReplyFinished()));
+        d->requestIds.insert(reply, id);
+        d->trackReply(reply, request, deadline);
+        d->watchHandshake(reply);
+    }
 }
 
 
@@ -341,6 +834,46 @@ void KQOAuthManager::setHandleUserAuthorization(bool set) {
     d->autoAuth = set;
 }
 
+void KQOAuthManager::setAutomaticFlow(const QUrl &authorizationEndpoint, const QUrl &accessTokenEndpoint) {
+    Q_D(KQOAuthManager);
+
+    if (!authorizationEndpoint.isValid() || !accessTokenEndpoint.isValid()) {
+        qWarning() << "Endpoints for the automatic flow are not valid. Automatic flow is disabled.";
+        d->error = KQOAuthManager::RequestEndpointError;
+        d->automaticFlow = false;
+        return;
+    }
+
+    d->automaticFlow = true;
+    d->autoAuth = true;
+    d->flowAuthorizationEndpoint = authorizationEndpoint;
+    d->flowAccessTokenEndpoint = accessTokenEndpoint;
+
+    // The temporary token is usually asked from the same host.
+    d->preconnect(accessTokenEndpoint);
+}
+
+void KQOAuthManager::preconnect(const QUrl &endpoint) {
+    Q_D(KQOAuthManager);
+
+    if (!endpoint.isValid() || endpoint.host().isEmpty()) {
+        qWarning() << "Endpoint URL is not valid. Cannot preconnect.";
+        d->error = KQOAuthManager::RequestEndpointError;
+        return;
+    }
+
+    d->error = KQOAuthManager::NoError;
+    d->preconnect(endpoint);
+}
+
+void KQOAuthManager::clearAutomaticFlow() {
+    Q_D(KQOAuthManager);
+
+    d->automaticFlow = false;
+    d->flowAuthorizationEndpoint.clear();
+    d->flowAccessTokenEndpoint.clear();
+}
+
 bool KQOAuthManager::hasTemporaryToken() {
     Q_D(KQOAuthManager);
 
@@ -381,6 +914,109 @@ void KQOAuthManager::setNetworkManager(QNetworkAccessManager *manager) {
     d->networkManager = manager;
 }
 
+void KQOAuthManager::setUseSharedNetworkManager(bool shared) {
+    Q_D(KQOAuthManager);
+
+    QNetworkAccessManager *sharedManager = KQOAuthManagerPrivate::sharedNetworkManager();
+
+    if (shared) {
+        if (!d->managerUserSet) {
+            delete d->networkManager;
+        }
+
+        d->managerUserSet = true;
+        d->networkManager = sharedManager;
+    } else if (d->networkManager == sharedManager) {
+        // Back to a network access manager of our own, created on the next request.
+        d->managerUserSet = false;
+        d->networkManager = 0;
+    }
+}
+
+void KQOAuthManager::setHttpBackend(HttpBackend backend) {
+    Q_D(KQOAuthManager);
+    d->httpBackend = backend;
+}
+
+KQOAuthManager::HttpBackend KQOAuthManager::httpBackend() const {
+    Q_D(const KQOAuthManager);
+    return d->httpBackend;
+}
+
+void KQOAuthManager::setTransport(KQOAuthTransport *transport) {
+    Q_D(KQOAuthManager);
+    d->customTransport = transport;
+}
+
+KQOAuthTransport *KQOAuthManager::transport() const {
+    Q_D(const KQOAuthManager);
+    return d->customTransport;
+}
+
+void KQOAuthManager::setHttp2Enabled(bool enabled) {
+    Q_D(KQOAuthManager);
+
+#if QT_VERSION < 0x050800
+    if (enabled) {
+        qWarning() << "HTTP/2 needs Qt 5.8. Requests are sent over HTTP/1.1.";
+    }
+#endif
+
+    d->http2Enabled = enabled;
+}
+
+bool KQOAuthManager::isHttp2Enabled() const {
+    Q_D(const KQOAuthManager);
+    return d->http2Enabled;
+}
+
+void KQOAuthManager::setSessionCache(KQOAuthSessionCache *cache) {
+    Q_D(KQOAuthManager);
+
+#ifndef KQOAUTH_HAVE_SESSION_TICKETS
+    if (cache) {
+        qWarning() << "TLS sessions cannot be saved with this Qt. The session cache is not used.";
+    }
+#endif
+
+    d->sessionCache = cache;
+}
+
+void KQOAuthManager::setTokenStore(KQOAuthTokenStore *store, const QString &accountId) {
+    Q_D(KQOAuthManager);
+
+    d->tokenStore = store;
+    d->tokenStoreAccount = accountId;
+
+    if (store == 0) {
+        return;
+    }
+
+    if (!store->isOpen() && !store->open()) {
+        qWarning() << "Token store could not be opened. Tokens will not be saved.";
+        d->error = KQOAuthManager::ManagerError;
+        d->tokenStore = 0;
+        return;
+    }
+
+    KQOAuthTokenStore::Tokens tokens = store->tokens(accountId);
+    if (!tokens.isValid()) {
+        return;
+    }
+
+    d->requestToken = tokens.token;
+    d->requestTokenSecret = tokens.tokenSecret;
+    d->consumerKey = tokens.consumerKey;
+    d->consumerKeySecret = tokens.consumerSecret;
+    d->isVerified = true;
+    d->isAuthorized = true;
+}
+
+void KQOAuthManager::setCallbackPort(quint16 port) {
+    Q_D(KQOAuthManager);
+    d->callbackPort = port;
+}
+
 QNetworkAccessManager * KQOAuthManager::networkManager() const {
     Q_D(const KQOAuthManager);
 
@@ -416,9 +1052,24 @@ void KQOAuthManager::getUserAuthorization(QUrl authorizationEndpoint) {
     QUrl openWebPageUrl(authorizationEndpoint.toString(), QUrl::StrictMode);
     openWebPageUrl.addQueryItem(tokenParam.first, tokenParam.second);
 
-    // Open the user's default browser to the resource authorization page provided
-    // by the service.
-    QDesktopServices::openUrl(openWebPageUrl);
+    // Show the resource authorization page provided by the service to the user.
+    emit authorizationPageRequested(openWebPageUrl);
+
+    if (urlOpener) {
+        if (!urlOpener(openWebPageUrl)) {
+            qWarning() << "Could not open the authorization page" << openWebPageUrl;
+        }
+    } else if (receivers(SIGNAL(authorizationPageRequested(QUrl))) == 0) {
+        qWarning() << "No URL opener set. Cannot show the authorization page" << openWebPageUrl;
+    }
+}
+
+void KQOAuthManager::setAuthorizationUrlOpener(UrlOpener opener) {
+    urlOpener = opener;
+}
+
+KQOAuthManager::UrlOpener KQOAuthManager::authorizationUrlOpener() {
+    return urlOpener;
 }
 
 void KQOAuthManager::getUserAccessTokens(QUrl accessTokenEndpoint) {
@@ -438,15 +1089,15 @@ void KQOAuthManager::getUserAccessTokens(QUrl accessTokenEndpoint) {
 
     d->error = KQOAuthManager::NoError;
 
-    d->opaqueRequest->clearRequest();
-    d->opaqueRequest->initRequest(KQOAuthRequest::AccessToken, accessTokenEndpoint);
-    d->opaqueRequest->setToken(d->requestToken);
-    d->opaqueRequest->setTokenSecret(d->requestTokenSecret);
-    d->opaqueRequest->setVerifier(d->requestVerifier);
-    d->opaqueRequest->setConsumerKey(d->consumerKey);
-    d->opaqueRequest->setConsumerSecretKey(d->consumerKeySecret);
+    d->opaque()->clearRequest();
+    d->opaque()->initRequest(KQOAuthRequest::AccessToken, accessTokenEndpoint);
+    d->opaque()->setToken(d->requestToken);
+    d->opaque()->setTokenSecret(d->requestTokenSecret);
+    d->opaque()->setVerifier(d->requestVerifier);
+    d->opaque()->setConsumerKey(d->consumerKey);
+    d->opaque()->setConsumerSecretKey(d->consumerKeySecret);
 
-    executeRequest(d->opaqueRequest);
+    executeRequest(d->opaque());
 }
 
 void KQOAuthManager::sendAuthorizedRequest(QUrl requestEndpoint, const KQOAuthParameters &requestParameters) {
@@ -466,15 +1117,46 @@ void KQOAuthManager::sendAuthorizedRequest(QUrl requestEndpoint, const KQOAuthPa
 
     d->error = KQOAuthManager::NoError;
 
-    d->opaqueRequest->clearRequest();
-    d->opaqueRequest->initRequest(KQOAuthRequest::AuthorizedRequest, requestEndpoint);
-    d->opaqueRequest->setAdditionalParameters(requestParameters);
-    d->opaqueRequest->setToken(d->requestToken);
-    d->opaqueRequest->setTokenSecret(d->requestTokenSecret);
-    d->opaqueRequest->setConsumerKey(d->consumerKey);
-    d->opaqueRequest->setConsumerSecretKey(d->consumerKeySecret);
+    d->opaque()->clearRequest();
+    d->opaque()->initRequest(KQOAuthRequest::AuthorizedRequest, requestEndpoint);
+    d->opaque()->setAdditionalParameters(requestParameters);
+    d->opaque()->setToken(d->requestToken);
+    d->opaque()->setTokenSecret(d->requestTokenSecret);
+    d->opaque()->setConsumerKey(d->consumerKey);
+    d->opaque()->setConsumerSecretKey(d->consumerKeySecret);
+
+    executeRequest(d->opaque());
+}
+
+void KQOAuthManager::sendAuthorizedRequest(const KQOAuthCredentials &credentials, QUrl requestEndpoint,
+                                           const KQOAuthParameters &requestParameters,
+                                           const QVariant& userData) {
+    Q_D(KQOAuthManager);
+
+    if (!credentials.isValid()) {
+        qWarning() << "Invalid credentials. Cannot send authorized requests.";
+        d->error = KQOAuthManager::RequestUnauthorized;
+        return;
+    }
+
+    if (!requestEndpoint.isValid()) {
+        qWarning() << "Endpoint for authorized request is not valid. Cannot proceed.";
+        d->error = KQOAuthManager::RequestEndpointError;
+        return;
+    }
+
+    d->error = KQOAuthManager::NoError;
+
+    // The opaque request is signed right away in executeRequest(), so it can be reused
+    // for the next user as soon as this returns.
+    d->opaque()->clearRequest();
+    d->opaque()->initRequest(KQOAuthRequest::AuthorizedRequest, requestEndpoint);
+    d->opaque()->setAdditionalParameters(requestParameters);
+    d->opaque()->setToken(credentials.token());
+    d->opaque()->setConsumerKey(credentials.consumerKey());
+    d->opaque()->setSigningKeyForManager(credentials.signingKey());
 
-    executeRequest(d->opaqueRequest);
+    executeRequest(d->opaque(), userData);
 }
 
 
@@ -499,11 +1181,27 @@ void KQOAuthManager::onRequestReplyReceived( QNetworkReply *reply ) {
         break;
     }
 
+    // Release the deadline and find out which request this reply belongs to.
+    KQOAuthPendingRequest pending = d->untrackReply(reply);
+
+    // Keep a caller of executeBlocking() from deleting the request while we use it. If it
+    // has given up already, nobody waits for this reply and the request may be gone.
+    QMutexLocker requestLocker(pending.blockingCall ? &pending.blockingCall->requestLock : 0);
+    if (pending.blockingCall && pending.blockingCall->cancelled) {
+        reply->deleteLater();
+        return;
+    }
+
+    KQOAuthRequest *request = pending.request ? pending.request : d->r;
+    if (pending.timedOut) {
+        d->error = KQOAuthManager::RequestTimeout;
+    }
+
     KQOAuthReply queryReply;
 
     // Let's disconnect this slot first
     /*
-    disconnect(d->networkManager, SIGNAL(finished(QNetworkReply *)),
+    disconnect(d->network(), SIGNAL(finished(QNetworkReply *)),
             this, SLOT(onRequestReplyReceived(QNetworkReply *)));
     */
 
@@ -514,14 +1212,13 @@ void KQOAuthManager::onRequestReplyReceived( QNetworkReply *reply ) {
     queryReply.statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
     queryReply.contentType = reply->header(QNetworkRequest::ContentTypeHeader).toString();
     queryReply.userData = reply->request().attribute(userDataAttribute);
-
-    // Stop any timer we have set on the request.
-    d->r->requestTimerStop();
+    queryReply.error = d->error;
 
     // Just don't do anything if we didn't get anything useful.
     if(networkReply.isEmpty()) {
         reply->deleteLater();
         emit replyReceived(queryReply);
+        d->completeHandle(pending, queryReply);
         return;
     }
     QMultiMap<QString, QString> responseTokens;
@@ -531,29 +1228,44 @@ void KQOAuthManager::onRequestReplyReceived( QNetworkReply *reply ) {
         reply->deleteLater();
         emit requestReady(networkReply);
         emit replyReceived(queryReply);
-        d->emitTokens();
+        d->emitTokens(pending.requestType);
+        d->completeHandle(pending, queryReply);
         return;
     }
 
     responseTokens = d->createTokensFromResponse(networkReply);
-    d->opaqueRequest->clearRequest();
-    d->opaqueRequest->setHttpMethod(KQOAuthRequest::POST);   // XXX FIXME: Convenient API does not support GET
+    d->opaque()->clearRequest();
+    d->opaque()->setHttpMethod(KQOAuthRequest::POST);   // XXX FIXME: Convenient API does not support GET
     if (!d->isAuthorized || !d->isVerified) {
-        if (d->setSuccessfulRequestToken(responseTokens)) {
+        if (d->setSuccessfulRequestToken(responseTokens, pending.requestType)) {
             qDebug() << "Successfully got request tokens.";
-            d->consumerKey = d->r->consumerKeyForManager();
-            d->consumerKeySecret = d->r->consumerKeySecretForManager();
-            d->opaqueRequest->setSignatureMethod(KQOAuthRequest::HMAC_SHA1);
-            d->opaqueRequest->setCallbackUrl(d->r->callbackUrlForManager());
+            d->consumerKey = request->consumerKeyForManager();
+            d->consumerKeySecret = request->consumerKeySecretForManager();
+            d->opaque()->setSignatureMethod(KQOAuthRequest::HMAC_SHA1);
+            d->opaque()->setCallbackUrl(request->callbackUrlForManager());
+
+            // Route the callback carrying this token back to us.
+            if (d->autoAuth && d->callbackServer) {
+                d->callbackServer->registerFlow(d->requestToken, this);
+                d->callbackFlows.insert(d->requestToken);
+            }
+
+            d->emitTokens(pending.requestType);
 
-            d->emitTokens();
+            // Send the user on right away, and get the access token endpoint ready
+            // while the user is busy in the browser.
+            if (d->automaticFlow) {
+                d->preconnect(d->flowAccessTokenEndpoint);
+                getUserAuthorization(d->flowAuthorizationEndpoint);
+            }
 
-        } else if (d->setSuccessfulAuthorized(responseTokens)) {
+        } else if (d->setSuccessfulAuthorized(responseTokens, pending.requestType)) {
               qDebug() << "Successfully got access tokens.";
-              d->opaqueRequest->setSignatureMethod(KQOAuthRequest::HMAC_SHA1);
+              d->opaque()->setSignatureMethod(KQOAuthRequest::HMAC_SHA1);
+              d->saveTokensToStore();
 
-              d->emitTokens();
-          } else if (d->currentRequestType == KQOAuthRequest::AuthorizedRequest) {
+              d->emitTokens(pending.requestType);
+          } else if (pending.requestType == KQOAuthRequest::AuthorizedRequest) {
                 emit authorizedRequestDone();
             }
     }
@@ -562,6 +1274,42 @@ void KQOAuthManager::onRequestReplyReceived( QNetworkReply *reply ) {
     emit replyReceived(queryReply);
 
     reply->deleteLater();           // We need to clean this up, after the event processing is done.
+
+    // Last, since a handle may resume a coroutine that goes on to use the manager.
+    d->completeHandle(pending, queryReply);
+}
+
+void KQOAuthManager::onReplyFinished() {
+    Q_D(KQOAuthManager);
+
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    if (reply) {
+        d->saveSessionTicket(reply);
+        onRequestReplyReceived(reply);
+    }
+}
+
+void KQOAuthManager::onAuthorizedReplyFinished() {
+    Q_D(KQOAuthManager);
+
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    if (reply) {
+        d->saveSessionTicket(reply);
+        onAuthorizedRequestReplyReceived(reply);
+    }
+}
+
+void KQOAuthManager::onReplyEncrypted() {
+    Q_D(KQOAuthManager);
+
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    if (reply == 0 || d->sessionCache == 0) {
+        return;
+    }
+
+    QNetworkRequest request = reply->request();
+    d->sessionCache->recordHandshake(request.attribute(ticketOfferedAttribute).toBool(),
+                                     d->clock.elapsed() - request.attribute(sendTimeAttribute).toLongLong());
 }
 
 void KQOAuthManager::onAuthorizedRequestReplyReceived( QNetworkReply *reply ) {
@@ -583,17 +1331,19 @@ void KQOAuthManager::onAuthorizedRequestReplyReceived( QNetworkReply *reply ) {
         break;
     }
 
+    KQOAuthPendingRequest pending = d->untrackReply(reply);
+    if (pending.timedOut) {
+        d->error = KQOAuthManager::RequestTimeout;
+    }
+
     /*
-    disconnect(d->networkManager, SIGNAL(finished(QNetworkReply *)),
+    disconnect(d->network(), SIGNAL(finished(QNetworkReply *)),
             this, SLOT(onAuthorizedRequestReplyReceived(QNetworkReply *)));
     */
 
     // Read the content of the reply from the network.
     QByteArray networkReply = reply->readAll();
 
-    // Stop any timer we have set on the request.
-    d->r->requestTimerStop();
-
     // Just don't do anything if we didn't get anything useful.
     if(networkReply.isEmpty()) {
         reply->deleteLater();
@@ -607,9 +1357,9 @@ void KQOAuthManager::onAuthorizedRequestReplyReceived( QNetworkReply *reply ) {
     }
 
 
-    d->opaqueRequest->clearRequest();
-    d->opaqueRequest->setHttpMethod(KQOAuthRequest::POST);   // XXX FIXME: Convenient API does not support GET
-    if (d->currentRequestType == KQOAuthRequest::AuthorizedRequest) {
+    d->opaque()->clearRequest();
+    d->opaque()->setHttpMethod(KQOAuthRequest::POST);   // XXX FIXME: Convenient API does not support GET
+    if (pending.requestType == KQOAuthRequest::AuthorizedRequest) {
                 emit authorizedRequestDone();
      }
 
@@ -622,34 +1372,82 @@ void KQOAuthManager::onAuthorizedRequestReplyReceived( QNetworkReply *reply ) {
 void KQOAuthManager::onVerificationReceived(QMultiMap<QString, QString> response) {
     Q_D(KQOAuthManager);
 
+    // A denial carries the token as 'denied' and no verifier.
     QString token = response.value("oauth_token");
-    QString verifier = response.value("oauth_verifier");
-    if (verifier.isEmpty()) {
-        d->error = KQOAuthManager::RequestUnauthorized;
+    if (token.isEmpty()) {
+        token = response.value("denied");
     }
+    QString verifier = response.value("oauth_verifier");
+    d->callbackFlows.remove(token);
 
-    verifier = QUrl::fromPercentEncoding(verifier.toUtf8());     // We get the raw URL response here so we need to convert it back
-                                                                 // to plain string so we can percent encode it again later in requests.
-
-    if (d->error == KQOAuthManager::NoError) {
+    // Only this callback decides; the manager-wide error may belong to another request.
+    bool verified = !verifier.isEmpty();
+    if (verified) {
         d->requestVerifier = verifier;
         d->isVerified = true;
+    } else {
+        d->error = KQOAuthManager::RequestUnauthorized;
     }
 
     emit authorizationReceived(token, verifier);
+
+    // Exchange the verifier right away instead of waiting for the application.
+    if (d->automaticFlow && verified) {
+        getUserAccessTokens(d->flowAccessTokenEndpoint);
+    }
 }
 
 void KQOAuthManager::slotError(QNetworkReply::NetworkError error) {
     Q_UNUSED(error)
     Q_D(KQOAuthManager);
 
-    d->error = KQOAuthManager::NetworkError;
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+
+    if (d->pendingReplies.value(reply).timedOut) {
+        d->error = KQOAuthManager::RequestTimeout;
+    } else {
+        d->error = KQOAuthManager::NetworkError;
+    }
     QByteArray emptyResponse;
     emit requestReady(emptyResponse);
     emit authorizedRequestDone();
 
-    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
     d->requestIds.remove(reply);
     reply->deleteLater();
 }
 
+void KQOAuthManager::onDeadlineTimerFired() {
+    Q_D(KQOAuthManager);
+
+    d->deadlineTimerWakeup = -1;
+    QList<quint64> expired = d->deadlines.advance(d->clock.elapsed());
+    foreach (quint64 deadlineId, expired) {
+        QNetworkReply *reply = d->deadlineReplies.take(deadlineId);
+        if (reply == 0 || !d->pendingReplies.contains(reply)) {
+            continue;
+        }
+
+        KQOAuthPendingRequest &pending = d->pendingReplies[reply];
+        pending.timedOut = true;
+        pending.deadlineId = 0;
+        KQOAuthRequest *request = pending.request;
+
+        if (request) {
+            // A caller of executeBlocking() that gave up may have deleted the request.
+            QSharedPointer<KQOAuthBlockingCall> call = pending.blockingCall;
+            QMutexLocker requestLocker(call ? &call->requestLock : 0);
+            if (call && call->cancelled) {
+                pending.request = 0;
+            } else {
+                emit request->requestTimedout();
+            }
+        }
+
+        // Aborting frees the connection right away. The reply emits error() and
+        // finished() from here, which also removes it from pendingReplies.
+        reply->abort();
+    }
+
+    d->armDeadlineTimer();
+}
+
@@ -21,12 +21,20 @@
 #define KQOAUTHMANAGER_H
 
 #include <QObject>
+#include <QMetaType>
 #include <QMultiMap>
 #include <QNetworkReply>
 
 #include "kqoauthrequest.h"
 
 class KQOAuthRequest;
+class KQOAuthCredentials;
+class KQOAuthTokenStore;
+class KQOAuthSessionCache;
+class KQOAuthTransport;
+class KQOAuthPendingReply;
+class KQOAuthReplyAwaitable;
+struct KQOAuthAwaitState;
 class KQOAuthManagerThread;
 class KQOAuthManagerPrivate;
 class QNetworkAccessManager;
@@ -44,17 +52,26 @@ public:
         RequestValidationError,     // Request is not valid: some parameter missing?
         RequestUnauthorized,        // Authorization error: trying to access a resource without tokens.
         RequestError,               // The given request to KQOAuthManager is invalid: NULL?,
-        ManagerError                // Manager error, cannot use for sending requests.
+        ManagerError,               // Manager error, cannot use for sending requests.
+        RequestTimeout              // The request's deadline expired and the reply was aborted.
+    };
+
+    enum HttpBackend {
+        NetworkAccessManagerBackend = 0,    // QNetworkAccessManager, see setNetworkManager().
+        LeanHttpBackend                     // Built-in HTTP/1.1 client for high request rates.
     };
 
     /** Structure containing the minimum amount of information to process a request result */
     struct KQOAuthReply
     {
+        KQOAuthReply() : statusCode(0), error(NoError) {}
+
         int statusCode;
         QUrl url;
         QByteArray data;
         QString contentType;
         QVariant userData;
+        KQOAuthError error;
     };
 
     explicit KQOAuthManager(QObject *parent = 0);
@@ -66,9 +83,53 @@ public:
      * The manager executes the given request. It takes the HTTP parameters from the
      * request and uses QNetworkAccessManager to submit the HTTP request to the net.
      * When the request is done it will emit signal requestReady(QByteArray networkReply).
-     * NOTE: At the moment there is no timeout for the request.
+     * If the request has a timeout set, the deadline is counted from this call. When it
+     * expires the request emits requestTimedout(), the network reply is aborted and
+     * lastError() is set to RequestTimeout.
      */
     void executeRequest(KQOAuthRequest *request, const QVariant& userData = QVariant());
+    /**
+     * Executes the request like executeRequest() above and returns a handle that completes
+     * with this request's reply only. If 'receiver' and 'member' are given, 'member' is
+     * connected to KQOAuthPendingReply::finished() before the request is sent.
+     * The handle is never NULL; if the request cannot be sent it finishes with the error.
+     * The manager-wide signals are still emitted as well.
+     */
+    KQOAuthPendingReply *executeRequest(KQOAuthRequest *request, QObject *receiver, const char *member,
+                                        const QVariant& userData = QVariant());
+#ifdef KQOAUTH_HAVE_COROUTINES
+    /**
+     * Coroutine interface: 'KQOAuthReply reply = co_await manager->send(request);'
+     * The coroutine is resumed directly from the reply handler, without another pass
+     * through the event loop. The reply's 'error' member tells if the request failed; a
+     * request that cannot be sent does not suspend the coroutine at all.
+     * Defined in kqoauthawaitable.h.
+     */
+    KQOAuthReplyAwaitable send(KQOAuthRequest *request, const QVariant& userData = QVariant());
+#endif
+    /**
+     * Thread safe version of executeRequest(). The request is put to a lock-free queue and
+     * executed from the event loop of the manager's thread; requests posted in a burst are
+     * picked up together with a single wake-up. The request's timeout counts from this call.
+     * The request must not be touched by the caller until its reply has been received.
+     * A request that cannot be sent gets replyReceived() with the error set.
+     */
+    void postRequest(KQOAuthRequest *request, const QVariant& userData = QVariant());
+    /**
+     * Executes the request and blocks the calling thread until the reply arrives or
+     * 'timeoutMilliseconds' have passed, whichever comes first. If the request has a
+     * shorter timeout of its own, that one is used. On timeout the network request is
+     * aborted and the returned reply has the error RequestTimeout. A timeout of 0 waits
+     * for the reply without a limit of its own.
+     *
+     * This is meant for worker threads without an event loop. The manager's thread must
+     * be running its event loop; calling this from the manager's own thread fails with
+     * ManagerError. The request must not be deleted before this returns; after a timeout
+     * the manager no longer uses it and drops the late reply. If the manager is destroyed
+     * before the reply arrives, this returns right away with ManagerError.
+     */
+    KQOAuthReply executeBlocking(KQOAuthRequest *request, int timeoutMilliseconds,
+                                 const QVariant& userData = QVariant());
     void executeAuthorizedRequest(KQOAuthRequest *request, int id);
     /**
      * Indicates to the user that KQOAuthManager should handle user authorization by
@@ -80,6 +141,44 @@ public:
      *       sendAuthorizedRequest().
      */
     void setHandleUserAuthorization(bool set);
+    /**
+     * Runs the whole three-legged flow on its own. Once the temporary token arrives the manager
+     * opens the authorization page, and once the verifier arrives it asks for the access token
+     * right away. The connection to 'accessTokenEndpoint' is opened while the user is still in
+     * the browser. Only executeRequest() for the temporary token is needed; the application
+     * must not call getUserAuthorization() or getUserAccessTokens() itself.
+     * The signals for each step are still emitted, ending with accessTokenReceived().
+     * Implies setHandleUserAuthorization(true).
+     */
+    void setAutomaticFlow(const QUrl &authorizationEndpoint, const QUrl &accessTokenEndpoint);
+    void clearAutomaticFlow();
+    /**
+     * Resolves the host of 'endpoint' and opens a connection to it, encrypted for https, on
+     * the network access manager of this manager. The connection stays in its pool, so the
+     * first request to the host does not wait for the DNS, TCP and TLS set up.
+     * With Qt older than 5.2 this is done with a HEAD request to 'endpoint'.
+     * setAutomaticFlow() does this for the access token endpoint on its own.
+     */
+    void preconnect(const QUrl &endpoint);
+    /**
+     * Sets the preferred port of the local callback server used with setHandleUserAuthorization().
+     * The server is shared by all the managers of a thread and bound once, on the first
+     * authorization, so the first port set wins; later ones are ignored with a warning. If the
+     * port is taken, or none is given, any free port is used. The callback URL stays the same
+     * for every flow after that. The server only listens on localhost.
+     */
+    void setCallbackPort(quint16 port);
+
+    /** Shows the authorization page to the user. Returns false if the page could not be shown. */
+    typedef bool (*UrlOpener)(const QUrl &url);
+    /**
+     * Sets the function getUserAuthorization() uses to show the authorization page, for all
+     * managers of the process. Set it before starting any flow. The library itself does not
+     * depend on QtGui, so no opener is set by default; link the kqoauthgui library to open the
+     * page in the default browser, or connect to authorizationPageRequested() instead.
+     */
+    static void setAuthorizationUrlOpener(UrlOpener opener);
+    static UrlOpener authorizationUrlOpener();
 
     /**
      * Returns true if the KQOAuthManager has retrieved the oauth_token value. Otherwise
@@ -130,6 +229,15 @@ public:
      * Set setHandleUserAuthorization() to true and retrieve user authorization with void getUserAuthorization.
      */
     void sendAuthorizedRequest(QUrl requestEndpoint, const KQOAuthParameters &requestParameters);
+    /**
+     * Sends a request to the protected resources on behalf of the user whose credentials
+     * are given, typically taken from a KQOAuthCredentialRegistry. This does not use or
+     * change the tokens stored in the manager, so one manager can serve any number of users.
+     * The reply is delivered with replyReceived(), carrying 'userData'.
+     */
+    void sendAuthorizedRequest(const KQOAuthCredentials &credentials, QUrl requestEndpoint,
+                               const KQOAuthParameters &requestParameters,
+                               const QVariant& userData = QVariant());
 
     /**
      * Sets a custom QNetworkAccessManager to handle network requests. This method can be useful if the
@@ -146,12 +254,73 @@ public:
      */
     QNetworkAccessManager* networkManager() const;
 
+    /**
+     * Makes this manager use a QNetworkAccessManager shared by all the KQOAuthManagers
+     * of the calling thread that opt in, so they reuse each other's connections
+     * instead of each opening their own to the same service. The shared manager keeps
+     * no cookies, so the managers can not see each other's; anything else set on it,
+     * such as a proxy or answers to authenticationRequired(), is seen by all of them.
+     * The shared manager is deleted when the thread exits, or for the main thread, when
+     * QCoreApplication is destroyed. Passing false goes back to
+     * a QNetworkAccessManager of this manager's own. Replaces any manager given
+     * with setNetworkManager().
+     */
+    void setUseSharedNetworkManager(bool shared);
+
+    /**
+     * Attaches a persistent token store. If the store has access tokens for 'accountId',
+     * they are taken into use right away and isAuthorized() returns true, so
+     * sendAuthorizedRequest() can be called without running the authorization again.
+     * Access tokens received later are saved to the store under 'accountId'.
+     * The store is opened if it is not open yet. The application owns the store and must
+     * keep it alive while it is attached; call setTokenStore(0) to detach it.
+     */
+    void setTokenStore(KQOAuthTokenStore *store, const QString &accountId);
+
+    /**
+     * Attaches a TLS session cache. New https connections offer the session saved for the
+     * host, so the server can skip the full handshake, and the sessions given by the servers
+     * are saved to the cache. The application owns the cache and must keep it alive while it
+     * is attached; call setSessionCache(0) to detach it. Needs Qt 5.2 or newer.
+     */
+    void setSessionCache(KQOAuthSessionCache *cache);
+
+    /**
+     * Lets the requests of this manager use HTTP/2 when the service supports it. Requests to one
+     * host then share a single connection instead of waiting for one of the few HTTP/1.1
+     * connections, and KQOAuthRequest::priority() orders them on it. Services without HTTP/2
+     * are still served over HTTP/1.1. Needs Qt 5.8 or newer and https. Off by default.
+     */
+    void setHttp2Enabled(bool enabled);
+    bool isHttp2Enabled() const;
+
+    /**
+     * Chooses how the requests of this manager are sent. LeanHttpBackend is a small HTTP/1.1
+     * client with a pool of keep-alive connections per host, which pipelines GET requests
+     * and writes each request head at once. It skips the cookie jar, cache, proxies and
+     * redirects of QNetworkAccessManager, and with them most of its per request cost.
+     * The session cache and HTTP/2 only apply to NetworkAccessManagerBackend, the default.
+     */
+    void setHttpBackend(HttpBackend backend);
+    HttpBackend httpBackend() const;
+
+    /**
+     * Sends the requests of this manager with 'transport' instead of the backend chosen with
+     * setHttpBackend(), for example a KQOAuthLoopbackTransport in tests. The application owns
+     * the transport and must keep it alive while it is set; setTransport(0) goes back to the
+     * backend. transport() returns the transport set here, or 0.
+     */
+    void setTransport(KQOAuthTransport *transport);
+    KQOAuthTransport *transport() const;
+
 Q_SIGNALS:
     // This signal will be emitted after each request has got a reply.
     // Parameter is the raw response from the service.
     void requestReady(QByteArray networkReply);
 
-    void replyReceived(KQOAuthReply reply);
+    // Spelled out with the class name, so it can be queued between threads. String based
+    // connects must use SIGNAL(replyReceived(KQOAuthManager::KQOAuthReply)).
+    void replyReceived(KQOAuthManager::KQOAuthReply reply);
 
     void authorizedRequestReady(QByteArray networkReply, int id);
 
@@ -177,17 +346,44 @@ Q_SIGNALS:
     // This ends the kQOAuth interactions.
     void authorizedRequestDone();
 
+    // This signal is emited when getUserAuthorization() wants the user to visit the
+    // authorization page, before the URL opener is called.
+    void authorizationPageRequested(QUrl url);
+
 private Q_SLOTS:
     void onRequestReplyReceived( QNetworkReply *reply );
     void onAuthorizedRequestReplyReceived( QNetworkReply *reply );
+    void onReplyFinished();
+    void onAuthorizedReplyFinished();
+    void onReplyEncrypted();
     void onVerificationReceived(QMultiMap<QString, QString> response);
     void slotError(QNetworkReply::NetworkError error);
+    void onDeadlineTimerFired();
+
+protected:
+    void customEvent(QEvent *event);
 
 private:
+    QNetworkReply *sendRequest(KQOAuthRequest *request, const QVariant &userData, qint64 startTime,
+                               int timeout = 0);
+
+    // Used by KQOAuthReplyAwaitable. Not under KQOAUTH_HAVE_COROUTINES, since the library
+    // may be built without coroutine support and still be used from code that has it.
+    void awaitRequest(KQOAuthRequest *request, const QVariant &userData, KQOAuthAwaitState *state);
+    void forgetAwaitState(KQOAuthAwaitState *state);
+    friend class KQOAuthReplyAwaitable;
+
     KQOAuthManagerPrivate *d_ptr;
     Q_DECLARE_PRIVATE(KQOAuthManager);
     Q_DISABLE_COPY(KQOAuthManager);
 
 };
 
+Q_DECLARE_METATYPE(KQOAuthManager::KQOAuthReply)
+
+#ifdef KQOAUTH_HAVE_COROUTINES
+// Brings in the definition of KQOAuthManager::send().
+#  include "kqoauthawaitable.h"
+#endif
+
 #endif // KQOAUTHMANAGER_H
@@ -20,8 +20,40 @@
 #ifndef KQOAUTHMANAGER_P_H
 #define KQOAUTHMANAGER_P_H
 
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPointer>
+#include <QSet>
+#include <QSharedPointer>
+#include <QTimer>
+
 #include "kqoauthauthreplyserver.h"
+#include "kqoauthawaitable.h"
+#include "kqoauthhttpclient.h"
+#include "kqoauthtransport.h"
+#include "kqoauthpendingreply.h"
 #include "kqoauthrequest.h"
+#include "kqoauthsessioncache.h"
+#include "kqoauthsubmissionqueue.h"
+#include "kqoauthtimerwheel.h"
+#include "kqoauthtokenstore.h"
+
+// Book keeping for a request that has been handed to the network.
+struct KQOAuthPendingRequest
+{
+    KQOAuthPendingRequest() :
+        request(0), requestType(KQOAuthRequest::AuthorizedRequest), deadlineId(0), timedOut(false),
+        awaitState(0) {}
+
+    KQOAuthRequest *request;
+    // As it was when sent. Replies of a flow may overlap other requests of the manager.
+    KQOAuthRequest::RequestType requestType;
+    quint64 deadlineId;         // Id in the deadline wheel, 0 if the request has no timeout.
+    bool timedOut;
+    QPointer<KQOAuthPendingReply> handle;   // Set if the caller asked for a completion handle.
+    QSharedPointer<KQOAuthBlockingCall> blockingCall;   // Set if a thread waits in executeBlocking().
+    KQOAuthAwaitState *awaitState;          // Set if the request is awaited with co_await, not owned.
+};
 
 class KQOAUTH_EXPORT KQOAuthManagerPrivate {
 
@@ -29,12 +61,33 @@ public:
     KQOAuthManagerPrivate(KQOAuthManager *parent);
     ~KQOAuthManagerPrivate();
 
+    QNetworkAccessManager *network();
+    KQOAuthHttpClient *client();
+    KQOAuthTransport *transport();
+    static QNetworkAccessManager *sharedNetworkManager();
+    KQOAuthRequest *opaque();
+
     QList< QPair<QString, QString> > createQueryParams(const KQOAuthParameters &requestParams);
     QMultiMap<QString, QString> createTokensFromResponse(QByteArray reply);
-    bool setSuccessfulRequestToken(const QMultiMap<QString, QString> &request);
-    bool setSuccessfulAuthorized(const QMultiMap<QString, QString> &request);
-    void emitTokens();
+    bool setSuccessfulRequestToken(const QMultiMap<QString, QString> &request,
+                                   KQOAuthRequest::RequestType requestType);
+    bool setSuccessfulAuthorized(const QMultiMap<QString, QString> &request,
+                                 KQOAuthRequest::RequestType requestType);
+    void emitTokens(KQOAuthRequest::RequestType requestType);
+    void saveTokensToStore();
     bool setupCallbackServer();
+    void preconnect(const QUrl &endpoint);
+    void prepareNetworkRequest(QNetworkRequest &networkRequest, KQOAuthRequest *request);
+    void applySessionTicket(QNetworkRequest &request);
+    void watchHandshake(QNetworkReply *reply);
+    void saveSessionTicket(QNetworkReply *reply);
+
+    // Deadline handling for the requests in flight.
+    qint64 requestDeadline(KQOAuthRequest *request, qint64 startTime, int timeout);
+    void trackReply(QNetworkReply *reply, KQOAuthRequest *request, qint64 deadline);
+    KQOAuthPendingRequest untrackReply(QNetworkReply *reply);
+    void armDeadlineTimer();
+    void completeHandle(const KQOAuthPendingRequest &pending, const KQOAuthManager::KQOAuthReply &reply);
 
     KQOAuthManager::KQOAuthError error;
     KQOAuthRequest *r;                  // This request is used to cache the user sent request.
@@ -56,7 +109,9 @@ public:
     QString consumerKeySecret;
     QString requestVerifier;
 
-    KQOAuthAuthReplyServer *callbackServer;
+    QPointer<KQOAuthAuthReplyServer> callbackServer;   // Shared by the managers of this thread, not owned.
+    quint16 callbackPort;                       // Preferred port for the callback server, 0 for any.
+    QSet<QString> callbackFlows;                // Our tokens registered to the callback server.
 
     bool hasTemporaryToken;
     bool isVerified;
@@ -64,8 +119,37 @@ public:
     bool autoAuth;
     QNetworkAccessManager *networkManager;
     bool managerUserSet;
+    KQOAuthManager::HttpBackend httpBackend;
+    KQOAuthHttpClient *httpClient;      // Created on first use with LeanHttpBackend.
+    KQOAuthNetworkTransport networkTransport;
+    KQOAuthTransport *customTransport;  // Set with setTransport(), not owned.
     QMap<QNetworkReply*, int> requestIds;
 
+    QHash<QNetworkReply*, KQOAuthPendingRequest> pendingReplies;
+    QHash<quint64, QNetworkReply*> deadlineReplies;
+    quint64 nextDeadlineId;
+    KQOAuthTimerWheel deadlines;
+    QTimer deadlineTimer;           // Single timer driving all the deadlines of this manager.
+    qint64 deadlineTimerWakeup;     // When the timer is due, -1 if it is not running.
+    QElapsedTimer clock;
+
+    // Requests posted from other threads with postRequest().
+    KQOAuthSubmissionQueue submissions;
+
+    // Where the access tokens are saved, if set with setTokenStore().
+    KQOAuthTokenStore *tokenStore;
+    QString tokenStoreAccount;
+
+    // TLS sessions are saved to and resumed from this, if set with setSessionCache().
+    KQOAuthSessionCache *sessionCache;
+
+    bool http2Enabled;      // Set with setHttp2Enabled().
+
+    // Set with setAutomaticFlow().
+    bool automaticFlow;
+    QUrl flowAuthorizationEndpoint;
+    QUrl flowAccessTokenEndpoint;
+
     Q_DECLARE_PUBLIC(KQOAuthManager);
 };
 
@@ -0,0 +1,97 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QtDebug>
+
+#include "kqoauthmanagerthread.h"
+
+KQOAuthManagerThread::KQOAuthManagerThread(QObject *parent) :
+    QThread(parent),
+    manager(0),
+    transport(0)
+{
+    qRegisterMetaType<KQOAuthManager::KQOAuthReply>();
+}
+
+KQOAuthManagerThread::~KQOAuthManagerThread()
+{
+    stopAndWait();
+}
+
+void KQOAuthManagerThread::setTransport(KQOAuthTransport *transport) {
+    this->transport = transport;
+}
+
+void KQOAuthManagerThread::startAndWait() {
+    QMutexLocker locker(&mutex);
+
+    start();
+    while (manager == 0) {
+        managerReady.wait(&mutex);
+    }
+}
+
+void KQOAuthManagerThread::stopAndWait() {
+    if (isRunning()) {
+        quit();
+        wait();
+    }
+}
+
+void KQOAuthManagerThread::executeRequest(KQOAuthRequest *request, const QVariant &userData) {
+    // Held until the request is posted, so run() can not clear the manager and
+    // destroy it in between.
+    QMutexLocker locker(&mutex);
+
+    if (manager == 0) {
+        qWarning() << "Manager thread is not running. Cannot proceed.";
+
+        // Queued, so the reply arrives like any other, in the thread that owns us.
+        KQOAuthManager::KQOAuthReply failed;
+        failed.userData = userData;
+        failed.error = KQOAuthManager::ManagerError;
+        QMetaObject::invokeMethod(this, "replyReceived", Qt::QueuedConnection,
+                                  Q_ARG(KQOAuthManager::KQOAuthReply, failed));
+        return;
+    }
+
+    manager->postRequest(request, userData);
+}
+
+void KQOAuthManagerThread::run() {
+    // Everything created here, including the QNetworkAccessManager of the
+    // KQOAuthManager, lives in this thread and is destroyed in it.
+    KQOAuthManager threadManager;
+    threadManager.setTransport(transport);
+
+    // We live in the thread that created us, so the replies are queued over to it.
+    connect(&threadManager, SIGNAL(replyReceived(KQOAuthManager::KQOAuthReply)),
+            this, SIGNAL(replyReceived(KQOAuthManager::KQOAuthReply)));
+
+    mutex.lock();
+    manager = &threadManager;
+    managerReady.wakeAll();
+    mutex.unlock();
+
+    exec();
+
+    mutex.lock();
+    manager = 0;
+    mutex.unlock();
+}
@@ -0,0 +1,69 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHMANAGERTHREAD_H
+#define KQOAUTHMANAGERTHREAD_H
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "kqoauthmanager.h"
+
+/**
+ * A worker thread with its own event loop and its own KQOAuthManager (and by
+ * that its own QNetworkAccessManager). Used by KQOAuthThreadedManager.
+ */
+class KQOAUTH_EXPORT KQOAuthManagerThread : public QThread
+{
+    Q_OBJECT
+public:
+    explicit KQOAuthManagerThread(QObject *parent = 0);
+    ~KQOAuthManagerThread();
+
+    // Transport for the manager of the thread, see KQOAuthManager::setTransport(). It is
+    // used from the worker thread. Must be set before startAndWait().
+    void setTransport(KQOAuthTransport *transport);
+
+    // Starts the thread and returns once its manager is ready to take requests.
+    void startAndWait();
+    // Stops the event loop of the thread and waits for it to finish.
+    void stopAndWait();
+
+    // Hands the request to the manager of this thread. Thread safe, also while the
+    // thread is being started or stopped.
+    // The request must not be touched until its reply has been received. If the thread
+    // is not running, replyReceived() is emitted with ManagerError.
+    void executeRequest(KQOAuthRequest *request, const QVariant &userData);
+
+Q_SIGNALS:
+    // Emitted in the thread that owns this object (not the worker thread).
+    void replyReceived(KQOAuthManager::KQOAuthReply reply);
+
+protected:
+    void run();
+
+private:
+    KQOAuthManager *manager;    // Guarded by mutex.
+    KQOAuthTransport *transport;
+    QMutex mutex;
+    QWaitCondition managerReady;
+};
+
+#endif // KQOAUTHMANAGERTHREAD_H
@@ -0,0 +1,103 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QTimer>
+
+#include "kqoauthpendingreply.h"
+#include "kqoauthpendingreply_p.h"
+
+////////////// Private d_ptr implementation ////////////////
+
+KQOAuthPendingReplyPrivate::KQOAuthPendingReplyPrivate() :
+    error(KQOAuthManager::NoError),
+    finished(false)
+{
+
+}
+
+KQOAuthPendingReplyPrivate::~KQOAuthPendingReplyPrivate()
+{
+
+}
+
+/////////////// Public implementation ////////////////
+
+KQOAuthPendingReply::KQOAuthPendingReply(QObject *parent) :
+    QObject(parent),
+    d_ptr(new KQOAuthPendingReplyPrivate)
+{
+
+}
+
+KQOAuthPendingReply::~KQOAuthPendingReply()
+{
+    delete d_ptr;
+}
+
+bool KQOAuthPendingReply::isFinished() const {
+    Q_D(const KQOAuthPendingReply);
+    return d->finished;
+}
+
+KQOAuthManager::KQOAuthError KQOAuthPendingReply::error() const {
+    Q_D(const KQOAuthPendingReply);
+    return d->error;
+}
+
+KQOAuthManager::KQOAuthReply KQOAuthPendingReply::reply() const {
+    Q_D(const KQOAuthPendingReply);
+    return d->reply;
+}
+
+KQOAuthPendingReply *KQOAuthPendingReply::then(QObject *receiver, const char *member) {
+    if (receiver != 0 && member != 0) {
+        connect(this, SIGNAL(finished(KQOAuthManager::KQOAuthReply)), receiver, member);
+    }
+
+    return this;
+}
+
+void KQOAuthPendingReply::complete(const KQOAuthReply &reply, KQOAuthManager::KQOAuthError error) {
+    Q_D(KQOAuthPendingReply);
+
+    d->reply = reply;
+    d->error = error;
+    emitFinished();
+}
+
+void KQOAuthPendingReply::fail(KQOAuthManager::KQOAuthError error, const QVariant &userData) {
+    Q_D(KQOAuthPendingReply);
+
+    d->error = error;
+    d->reply.error = error;
+    d->reply.userData = userData;
+    QTimer::singleShot(0, this, SLOT(emitFinished()));
+}
+
+void KQOAuthPendingReply::emitFinished() {
+    Q_D(KQOAuthPendingReply);
+
+    if (d->finished) {
+        return;
+    }
+
+    d->finished = true;
+    emit finished(d->reply);
+    deleteLater();
+}
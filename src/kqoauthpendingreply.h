@@ -0,0 +1,79 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHPENDINGREPLY_H
+#define KQOAUTHPENDINGREPLY_H
+
+#include <QObject>
+
+#include "kqoauthmanager.h"
+
+/**
+ * Completion handle for a single request sent with
+ * KQOAuthManager::executeRequest(request, receiver, member).
+ *
+ * finished() is emitted for this request only, and always from the event loop,
+ * never from within executeRequest(). It is therefore safe to connect to it, or
+ * to call then(), right after executeRequest() has returned.
+ * The handle deletes itself after finished() has been emitted, so keep it in a QPointer
+ * if it is needed after that.
+ */
+class KQOAuthPendingReplyPrivate;
+class KQOAUTH_EXPORT KQOAuthPendingReply : public QObject
+{
+    Q_OBJECT
+public:
+    typedef KQOAuthManager::KQOAuthReply KQOAuthReply;
+
+    ~KQOAuthPendingReply();
+
+    bool isFinished() const;
+    // Valid after the reply has finished.
+    KQOAuthManager::KQOAuthError error() const;
+    KQOAuthReply reply() const;
+
+    /**
+     * Connects 'member' of 'receiver' to finished(). The member must take a
+     * KQOAuthManager::KQOAuthReply, spelled out like that (as a SLOT() or SIGNAL()). Returns this handle so that calls can be chained.
+     */
+    KQOAuthPendingReply *then(QObject *receiver, const char *member);
+
+Q_SIGNALS:
+    void finished(KQOAuthManager::KQOAuthReply reply);
+
+private Q_SLOTS:
+    void emitFinished();
+
+private:
+    explicit KQOAuthPendingReply(QObject *parent);
+
+    // Completes the handle right away. Used by KQOAuthManager when the reply arrives.
+    void complete(const KQOAuthReply &reply, KQOAuthManager::KQOAuthError error);
+    // Completes the handle from the event loop. Used when a request fails before it is sent.
+    void fail(KQOAuthManager::KQOAuthError error, const QVariant &userData);
+
+    KQOAuthPendingReplyPrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(KQOAuthPendingReply);
+    Q_DISABLE_COPY(KQOAuthPendingReply);
+
+    friend class KQOAuthManager;
+    friend class KQOAuthManagerPrivate;
+};
+
+#endif // KQOAUTHPENDINGREPLY_H
@@ -0,0 +1,65 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHPERTHREAD_H
+#define KQOAUTHPERTHREAD_H
+
+#include <QCoreApplication>
+#include <QThread>
+#include <QThreadStorage>
+
+/**
+ * One instance of T per thread, for objects like QNetworkAccessManager and QTcpServer
+ * that may only be used from their own thread. The instance is created on first use
+ * with 'create' and deleted when its thread exits. The main thread's instance is deleted
+ * when QCoreApplication is, since QThreadStorage would only get to it after that, with
+ * the application's event dispatcher already gone.
+ */
+template <typename T>
+class KQOAuthPerThread
+{
+public:
+    static T *instance(T *(*create)()) {
+        QThreadStorage<T *> &instances = storage();
+
+        if (!instances.hasLocalData()) {
+            instances.setLocalData(create());
+
+            QCoreApplication *application = QCoreApplication::instance();
+            if (application && QThread::currentThread() == application->thread()) {
+                qAddPostRoutine(deleteMainThreadInstance);
+            }
+        }
+
+        return instances.localData();
+    }
+
+private:
+    static QThreadStorage<T *> &storage() {
+        static QThreadStorage<T *> instances;
+        return instances;
+    }
+
+    // Run when QCoreApplication is destroyed, which the main thread outlives.
+    static void deleteMainThreadInstance() {
+        storage().setLocalData(0);
+    }
+};
+
+#endif // KQOAUTHPERTHREAD_H
@@ -22,6 +22,9 @@
 #include <QCryptographicHash>
 #include <QPair>
 #include <QStringList>
+#include <QThread>
+#include <QThreadStorage>
+#include <QTime>
 
 #include <QtDebug>
 #include <QtAlgorithms>
@@ -35,7 +38,8 @@
 //////////// Private d_ptr implementation /////////
 
 KQOAuthRequestPrivate::KQOAuthRequestPrivate() :
-    timeout(0)
+    timeout(0),
+    priority(KQOAuthRequest::NormalPriority)
 {
 
 }
@@ -102,8 +106,13 @@ QString KQOAuthRequestPrivate::oauthSignature()  {
      **/
     QByteArray baseString = this->requestBaseString();
 
-    QString secret = QString(QUrl::toPercentEncoding(oauthConsumerSecretKey)) + "&" + QString(QUrl::toPercentEncoding(oauthTokenSecret));
-    QString signature = KQOAuthUtils::hmac_sha1(baseString, secret);
+    QString signature;
+    if (!signingKey.isEmpty()) {
+        signature = KQOAuthUtils::hmac_sha1_with_key(baseString, signingKey);
+    } else {
+        QString secret = QString(QUrl::toPercentEncoding(oauthConsumerSecretKey)) + "&" + QString(QUrl::toPercentEncoding(oauthTokenSecret));
+        signature = KQOAuthUtils::hmac_sha1(baseString, secret);
+    }
 
     if (debugOutput) {
         qDebug() << "========== KQOAuthRequest has the following signature:";
@@ -112,38 +121,23 @@ QString KQOAuthRequestPrivate::oauthSignature()  {
     return QString( QUrl::toPercentEncoding(signature) );
 }
 
-bool normalizedParameterSort(const QPair<QString, QString> &left, const QPair<QString, QString> &right) {
-    QString keyLeft = left.first;
-    QString valueLeft = left.second;
-    QString keyRight = right.first;
-    QString valueRight = right.second;
-
-    if(keyLeft == keyRight) {
-        return (valueLeft < valueRight);
-    } else {
-        return (keyLeft < keyRight);
-    }
-}
 QByteArray KQOAuthRequestPrivate::requestBaseString() {
-    QByteArray baseString;
-
-    // Every request has these as the commont parameters.
-    baseString.append( oauthHttpMethodString.toUtf8() + "&");                                                     // HTTP method
-    baseString.append( QUrl::toPercentEncoding( oauthRequestEndpoint.toString(QUrl::RemoveQuery) ) + "&" ); // The path and query components
-
     QList< QPair<QString, QString> > baseStringParameters;
     baseStringParameters.append(requestParameters);
     baseStringParameters.append(additionalParameters);
 
-    // Sort the request parameters. These parameters have been
-    // initialized earlier.
-    qSort(baseStringParameters.begin(),
-          baseStringParameters.end(),
-          normalizedParameterSort
-          );
+    if (debugOutput) {
+        qDebug() << "========== KQOAuthRequest has the following parameters:";
+        QPair<QString, QString> parameter;
+        foreach (parameter, baseStringParameters) {
+            qDebug() << " * " << parameter.first << " : " << parameter.second;
+        }
+        qDebug() << "\n";
+    }
 
-    // Last append the request parameters correctly encoded.
-    baseString.append( encodedParamaterList(baseStringParameters) );
+    // The same rules as KQOAuthVerifier uses on the receiving end.
+    QByteArray baseString = KQOAuthUtils::signatureBaseString(oauthHttpMethodString, oauthRequestEndpoint,
+                                                              baseStringParameters);
 
     if (debugOutput) {
         qDebug() << "========== KQOAuthRequest has the following base string:";
@@ -153,43 +147,6 @@ QByteArray KQOAuthRequestPrivate::requestBaseString() {
     return baseString;
 }
 
-QByteArray KQOAuthRequestPrivate::encodedParamaterList(const QList< QPair<QString, QString> > &parameters) {
-    QByteArray resultList;
-
-    bool first = true;
-    QPair<QString, QString> parameter;
-
-    // Do the debug output.
-    if (debugOutput) {
-        qDebug() << "========== KQOAuthRequest has the following parameters:";
-    }
-    foreach (parameter, parameters) {
-        if(!first) {
-            resultList.append( "&" );
-        } else {
-            first = false;
-        }
-
-        // Here we don't need to explicitely encode the strings to UTF-8 since
-        // QUrl::toPercentEncoding() takes care of that for us.
-        resultList.append( QUrl::toPercentEncoding(parameter.first)     // Parameter key
-                           + "="
-                           + QUrl::toPercentEncoding(parameter.second)  // Parameter value
-                          );
-        if (debugOutput) {
-            qDebug() << " * "
-                     << parameter.first
-                     << " : "
-                     << parameter.second;
-        }
-    }
-    if (debugOutput) {
-        qDebug() << "\n";
-    }
-
-    return QUrl::toPercentEncoding(resultList);
-}
-
 QString KQOAuthRequestPrivate::oauthTimestamp(bool forceNew) const {
     // This is basically for unit tests only. In most cases we don't set the nonce beforehand.
     if (!forceNew && !oauthTimestamp_.isEmpty()) {
@@ -210,6 +167,15 @@ QString KQOAuthRequestPrivate::oauthNonce(bool forceNew) const {
         return oauthNonce_;
     }
 
+    // qrand() is per thread, so seed it once in each thread. Seeding for every request
+    // could give the same seed, and thus the same nonce, to requests made close together.
+    static QThreadStorage<bool *> seeded;
+    if (!seeded.hasLocalData()) {
+        qsrand(QTime::currentTime().msec() ^ QDateTime::currentDateTime().toTime_t()
+               ^ static_cast<uint>(reinterpret_cast<quintptr>(QThread::currentThreadId())));
+        seeded.setLocalData(new bool(true));
+    }
+
     return QString::number(qrand());
 }
 
@@ -249,7 +215,7 @@ bool KQOAuthRequestPrivate::validateRequest() const {
             || oauthSignatureMethod.isEmpty()
             || oauthTimestamp_.isEmpty()
             || oauthToken.isEmpty()
-            || oauthTokenSecret.isEmpty()
+            || (oauthTokenSecret.isEmpty() && signingKey.isEmpty())
             || oauthVersion.isEmpty())
         {
             return false;
@@ -271,9 +237,6 @@ KQOAuthRequest::KQOAuthRequest(QObject *parent) :
     d_ptr(new KQOAuthRequestPrivate)
 {
     d_ptr->debugOutput = false;  // No debug output by default.
-    qsrand(QTime::currentTime().msec());  // We need to seed the nonce random number with something.
-                                          // However, we cannot do this while generating the nonce since
-                                          // we might get the same seed. So initializing here should be fine.
 }
 
 KQOAuthRequest::~KQOAuthRequest()
@@ -519,6 +482,16 @@ void KQOAuthRequest::setTimeout(int timeoutMilliseconds) {
     d->timeout = timeoutMilliseconds;
 }
 
+void KQOAuthRequest::setPriority(KQOAuthRequest::RequestPriority priority) {
+    Q_D(KQOAuthRequest);
+    d->priority = priority;
+}
+
+KQOAuthRequest::RequestPriority KQOAuthRequest::priority() const {
+    Q_D(const KQOAuthRequest);
+    return d->priority;
+}
+
 void KQOAuthRequest::clearRequest() {
     Q_D(KQOAuthRequest);
 
@@ -527,6 +500,7 @@ void KQOAuthRequest::clearRequest() {
     d->oauthToken = "";
     d->oauthTokenSecret = "";
     d->oauthSignatureMethod = "";
+    d->signingKey.clear();
     resetRequest();
 }
 
@@ -542,6 +516,7 @@ void KQOAuthRequest::resetRequest() {
     d->requestParameters.clear();
     d->additionalParameters.clear();
     d->timeout = 0;
+    d->priority = KQOAuthRequest::NormalPriority;
 }
 
 void KQOAuthRequest::setEnableDebugOutput(bool enabled) {
@@ -586,20 +561,12 @@ QUrl KQOAuthRequest::callbackUrlForManager() const {
     return d->oauthCallbackUrl;
 }
 
-void KQOAuthRequest::requestTimerStart()
-{
-    Q_D(KQOAuthRequest);
-    if (d->timeout > 0) {
-        connect(&(d->timer), SIGNAL(timeout()), this, SIGNAL(requestTimedout()));
-        d->timer.start(d->timeout);
-    }
+int KQOAuthRequest::timeoutForManager() const {
+    Q_D(const KQOAuthRequest);
+    return d->timeout;
 }
 
-void KQOAuthRequest::requestTimerStop()
-{
+void KQOAuthRequest::setSigningKeyForManager(const QByteArray &signingKey) {
     Q_D(KQOAuthRequest);
-    if (d->timeout > 0) {
-        disconnect(&(d->timer), SIGNAL(timeout()), this, SIGNAL(requestTimedout()));
-        d->timer.stop();
-    }
+    d->signingKey = signingKey;
 }
@@ -21,6 +21,7 @@
 #define KQOAUTHREQUEST_H
 
 #include <QObject>
+#include <QMetaType>
 #include <QUrl>
 #include <QMultiMap>
 
@@ -53,6 +54,12 @@ public:
         POST
     };
 
+    enum RequestPriority {
+        HighPriority = 0,
+        NormalPriority,
+        LowPriority
+    };
+
     /**
      * These methods can be overridden in child classes which are different types of
      * OAuth requests.
@@ -90,12 +97,17 @@ public:
     void setHttpMethod(KQOAuthRequest::RequestHttpMethod = KQOAuthRequest::POST);
     KQOAuthRequest::RequestHttpMethod httpMethod() const;
 
-    // Sets the timeout for this request. If the timeout expires, signal "requestTimedout" will be
-    // emitted from the manager.
+    // Sets the timeout for this request. The deadline starts when the request is given to
+    // KQOAuthManager. If it expires, signal "requestTimedout" is emitted and the manager
+    // aborts the network reply.
     // 0 = If set to zero, timeout is disabled.
-    // TODO: Do we need some request ID now?
     void setTimeout(int timeoutMilliseconds);
 
+    // Priority of this request among the requests in flight to the same host. Over HTTP/2
+    // it orders the streams on the shared connection. Defaults to NormalPriority.
+    void setPriority(KQOAuthRequest::RequestPriority priority);
+    KQOAuthRequest::RequestPriority priority() const;
+
     // Additional optional parameters to the request.
     void setAdditionalParameters(const KQOAuthParameters &additionalParams);
     KQOAuthParameters additionalParameters() const;
@@ -138,13 +150,18 @@ private:
     QUrl callbackUrlForManager() const;
 
     // This method is for timeout handling by the KQOAuthManager.
-    void requestTimerStart();
-    void requestTimerStop();
+    int timeoutForManager() const;
+
+    // Used by KQOAuthManager to sign with the precomputed key of registry credentials.
+    void setSigningKeyForManager(const QByteArray &signingKey);
 
     friend class KQOAuthManager;
 #ifdef UNIT_TEST
     friend class Ut_KQOAuth;
+    friend class Bench_KQOAuth;
 #endif
 };
 
+Q_DECLARE_METATYPE(KQOAuthRequest *)
+
 #endif // KQOAUTHREQUEST_H
@@ -27,7 +27,6 @@
 #include <QMap>
 #include <QPair>
 #include <QMultiMap>
-#include <QTimer>
 
 class KQOAUTH_EXPORT KQOAuthRequestPrivate {
 
@@ -45,7 +44,6 @@ public:
     void signRequest();
     bool validateRequest() const;
     QByteArray requestBaseString();
-    QByteArray encodedParamaterList(const QList< QPair<QString, QString> > &requestParameters);
     void insertAdditionalParams();
     void insertPostBody();
 
@@ -85,7 +83,12 @@ public:
 
     // Timeout for this request in milliseconds.
     int timeout;
-    QTimer timer;
+
+    KQOAuthRequest::RequestPriority priority;
+
+    // Prepared HMAC-SHA1 key set by the manager for registry credentials. Used
+    // instead of the consumer and token secrets when not empty.
+    QByteArray signingKey;
 
     bool debugOutput;
 
@@ -0,0 +1,251 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QDataStream>
+#include <QFile>
+#include <QtDebug>
+
+#include "kqoauthsessioncache.h"
+#include "kqoauthsessioncache_p.h"
+
+namespace
+{
+    const quint32 cacheMagic = 0x4b515453;
+    // Version 2 fixed the stream version. Version 1 files depend on the Qt that wrote them.
+    const quint32 cacheVersion = 2;
+    // Fixed, so a cache written by one Qt reads back with another. Qt 4.6 is the newest
+    // version Qt 4.7 knows, and Qt_4_7 and Qt_4_8 are the same format.
+    const QDataStream::Version streamVersion = QDataStream::Qt_4_6;
+    // Servers rarely accept tickets older than this.
+    const int ticketLifetime = 24 * 60 * 60;
+    const int maximumTickets = 64;
+}
+
+//////////// Private d_ptr implementation /////////
+
+KQOAuthSessionCachePrivate::KQOAuthSessionCachePrivate(const QString &fileName) :
+    fileName(fileName),
+    changed(false)
+{
+    handshakes[0] = handshakes[1] = 0;
+    handshakeTime[0] = handshakeTime[1] = 0;
+}
+
+void KQOAuthSessionCachePrivate::dropExpired() {
+    QDateTime oldest = QDateTime::currentDateTime().addSecs(-ticketLifetime);
+
+    QHash<QString, KQOAuthSessionTicket>::iterator it = tickets.begin();
+    while (it != tickets.end()) {
+        if (it.value().saved < oldest) {
+            it = tickets.erase(it);
+            changed = true;
+        } else {
+            ++it;
+        }
+    }
+}
+
+/////////////// Public implementation ////////////////
+
+KQOAuthSessionCache::KQOAuthSessionCache(const QString &fileName) :
+    d_ptr(new KQOAuthSessionCachePrivate(fileName))
+{
+
+}
+
+KQOAuthSessionCache::~KQOAuthSessionCache() {
+    Q_D(KQOAuthSessionCache);
+
+    if (d->changed) {
+        save();
+    }
+
+    delete d_ptr;
+}
+
+bool KQOAuthSessionCache::load() {
+    Q_D(KQOAuthSessionCache);
+
+    QFile file(d->fileName);
+    if (!file.exists()) {
+        return true;
+    }
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Cannot open session cache" << d->fileName;
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(streamVersion);
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 count = 0;
+    stream >> magic >> version >> count;
+    if (magic != cacheMagic || count < 0) {
+        qWarning() << "Session cache" << d->fileName << "is corrupted.";
+        return false;
+    }
+    if (version != cacheVersion) {
+        qWarning() << "Session cache" << d->fileName << "has unsupported version" << version;
+        return false;
+    }
+
+    d->tickets.clear();
+    for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        QString host;
+        KQOAuthSessionTicket entry;
+        stream >> host >> entry.ticket >> entry.saved;
+        d->tickets.insert(host, entry);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Session cache" << d->fileName << "is corrupted.";
+        d->tickets.clear();
+        return false;
+    }
+
+    d->changed = false;
+    d->dropExpired();
+    return true;
+}
+
+bool KQOAuthSessionCache::save() {
+    Q_D(KQOAuthSessionCache);
+
+    d->dropExpired();
+
+    // Written aside and renamed, so a crash never leaves half a cache behind.
+    QFile file(d->fileName + ".tmp");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Cannot write session cache" << file.fileName();
+        return false;
+    }
+    file.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+
+    QDataStream stream(&file);
+    stream.setVersion(streamVersion);
+    stream << cacheMagic << cacheVersion << qint32(d->tickets.size());
+
+    QHash<QString, KQOAuthSessionTicket>::const_iterator it;
+    for (it = d->tickets.constBegin(); it != d->tickets.constEnd(); ++it) {
+        stream << it.key() << it.value().ticket << it.value().saved;
+    }
+    file.close();
+
+    QFile::remove(d->fileName);
+    if (stream.status() != QDataStream::Ok || !file.rename(d->fileName)) {
+        qWarning() << "Cannot write session cache" << d->fileName;
+        return false;
+    }
+
+    d->changed = false;
+    return true;
+}
+
+QByteArray KQOAuthSessionCache::sessionTicket(const QString &host) const {
+    Q_D(const KQOAuthSessionCache);
+
+    QHash<QString, KQOAuthSessionTicket>::const_iterator it = d->tickets.constFind(host.toLower());
+    if (it == d->tickets.constEnd()
+        || it.value().saved.secsTo(QDateTime::currentDateTime()) > ticketLifetime) {
+        return QByteArray();
+    }
+
+    return it.value().ticket;
+}
+
+void KQOAuthSessionCache::setSessionTicket(const QString &host, const QByteArray &ticket) {
+    Q_D(KQOAuthSessionCache);
+
+    if (ticket.isEmpty()) {
+        removeSessionTicket(host);
+        return;
+    }
+
+    KQOAuthSessionTicket &entry = d->tickets[host.toLower()];
+    if (entry.ticket == ticket) {
+        return;
+    }
+
+    entry.ticket = ticket;
+    entry.saved = QDateTime::currentDateTime();
+    d->changed = true;
+
+    // Make room by dropping the oldest ticket.
+    if (d->tickets.size() > maximumTickets) {
+        QHash<QString, KQOAuthSessionTicket>::iterator oldest = d->tickets.begin();
+        QHash<QString, KQOAuthSessionTicket>::iterator it;
+        for (it = d->tickets.begin(); it != d->tickets.end(); ++it) {
+            if (it.value().saved < oldest.value().saved) {
+                oldest = it;
+            }
+        }
+        d->tickets.erase(oldest);
+    }
+}
+
+void KQOAuthSessionCache::removeSessionTicket(const QString &host) {
+    Q_D(KQOAuthSessionCache);
+
+    if (d->tickets.remove(host.toLower()) > 0) {
+        d->changed = true;
+    }
+}
+
+int KQOAuthSessionCache::count() const {
+    Q_D(const KQOAuthSessionCache);
+    return d->tickets.size();
+}
+
+int KQOAuthSessionCache::offeredCount() const {
+    Q_D(const KQOAuthSessionCache);
+    return d->handshakes[1];
+}
+
+qint64 KQOAuthSessionCache::averageHandshakeTime(bool offered) const {
+    Q_D(const KQOAuthSessionCache);
+
+    int index = offered ? 1 : 0;
+    if (d->handshakes[index] == 0) {
+        return -1;
+    }
+
+    return d->handshakeTime[index] / d->handshakes[index];
+}
+
+qint64 KQOAuthSessionCache::savedHandshakeTime() const {
+    Q_D(const KQOAuthSessionCache);
+
+    qint64 full = averageHandshakeTime(false);
+    qint64 resumed = averageHandshakeTime(true);
+    if (full < 0 || resumed < 0 || resumed >= full) {
+        return 0;
+    }
+
+    return (full - resumed) * d->handshakes[1];
+}
+
+void KQOAuthSessionCache::recordHandshake(bool offered, qint64 milliseconds) {
+    Q_D(KQOAuthSessionCache);
+
+    int index = offered ? 1 : 0;
+    d->handshakes[index]++;
+    d->handshakeTime[index] += milliseconds;
+}
@@ -0,0 +1,77 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHSESSIONCACHE_H
+#define KQOAUTHSESSIONCACHE_H
+
+#include <QByteArray>
+#include <QString>
+
+#include "kqoauthglobals.h"
+
+class KQOAuthSessionCachePrivate;
+
+/**
+ * On-disk cache of TLS session tickets, keyed by host.
+ *
+ * Attach a cache to KQOAuthManager with KQOAuthManager::setSessionCache(). The manager
+ * offers the saved ticket of a host on its first https connection to it, which lets the
+ * server resume the session with an abbreviated handshake, and saves the tickets it is
+ * given. This mostly helps short lived processes, which would otherwise do a full
+ * handshake on every run.
+ *
+ * Tickets are dropped after a day. Needs Qt 5.2 or newer with SSL support; with older Qt
+ * the cache is kept but never used. The cache is not thread safe.
+ */
+class KQOAUTH_EXPORT KQOAuthSessionCache
+{
+public:
+    explicit KQOAuthSessionCache(const QString &fileName);
+    // Saves the cache if it has changed.
+    ~KQOAuthSessionCache();
+
+    bool load();
+    bool save();
+
+    // Returns an empty ticket if there is none for the host.
+    QByteArray sessionTicket(const QString &host) const;
+    void setSessionTicket(const QString &host, const QByteArray &ticket);
+    void removeSessionTicket(const QString &host);
+    int count() const;
+
+    // Statistics of this process, not saved.
+    // Number of new connections a saved ticket was offered on.
+    int offeredCount() const;
+    // Average set up time in milliseconds of connections with and without an offered
+    // ticket, measured from sending the request to the end of the handshake. -1 if none.
+    qint64 averageHandshakeTime(bool offered) const;
+    // Estimate of the set up time saved in total by the offered tickets, in milliseconds.
+    qint64 savedHandshakeTime() const;
+
+private:
+    // Called by the manager when a handshake is done.
+    void recordHandshake(bool offered, qint64 milliseconds);
+    friend class KQOAuthManagerPrivate;
+
+    KQOAuthSessionCachePrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(KQOAuthSessionCache);
+    Q_DISABLE_COPY(KQOAuthSessionCache);
+};
+
+#endif // KQOAUTHSESSIONCACHE_H
@@ -0,0 +1,49 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHSESSIONCACHE_P_H
+#define KQOAUTHSESSIONCACHE_P_H
+
+#include <QDateTime>
+#include <QHash>
+
+#include "kqoauthsessioncache.h"
+
+struct KQOAuthSessionTicket
+{
+    QByteArray ticket;
+    QDateTime saved;
+};
+
+class KQOAuthSessionCachePrivate {
+
+public:
+    KQOAuthSessionCachePrivate(const QString &fileName);
+
+    void dropExpired();
+
+    QString fileName;
+    QHash<QString, KQOAuthSessionTicket> tickets;
+    bool changed;
+
+    int handshakes[2];          // Indexed by whether a ticket was offered.
+    qint64 handshakeTime[2];
+};
+
+#endif // KQOAUTHSESSIONCACHE_P_H
@@ -0,0 +1,105 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "kqoauthsubmissionqueue.h"
+
+namespace
+{
+    // Qt 4 has no explicit acquire load for atomic pointers.
+    inline KQOAuthSubmission *loadAcquire(QAtomicPointer<KQOAuthSubmission> &pointer) {
+#if QT_VERSION >= 0x050000
+        return pointer.loadAcquire();
+#else
+        return pointer.fetchAndAddAcquire(0);
+#endif
+    }
+}
+
+KQOAuthSubmissionQueue::KQOAuthSubmissionQueue() :
+    head(&stub),
+    tail(&stub),
+    wakeupPending(0)
+{
+
+}
+
+KQOAuthSubmissionQueue::~KQOAuthSubmissionQueue()
+{
+    KQOAuthSubmission *submission;
+    while ((submission = dequeue()) != 0) {
+        // Nobody is left to send it, so do not keep executeBlocking() waiting.
+        if (submission->blockingCall) {
+            submission->blockingCall->fail(KQOAuthManager::ManagerError);
+        }
+        delete submission;
+    }
+}
+
+bool KQOAuthSubmissionQueue::enqueue(KQOAuthSubmission *submission) {
+    push(submission);
+
+    // Only the first submission after the consumer started draining wakes it up.
+    return wakeupPending.testAndSetOrdered(0, 1);
+}
+
+void KQOAuthSubmissionQueue::beginDrain() {
+    wakeupPending.fetchAndStoreOrdered(0);
+}
+
+void KQOAuthSubmissionQueue::push(KQOAuthSubmission *submission) {
+    submission->next.fetchAndStoreRelaxed(0);
+    KQOAuthSubmission *previous = head.fetchAndStoreOrdered(submission);
+    // Between the two stores the queue is briefly unlinked; dequeue() copes with it.
+    previous->next.fetchAndStoreRelease(submission);
+}
+
+KQOAuthSubmission *KQOAuthSubmissionQueue::dequeue() {
+    KQOAuthSubmission *first = tail;
+    KQOAuthSubmission *next = loadAcquire(first->next);
+
+    if (first == &stub) {
+        if (next == 0) {
+            return 0;
+        }
+        tail = next;
+        first = next;
+        next = loadAcquire(next->next);
+    }
+
+    if (next != 0) {
+        tail = next;
+        return first;
+    }
+
+    if (first != loadAcquire(head)) {
+        // A producer is in the middle of push(). It will wake us up again.
+        return 0;
+    }
+
+    // 'first' is the last element. Put the stub behind it so it can be taken.
+    push(&stub);
+
+    next = loadAcquire(first->next);
+    if (next != 0) {
+        tail = next;
+        return first;
+    }
+
+    return 0;
+}
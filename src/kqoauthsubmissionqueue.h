@@ -0,0 +1,117 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHSUBMISSIONQUEUE_H
+#define KQOAUTHSUBMISSIONQUEUE_H
+
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QVariant>
+#include <QWaitCondition>
+
+#include "kqoauthglobals.h"
+#include "kqoauthmanager.h"
+
+class KQOAuthRequest;
+
+// Rendezvous between KQOAuthManager::executeBlocking() and the manager's thread.
+// Shared, since the caller may give up waiting before the reply arrives.
+struct KQOAuthBlockingCall
+{
+    KQOAuthBlockingCall() : finished(false), cancelled(false) {}
+
+    void complete(const KQOAuthManager::KQOAuthReply &result) {
+        QMutexLocker locker(&mutex);
+        reply = result;
+        finished = true;
+        done.wakeAll();
+    }
+
+    void fail(KQOAuthManager::KQOAuthError error) {
+        KQOAuthManager::KQOAuthReply failed;
+        failed.userData = userData;
+        failed.error = error;
+        complete(failed);
+    }
+
+    QVariant userData;          // Given to executeBlocking(), set before the call is queued.
+    QMutex mutex;
+    QWaitCondition done;
+    bool finished;
+    KQOAuthManager::KQOAuthReply reply;
+
+    // Held by the manager while it uses the request, and by the caller when it gives up
+    // waiting. Once 'cancelled' is set the caller may delete the request, and the manager
+    // must not touch it again. Never taken while 'mutex' is held.
+    QMutex requestLock;
+    bool cancelled;
+};
+
+// A request handed over to KQOAuthManager from another thread.
+struct KQOAuthSubmission
+{
+    KQOAuthSubmission() : next(0), request(0), submittedAt(0), timeout(0) {}
+
+    QAtomicPointer<KQOAuthSubmission> next;
+    KQOAuthRequest *request;
+    QVariant userData;
+    qint64 submittedAt;         // QElapsedTimer::msecsSinceReference() at submission.
+    int timeout;                // Overrides the request's timeout if shorter, 0 if not set.
+    QSharedPointer<KQOAuthBlockingCall> blockingCall;  // Set for executeBlocking().
+};
+
+/**
+ * Lock-free multi-producer/single-consumer queue of submissions (an intrusive
+ * Vyukov queue). enqueue() may be called from any thread, dequeue() only from
+ * the consumer thread.
+ *
+ * The queue also keeps track of whether the consumer has been woken up, so that
+ * only the first submission of a batch needs to post an event to it.
+ */
+class KQOAUTH_EXPORT KQOAuthSubmissionQueue
+{
+public:
+    KQOAuthSubmissionQueue();
+    ~KQOAuthSubmissionQueue();      // Deletes the submissions still in the queue, failing their blocking calls.
+
+    // Takes the ownership of the submission. Returns true if the caller has to
+    // wake up the consumer.
+    bool enqueue(KQOAuthSubmission *submission);
+
+    // Must be called by the consumer before it starts draining the queue. Any
+    // submission made after this will request a new wake-up.
+    void beginDrain();
+    // Returns the oldest submission, or 0 if the queue is empty. The caller owns
+    // the returned submission.
+    KQOAuthSubmission *dequeue();
+
+private:
+    void push(KQOAuthSubmission *submission);
+
+    QAtomicPointer<KQOAuthSubmission> head;     // Producers push here.
+    KQOAuthSubmission *tail;                    // Consumer pops here.
+    KQOAuthSubmission stub;
+    QAtomicInt wakeupPending;
+
+    Q_DISABLE_COPY(KQOAuthSubmissionQueue);
+};
+
+#endif // KQOAUTHSUBMISSIONQUEUE_H
@@ -0,0 +1,109 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QThread>
+#include <QtDebug>
+
+#include "kqoauththreadedmanager.h"
+#include "kqoauththreadedmanager_p.h"
+#include "kqoauthmanagerthread.h"
+
+////////////// Private d_ptr implementation ////////////////
+
+KQOAuthThreadedManagerPrivate::KQOAuthThreadedManagerPrivate(KQOAuthThreadedManager *parent) :
+    nextIndex(0),
+    q_ptr(parent)
+{
+
+}
+
+KQOAuthThreadedManagerPrivate::~KQOAuthThreadedManagerPrivate() {
+    foreach (KQOAuthManagerThread *thread, threads) {
+        thread->stopAndWait();
+        delete thread;
+    }
+}
+
+void KQOAuthThreadedManagerPrivate::startThreads(int threadCount, KQOAuthTransport *transport) {
+    Q_Q(KQOAuthThreadedManager);
+
+    if (threadCount <= 0) {
+        threadCount = qMax(1, QThread::idealThreadCount());
+    }
+
+    for (int i = 0; i < threadCount; i++) {
+        KQOAuthManagerThread *thread = new KQOAuthManagerThread;
+        QObject::connect(thread, SIGNAL(replyReceived(KQOAuthManager::KQOAuthReply)),
+                         q, SIGNAL(replyReceived(KQOAuthManager::KQOAuthReply)));
+        thread->setTransport(transport);
+        thread->startAndWait();
+        threads.append(thread);
+    }
+}
+
+KQOAuthManagerThread *KQOAuthThreadedManagerPrivate::nextThread() {
+    // Round robin. The counter may wrap around, hence the unsigned arithmetic.
+    uint index = static_cast<uint>(nextIndex.fetchAndAddRelaxed(1));
+    return threads.at(index % threads.size());
+}
+
+/////////////// Public implementation ////////////////
+
+KQOAuthThreadedManager::KQOAuthThreadedManager(int threadCount, QObject *parent) :
+    QObject(parent),
+    d_ptr(new KQOAuthThreadedManagerPrivate(this))
+{
+    Q_D(KQOAuthThreadedManager);
+    d->startThreads(threadCount, 0);
+}
+
+KQOAuthThreadedManager::KQOAuthThreadedManager(int threadCount, KQOAuthTransport *transport, QObject *parent) :
+    QObject(parent),
+    d_ptr(new KQOAuthThreadedManagerPrivate(this))
+{
+    Q_D(KQOAuthThreadedManager);
+    d->startThreads(threadCount, transport);
+}
+
+KQOAuthThreadedManager::~KQOAuthThreadedManager()
+{
+    delete d_ptr;
+}
+
+int KQOAuthThreadedManager::threadCount() const {
+    Q_D(const KQOAuthThreadedManager);
+    return d->threads.size();
+}
+
+void KQOAuthThreadedManager::executeRequest(KQOAuthRequest *request, const QVariant &userData) {
+    Q_D(KQOAuthThreadedManager);
+
+    if (request == 0) {
+        qWarning() << "Request is NULL. Cannot proceed.";
+
+        KQOAuthManager::KQOAuthReply failed;
+        failed.userData = userData;
+        failed.error = KQOAuthManager::RequestError;
+        QMetaObject::invokeMethod(this, "replyReceived", Qt::QueuedConnection,
+                                  Q_ARG(KQOAuthManager::KQOAuthReply, failed));
+        return;
+    }
+
+    d->nextThread()->executeRequest(request, userData);
+}
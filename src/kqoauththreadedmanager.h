@@ -0,0 +1,71 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHTHREADEDMANAGER_H
+#define KQOAUTHTHREADEDMANAGER_H
+
+#include <QObject>
+
+#include "kqoauthmanager.h"
+
+class KQOAuthThreadedManagerPrivate;
+class KQOAUTH_EXPORT KQOAuthThreadedManager : public QObject
+{
+    Q_OBJECT
+public:
+    typedef KQOAuthManager::KQOAuthReply KQOAuthReply;
+
+    /**
+     * Creates 'threadCount' worker threads, each with its own event loop and its own
+     * KQOAuthManager and QNetworkAccessManager. If 'threadCount' is zero or less,
+     * QThread::idealThreadCount() threads are used.
+     * Replies are delivered in the thread this object lives in.
+     */
+    explicit KQOAuthThreadedManager(int threadCount = 0, QObject *parent = 0);
+    /**
+     * Like above, but the managers of all the worker threads send their requests
+     * with 'transport' (see KQOAuthManager::setTransport()). The transport is used
+     * from several threads at once, so it must be thread safe, like
+     * KQOAuthLoopbackTransport is. It must outlive this object.
+     */
+    KQOAuthThreadedManager(int threadCount, KQOAuthTransport *transport, QObject *parent = 0);
+    ~KQOAuthThreadedManager();
+
+    int threadCount() const;
+
+    /**
+     * Sends the request on one of the worker threads. The threads are used in turn.
+     * This method can be called from any thread. The request must be valid and must
+     * not be modified or deleted until replyReceived() has been emitted for it; use
+     * 'userData' to match replies with requests. Every request gets a reply, also when
+     * it cannot be sent; its 'error' member tells why.
+     */
+    void executeRequest(KQOAuthRequest *request, const QVariant &userData = QVariant());
+
+Q_SIGNALS:
+    // Emitted in the thread of this object when a reply has been received.
+    void replyReceived(KQOAuthManager::KQOAuthReply reply);
+
+private:
+    KQOAuthThreadedManagerPrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(KQOAuthThreadedManager);
+    Q_DISABLE_COPY(KQOAuthThreadedManager);
+};
+
+#endif // KQOAUTHTHREADEDMANAGER_H
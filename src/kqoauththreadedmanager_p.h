@@ -0,0 +1,45 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHTHREADEDMANAGER_P_H
+#define KQOAUTHTHREADEDMANAGER_P_H
+
+#include <QAtomicInt>
+#include <QList>
+
+#include "kqoauththreadedmanager.h"
+
+class KQOAuthManagerThread;
+class KQOAUTH_EXPORT KQOAuthThreadedManagerPrivate {
+
+public:
+    KQOAuthThreadedManagerPrivate(KQOAuthThreadedManager *parent);
+    ~KQOAuthThreadedManagerPrivate();
+
+    void startThreads(int threadCount, KQOAuthTransport *transport);
+    KQOAuthManagerThread *nextThread();
+
+    QList<KQOAuthManagerThread *> threads;
+    QAtomicInt nextIndex;
+    KQOAuthThreadedManager * const q_ptr;
+
+    Q_DECLARE_PUBLIC(KQOAuthThreadedManager);
+};
+
+#endif // KQOAUTHTHREADEDMANAGER_P_H
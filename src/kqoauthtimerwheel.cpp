@@ -0,0 +1,168 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "kqoauthtimerwheel.h"
+
+KQOAuthTimerWheel::KQOAuthTimerWheel(int tickMilliseconds) :
+    tick(tickMilliseconds > 0 ? tickMilliseconds : 1),
+    currentTick(0)
+{
+    for (int level = 0; level < LevelCount; level++) {
+        buckets[level].resize(SlotCount);
+    }
+}
+
+KQOAuthTimerWheel::~KQOAuthTimerWheel()
+{
+
+}
+
+void KQOAuthTimerWheel::schedule(quint64 id, qint64 deadline, qint64 now) {
+    if (timers.isEmpty()) {
+        // Nothing to cascade, so the idle time can be skipped in one step.
+        currentTick = qMax(currentTick, now / tick);
+    }
+
+    // Round up so that a timer never fires before its deadline.
+    qint64 expiresTick = (deadline + tick - 1) / tick;
+
+    timers.insert(id, expiresTick);
+    place(id, expiresTick, currentTick + 1);
+}
+
+bool KQOAuthTimerWheel::cancel(quint64 id) {
+    // The slot entry stays behind and is ignored once its slot is visited.
+    return timers.remove(id) > 0;
+}
+
+QList<quint64> KQOAuthTimerWheel::advance(qint64 now) {
+    QList<quint64> expired;
+    qint64 targetTick = now / tick;
+
+    while (currentTick < targetTick && !timers.isEmpty()) {
+        currentTick++;
+
+        // Pull the timers of the coarser levels down before handling level 0.
+        // Higher levels go first so that their timers can fall through.
+        int level = 1;
+        while (level < LevelCount
+               && (currentTick & ((Q_INT64_C(1) << (LevelBits * level)) - 1)) == 0) {
+            level++;
+        }
+        for (int l = level - 1; l >= 1; l--) {
+            cascade(l);
+        }
+
+        QList<quint64> due = buckets[0][currentTick & SlotMask];
+        buckets[0][currentTick & SlotMask].clear();
+        foreach (quint64 id, due) {
+            QHash<quint64, qint64>::iterator it = timers.find(id);
+            if (it == timers.end()) {
+                continue;   // Cancelled.
+            }
+
+            if (it.value() <= currentTick) {
+                timers.erase(it);
+                expired.append(id);
+            } else {
+                place(id, it.value(), currentTick + 1);  // Parked timer or stale entry of a rescheduled one.
+            }
+        }
+    }
+
+    if (timers.isEmpty()) {
+        currentTick = qMax(currentTick, targetTick);
+    }
+
+    return expired;
+}
+
+qint64 KQOAuthTimerWheel::nextWakeup() const {
+    if (timers.isEmpty()) {
+        return -1;
+    }
+
+    // The next interesting tick is either a populated slot on level 0 or the
+    // cascade of a populated slot on one of the coarser levels.
+    qint64 wakeupTick = -1;
+    for (int level = 0; level < LevelCount; level++) {
+        int shift = LevelBits * level;
+        for (qint64 k = 1; k <= SlotCount; k++) {
+            qint64 t = ((currentTick >> shift) + k) << shift;
+            if (wakeupTick >= 0 && t >= wakeupTick) {
+                break;
+            }
+            if (!buckets[level][(t >> shift) & SlotMask].isEmpty()) {
+                wakeupTick = t;
+                break;
+            }
+        }
+    }
+
+    if (wakeupTick < 0) {
+        // Only stale entries are left; they are swept on the next revolution.
+        wakeupTick = currentTick + SlotCount;
+    }
+
+    return wakeupTick * tick;
+}
+
+bool KQOAuthTimerWheel::isEmpty() const {
+    return timers.isEmpty();
+}
+
+int KQOAuthTimerWheel::count() const {
+    return timers.size();
+}
+
+void KQOAuthTimerWheel::place(quint64 id, qint64 expiresTick, qint64 earliestTick) {
+    if (expiresTick - currentTick < SlotCount) {
+        // Also catches timers that are already due; they fire on the earliest tick still to be handled.
+        qint64 t = qMax(expiresTick, earliestTick);
+        buckets[0][t & SlotMask].append(id);
+        return;
+    }
+
+    for (int level = 1; level < LevelCount; level++) {
+        int shift = LevelBits * level;
+        if ((expiresTick >> shift) - (currentTick >> shift) < SlotCount) {
+            buckets[level][(expiresTick >> shift) & SlotMask].append(id);
+            return;
+        }
+    }
+
+    // Further away than the wheel can represent. Park the timer in the last
+    // slot of the top level; it will be re-placed when that slot cascades.
+    int shift = LevelBits * (LevelCount - 1);
+    buckets[LevelCount - 1][((currentTick >> shift) + SlotCount - 1) & SlotMask].append(id);
+}
+
+void KQOAuthTimerWheel::cascade(int level) {
+    int shift = LevelBits * level;
+    QList<quint64> entries = buckets[level][(currentTick >> shift) & SlotMask];
+    buckets[level][(currentTick >> shift) & SlotMask].clear();
+
+    foreach (quint64 id, entries) {
+        QHash<quint64, qint64>::const_iterator it = timers.constFind(id);
+        if (it != timers.constEnd()) {
+            // The slot of the current tick has not been handled yet.
+            place(id, it.value(), currentTick);
+        }
+    }
+}
@@ -0,0 +1,74 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHTIMERWHEEL_H
+#define KQOAUTHTIMERWHEEL_H
+
+#include <QHash>
+#include <QList>
+#include <QVector>
+
+#include "kqoauthglobals.h"
+
+/**
+ * Hierarchical timer wheel used by KQOAuthManager to track the deadlines of
+ * all of its requests with a single QTimer.
+ *
+ * Deadlines are absolute times in milliseconds on the caller's clock (usually
+ * a QElapsedTimer). Scheduling and cancelling are O(1); advancing the wheel
+ * costs O(1) per tick plus the number of expired or cascaded timers.
+ * Cancelled timers are dropped lazily when their slot is visited.
+ */
+class KQOAUTH_EXPORT KQOAuthTimerWheel
+{
+public:
+    explicit KQOAuthTimerWheel(int tickMilliseconds = 10);
+    ~KQOAuthTimerWheel();
+
+    // Schedules (or reschedules) the timer 'id' to expire at 'deadline'.
+    void schedule(quint64 id, qint64 deadline, qint64 now);
+    // Cancels the timer 'id'. Returns false if no such timer is pending.
+    bool cancel(quint64 id);
+    // Moves the wheel forward to 'now' and returns the ids of the expired timers.
+    QList<quint64> advance(qint64 now);
+    // Returns the time at which advance() should be called next, or -1 if
+    // there are no pending timers.
+    qint64 nextWakeup() const;
+
+    bool isEmpty() const;
+    int count() const;
+
+private:
+    enum {
+        LevelBits = 6,
+        SlotCount = 1 << LevelBits,
+        SlotMask = SlotCount - 1,
+        LevelCount = 4
+    };
+
+    void place(quint64 id, qint64 expiresTick, qint64 earliestTick);
+    void cascade(int level);
+
+    int tick;
+    qint64 currentTick;
+    QHash<quint64, qint64> timers;              // id -> expiry tick of the live timers.
+    QVector< QList<quint64> > buckets[LevelCount];
+};
+
+#endif // KQOAUTHTIMERWHEEL_H
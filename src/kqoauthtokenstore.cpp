@@ -0,0 +1,558 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QFileInfo>
+#include <QVector>
+#include <QtDebug>
+#include <QtEndian>
+
+#if defined(Q_OS_UNIX)
+#  include <fcntl.h>
+#  include <unistd.h>
+#elif defined(Q_OS_WIN)
+#  include <io.h>
+#endif
+
+#include "kqoauthtokenstore.h"
+#include "kqoauthtokenstore_p.h"
+
+namespace
+{
+    // Snapshot layout, all integers little endian:
+    //   header:  magic, version, bucket count, record count   (4 x quint32)
+    //   index:   bucket count x quint32 record offset, 0 for an empty bucket
+    //   records: see encodeRecord()
+    // The index is an open addressing hash table with linear probing, at most half full.
+    const quint32 storeMagic = 0x4b51544b;
+    const quint32 storeVersion = 1;
+    const int headerSize = 16;
+    const int recordHeaderSize = 10;        // Five quint16 lengths.
+
+    // Log records are a one byte operation followed by a record.
+    const char logSave = 'S';
+    const char logRemove = 'R';
+
+    // Flushes 'file' down to the disk, so that it survives a power loss and not only a crash.
+    bool syncFile(QFile &file) {
+        if (!file.flush()) {
+            return false;
+        }
+#if defined(Q_OS_UNIX)
+        return ::fsync(file.handle()) == 0;
+#elif defined(Q_OS_WIN)
+        return ::_commit(file.handle()) == 0;
+#else
+        return true;
+#endif
+    }
+
+    // Makes a rename in 'directory' durable. Windows has no way to, nor a need for it.
+    void syncDirectory(const QString &directory) {
+#if defined(Q_OS_UNIX)
+        int fd = ::open(QFile::encodeName(directory).constData(), O_RDONLY);
+        if (fd >= 0) {
+            ::fsync(fd);
+            ::close(fd);
+        }
+#else
+        Q_UNUSED(directory)
+#endif
+    }
+
+    // FNV-1a, since qHash() is not guaranteed to be stable between Qt versions.
+    quint32 accountHash(const QByteArray &accountId) {
+        quint32 hash = 2166136261u;
+        for (int i = 0; i < accountId.size(); i++) {
+            hash ^= static_cast<uchar>(accountId.at(i));
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    void appendU16(QByteArray &data, quint16 value) {
+        uchar bytes[2];
+        qToLittleEndian<quint16>(value, bytes);
+        data.append(reinterpret_cast<const char *>(bytes), 2);
+    }
+
+    void appendU32(QByteArray &data, quint32 value) {
+        uchar bytes[4];
+        qToLittleEndian<quint32>(value, bytes);
+        data.append(reinterpret_cast<const char *>(bytes), 4);
+    }
+}
+
+//////////// Private d_ptr implementation /////////
+
+KQOAuthTokenStorePrivate::KQOAuthTokenStorePrivate(const QString &fileName) :
+    snapshotFile(fileName),
+    logFile(fileName + ".log"),
+    snapshot(0),
+    snapshotSize(0),
+    bucketCount(0),
+    logRecords(0),
+    compactionThreshold(256),
+    opened(false)
+{
+
+}
+
+bool KQOAuthTokenStorePrivate::mapSnapshot() {
+    if (!snapshotFile.exists()) {
+        return true;
+    }
+
+    if (!snapshotFile.open(QIODevice::ReadOnly)) {
+        qWarning() << "Cannot open token store" << snapshotFile.fileName();
+        return false;
+    }
+
+    snapshotSize = snapshotFile.size();
+    if (snapshotSize == 0) {
+        return true;
+    }
+
+    snapshot = snapshotFile.map(0, snapshotSize);
+    if (snapshot == 0 || snapshotSize < headerSize) {
+        qWarning() << "Cannot map token store" << snapshotFile.fileName();
+        unmapSnapshot();
+        return false;
+    }
+
+    bucketCount = qFromLittleEndian<quint32>(snapshot + 8);
+    if (qFromLittleEndian<quint32>(snapshot) != storeMagic
+        || qFromLittleEndian<quint32>(snapshot + 4) != storeVersion
+        || bucketCount == 0 || (bucketCount & (bucketCount - 1)) != 0
+        || headerSize + 4 * qint64(bucketCount) > snapshotSize) {
+        qWarning() << "Token store" << snapshotFile.fileName() << "is corrupted.";
+        unmapSnapshot();
+        return false;
+    }
+
+    return true;
+}
+
+void KQOAuthTokenStorePrivate::unmapSnapshot() {
+    if (snapshot != 0) {
+        snapshotFile.unmap(const_cast<uchar *>(snapshot));
+    }
+
+    snapshotFile.close();
+    snapshot = 0;
+    snapshotSize = 0;
+    bucketCount = 0;
+}
+
+bool KQOAuthTokenStorePrivate::replayLog() {
+    bool created = !logFile.exists();
+    if (!logFile.open(QIODevice::ReadWrite)) {
+        qWarning() << "Cannot open token store log" << logFile.fileName();
+        return false;
+    }
+
+    if (created) {
+        logFile.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+    }
+
+    QByteArray log = logFile.readAll();
+    const uchar *data = reinterpret_cast<const uchar *>(log.constData());
+    qint64 position = 0;
+
+    while (position < log.size()) {
+        char operation = log.at(position);
+        qint64 recordSize = 0;
+        QByteArray accountId;
+        KQOAuthTokenStore::Tokens tokens;
+
+        if ((operation != logSave && operation != logRemove)
+            || !decodeRecord(data + position + 1, log.size() - position - 1, &recordSize, &accountId, &tokens)) {
+            break;
+        }
+
+        QString account = QString::fromUtf8(accountId);
+        if (operation == logSave) {
+            updates.insert(account, tokens);
+            removals.remove(account);
+        } else {
+            updates.remove(account);
+            removals.insert(account);
+        }
+
+        position += 1 + recordSize;
+        logRecords++;
+    }
+
+    // Drop a record that was cut short, most likely by a crash while it was written.
+    if (position < log.size()) {
+        qWarning() << "Discarding" << log.size() - position << "bytes at the end of" << logFile.fileName();
+        logFile.resize(position);
+    }
+
+    logFile.seek(position);
+    return true;
+}
+
+bool KQOAuthTokenStorePrivate::appendLog(char operation, const QString &accountId,
+                                         const KQOAuthTokenStore::Tokens &tokens) {
+    QByteArray record = encodeRecord(accountId, tokens);
+    if (record.isEmpty()) {
+        qWarning() << "Tokens are too long to be stored for" << accountId;
+        return false;
+    }
+
+    record.prepend(operation);
+    if (logFile.write(record) != record.size() || !logFile.flush()) {
+        qWarning() << "Cannot write to token store log" << logFile.fileName();
+        return false;
+    }
+
+    logRecords++;
+    return true;
+}
+
+bool KQOAuthTokenStorePrivate::readRecord(quint32 offset, QByteArray *accountId,
+                                          KQOAuthTokenStore::Tokens *tokens) const {
+    if (offset < headerSize + 4 * bucketCount || offset >= snapshotSize) {
+        return false;
+    }
+
+    qint64 recordSize;
+    return decodeRecord(snapshot + offset, snapshotSize - offset, &recordSize, accountId, tokens);
+}
+
+bool KQOAuthTokenStorePrivate::findInSnapshot(const QByteArray &accountId, KQOAuthTokenStore::Tokens *tokens) const {
+    if (snapshot == 0) {
+        return false;
+    }
+
+    quint32 mask = bucketCount - 1;
+    quint32 bucket = accountHash(accountId) & mask;
+
+    for (quint32 probes = 0; probes < bucketCount; probes++) {
+        quint32 offset = qFromLittleEndian<quint32>(snapshot + headerSize + 4 * bucket);
+        if (offset == 0) {
+            return false;
+        }
+
+        QByteArray candidate;
+        KQOAuthTokenStore::Tokens candidateTokens;
+        if (readRecord(offset, &candidate, &candidateTokens) && candidate == accountId) {
+            *tokens = candidateTokens;
+            return true;
+        }
+
+        bucket = (bucket + 1) & mask;
+    }
+
+    return false;
+}
+
+QList< QPair<QString, KQOAuthTokenStore::Tokens> > KQOAuthTokenStorePrivate::snapshotEntries() const {
+    QList< QPair<QString, KQOAuthTokenStore::Tokens> > entries;
+
+    for (quint32 bucket = 0; bucket < bucketCount; bucket++) {
+        quint32 offset = qFromLittleEndian<quint32>(snapshot + headerSize + 4 * bucket);
+        QByteArray accountId;
+        KQOAuthTokenStore::Tokens tokens;
+        if (offset != 0 && readRecord(offset, &accountId, &tokens)) {
+            entries.append(qMakePair(QString::fromUtf8(accountId), tokens));
+        }
+    }
+
+    return entries;
+}
+
+// A record is the lengths of the account id and the four token fields as quint16,
+// followed by the fields themselves in UTF-8. Returns an empty array if a field is too long.
+QByteArray KQOAuthTokenStorePrivate::encodeRecord(const QString &accountId, const KQOAuthTokenStore::Tokens &tokens) {
+    QByteArray fields[5] = {
+        accountId.toUtf8(),
+        tokens.token.toUtf8(),
+        tokens.tokenSecret.toUtf8(),
+        tokens.consumerKey.toUtf8(),
+        tokens.consumerSecret.toUtf8()
+    };
+
+    QByteArray record;
+    for (int i = 0; i < 5; i++) {
+        if (fields[i].size() > 0xffff) {
+            return QByteArray();
+        }
+        appendU16(record, fields[i].size());
+    }
+
+    for (int i = 0; i < 5; i++) {
+        record.append(fields[i]);
+    }
+
+    return record;
+}
+
+bool KQOAuthTokenStorePrivate::decodeRecord(const uchar *data, qint64 size, qint64 *recordSize,
+                                            QByteArray *accountId, KQOAuthTokenStore::Tokens *tokens) {
+    if (size < recordHeaderSize) {
+        return false;
+    }
+
+    int lengths[5];
+    qint64 total = recordHeaderSize;
+    for (int i = 0; i < 5; i++) {
+        lengths[i] = qFromLittleEndian<quint16>(data + 2 * i);
+        total += lengths[i];
+    }
+
+    if (total > size) {
+        return false;
+    }
+
+    const char *field = reinterpret_cast<const char *>(data) + recordHeaderSize;
+    *accountId = QByteArray(field, lengths[0]);
+    field += lengths[0];
+    tokens->token = QString::fromUtf8(field, lengths[1]);
+    field += lengths[1];
+    tokens->tokenSecret = QString::fromUtf8(field, lengths[2]);
+    field += lengths[2];
+    tokens->consumerKey = QString::fromUtf8(field, lengths[3]);
+    field += lengths[3];
+    tokens->consumerSecret = QString::fromUtf8(field, lengths[4]);
+
+    *recordSize = total;
+    return true;
+}
+
+/////////////// Public implementation ////////////////
+
+KQOAuthTokenStore::KQOAuthTokenStore(const QString &fileName) :
+    d_ptr(new KQOAuthTokenStorePrivate(fileName))
+{
+
+}
+
+KQOAuthTokenStore::~KQOAuthTokenStore()
+{
+    close();
+    delete d_ptr;
+}
+
+bool KQOAuthTokenStore::open() {
+    Q_D(KQOAuthTokenStore);
+
+    if (d->opened) {
+        return true;
+    }
+
+    // Finish a compaction that was interrupted after the old snapshot was removed.
+    QString compacted = d->snapshotFile.fileName() + ".tmp";
+    if (!d->snapshotFile.exists() && QFile::exists(compacted)) {
+        QFile::rename(compacted, d->snapshotFile.fileName());
+    }
+
+    if (!d->mapSnapshot()) {
+        return false;
+    }
+
+    if (!d->replayLog()) {
+        d->unmapSnapshot();
+        return false;
+    }
+
+    d->opened = true;
+    return true;
+}
+
+void KQOAuthTokenStore::close() {
+    Q_D(KQOAuthTokenStore);
+
+    d->unmapSnapshot();
+    d->logFile.close();
+    d->updates.clear();
+    d->removals.clear();
+    d->logRecords = 0;
+    d->opened = false;
+}
+
+bool KQOAuthTokenStore::isOpen() const {
+    Q_D(const KQOAuthTokenStore);
+    return d->opened;
+}
+
+KQOAuthTokenStore::Tokens KQOAuthTokenStore::tokens(const QString &accountId) const {
+    Q_D(const KQOAuthTokenStore);
+
+    Tokens result;
+    if (!d->opened || d->removals.contains(accountId)) {
+        return result;
+    }
+
+    QHash<QString, Tokens>::const_iterator update = d->updates.constFind(accountId);
+    if (update != d->updates.constEnd()) {
+        return update.value();
+    }
+
+    d->findInSnapshot(accountId.toUtf8(), &result);
+    return result;
+}
+
+bool KQOAuthTokenStore::contains(const QString &accountId) const {
+    return tokens(accountId).isValid();
+}
+
+bool KQOAuthTokenStore::saveTokens(const QString &accountId, const Tokens &tokens) {
+    Q_D(KQOAuthTokenStore);
+
+    if (!d->opened) {
+        qWarning() << "Token store is not open. Cannot save tokens.";
+        return false;
+    }
+
+    if (!d->appendLog(logSave, accountId, tokens)) {
+        return false;
+    }
+
+    d->updates.insert(accountId, tokens);
+    d->removals.remove(accountId);
+
+    if (d->logRecords >= d->compactionThreshold) {
+        compact();
+    }
+
+    return true;
+}
+
+bool KQOAuthTokenStore::removeTokens(const QString &accountId) {
+    Q_D(KQOAuthTokenStore);
+
+    if (!contains(accountId)) {
+        return false;
+    }
+
+    if (!d->appendLog(logRemove, accountId, Tokens())) {
+        return false;
+    }
+
+    d->updates.remove(accountId);
+    d->removals.insert(accountId);
+
+    if (d->logRecords >= d->compactionThreshold) {
+        compact();
+    }
+
+    return true;
+}
+
+bool KQOAuthTokenStore::compact() {
+    Q_D(KQOAuthTokenStore);
+
+    if (!d->opened) {
+        return false;
+    }
+
+    QList< QPair<QString, Tokens> > entries;
+    QList< QPair<QString, Tokens> > previous = d->snapshotEntries();
+    for (int i = 0; i < previous.size(); i++) {
+        const QString &accountId = previous.at(i).first;
+        if (!d->updates.contains(accountId) && !d->removals.contains(accountId)) {
+            entries.append(previous.at(i));
+        }
+    }
+
+    QHash<QString, Tokens>::const_iterator update;
+    for (update = d->updates.constBegin(); update != d->updates.constEnd(); ++update) {
+        entries.append(qMakePair(update.key(), update.value()));
+    }
+
+    quint32 buckets = 16;
+    while (buckets < 2 * static_cast<quint32>(entries.size())) {
+        buckets *= 2;
+    }
+
+    // Build the new snapshot.
+    QVector<quint32> index(buckets, 0);
+    QByteArray records;
+    const quint32 recordsStart = headerSize + 4 * buckets;
+
+    for (int i = 0; i < entries.size(); i++) {
+        QByteArray record = KQOAuthTokenStorePrivate::encodeRecord(entries.at(i).first, entries.at(i).second);
+
+        quint32 bucket = accountHash(entries.at(i).first.toUtf8()) & (buckets - 1);
+        while (index.at(bucket) != 0) {
+            bucket = (bucket + 1) & (buckets - 1);
+        }
+        index[bucket] = recordsStart + records.size();
+        records.append(record);
+    }
+
+    QByteArray header;
+    appendU32(header, storeMagic);
+    appendU32(header, storeVersion);
+    appendU32(header, buckets);
+    appendU32(header, entries.size());
+    for (quint32 bucket = 0; bucket < buckets; bucket++) {
+        appendU32(header, index.at(bucket));
+    }
+
+    QString fileName = d->snapshotFile.fileName();
+    QFile compacted(fileName + ".tmp");
+    if (!compacted.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Cannot write token store" << compacted.fileName();
+        return false;
+    }
+    compacted.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+
+    // On the disk before it replaces the old snapshot, or a power loss could leave
+    // an empty snapshot behind the rename, with the log already truncated.
+    if (compacted.write(header) != header.size()
+        || compacted.write(records) != records.size()
+        || !syncFile(compacted)) {
+        qWarning() << "Cannot write token store" << compacted.fileName();
+        compacted.close();
+        compacted.remove();
+        return false;
+    }
+    compacted.close();
+
+    // Swap in the new snapshot. If we stop between the two steps, open() finishes the job.
+    d->unmapSnapshot();
+    QFile::remove(fileName);
+    if (!QFile::rename(compacted.fileName(), fileName) || !d->mapSnapshot()) {
+        qWarning() << "Cannot replace token store" << fileName;
+        close();
+        return false;
+    }
+    syncDirectory(QFileInfo(fileName).absolutePath());
+
+    // Everything in the log is in the snapshot now, also on the disk.
+    d->logFile.resize(0);
+    d->logFile.seek(0);
+    d->updates.clear();
+    d->removals.clear();
+    d->logRecords = 0;
+
+    return true;
+}
+
+void KQOAuthTokenStore::setCompactionThreshold(int records) {
+    Q_D(KQOAuthTokenStore);
+    d->compactionThreshold = qMax(1, records);
+}
+
+int KQOAuthTokenStore::compactionThreshold() const {
+    Q_D(const KQOAuthTokenStore);
+    return d->compactionThreshold;
+}
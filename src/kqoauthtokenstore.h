@@ -0,0 +1,81 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHTOKENSTORE_H
+#define KQOAUTHTOKENSTORE_H
+
+#include <QString>
+
+#include "kqoauthglobals.h"
+
+class KQOAuthTokenStorePrivate;
+
+/**
+ * Persistent store for OAuth access tokens, keyed by an account id of your choice.
+ *
+ * The store is a snapshot file with an on-disk hash index, which is memory mapped
+ * when the store is opened. Updates are appended to a log file next to it
+ * ('<fileName>.log') and folded into a new snapshot once the log grows past the
+ * compaction threshold. Opening the store thus costs the same however many accounts
+ * it has.
+ *
+ * Attach a store to KQOAuthManager with KQOAuthManager::setTokenStore() to save the
+ * access tokens automatically. The store is not thread safe.
+ */
+class KQOAUTH_EXPORT KQOAuthTokenStore
+{
+public:
+    /** Access token and the consumer it was issued to */
+    struct Tokens
+    {
+        QString token;
+        QString tokenSecret;
+        QString consumerKey;
+        QString consumerSecret;
+
+        bool isValid() const { return !token.isEmpty() && !tokenSecret.isEmpty(); }
+    };
+
+    explicit KQOAuthTokenStore(const QString &fileName);
+    ~KQOAuthTokenStore();
+
+    // Maps the snapshot and replays the log. Creates the files if they do not exist.
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    // Returns invalid tokens if the account is not in the store.
+    Tokens tokens(const QString &accountId) const;
+    bool contains(const QString &accountId) const;
+    bool saveTokens(const QString &accountId, const Tokens &tokens);
+    bool removeTokens(const QString &accountId);
+
+    // Writes a new snapshot with all the changes in the log, and empties the log.
+    bool compact();
+    // Number of log records that triggers compact(). Defaults to 256.
+    void setCompactionThreshold(int records);
+    int compactionThreshold() const;
+
+private:
+    KQOAuthTokenStorePrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(KQOAuthTokenStore);
+    Q_DISABLE_COPY(KQOAuthTokenStore);
+};
+
+#endif // KQOAUTHTOKENSTORE_H
@@ -0,0 +1,64 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHTOKENSTORE_P_H
+#define KQOAUTHTOKENSTORE_P_H
+
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QSet>
+
+#include "kqoauthtokenstore.h"
+
+class KQOAuthTokenStorePrivate {
+
+public:
+    KQOAuthTokenStorePrivate(const QString &fileName);
+
+    bool mapSnapshot();
+    void unmapSnapshot();
+    bool replayLog();
+    bool appendLog(char operation, const QString &accountId, const KQOAuthTokenStore::Tokens &tokens);
+
+    // Lookup in the mapped snapshot.
+    bool findInSnapshot(const QByteArray &accountId, KQOAuthTokenStore::Tokens *tokens) const;
+    QList< QPair<QString, KQOAuthTokenStore::Tokens> > snapshotEntries() const;
+    bool readRecord(quint32 offset, QByteArray *accountId, KQOAuthTokenStore::Tokens *tokens) const;
+
+    static QByteArray encodeRecord(const QString &accountId, const KQOAuthTokenStore::Tokens &tokens);
+    static bool decodeRecord(const uchar *data, qint64 size, qint64 *recordSize,
+                             QByteArray *accountId, KQOAuthTokenStore::Tokens *tokens);
+
+    QFile snapshotFile;
+    QFile logFile;
+    const uchar *snapshot;      // Mapped snapshot, 0 if the snapshot is empty.
+    qint64 snapshotSize;
+    quint32 bucketCount;
+
+    // Changes in the log that are not in the snapshot yet.
+    QHash<QString, KQOAuthTokenStore::Tokens> updates;
+    QSet<QString> removals;
+    int logRecords;
+    int compactionThreshold;
+    bool opened;
+};
+
+#endif // KQOAUTHTOKENSTORE_P_H
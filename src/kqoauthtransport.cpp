@@ -0,0 +1,101 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QNetworkAccessManager>
+
+#include "kqoauthtransport.h"
+
+KQOAuthTransport::~KQOAuthTransport() {
+
+}
+
+void KQOAuthTransport::preconnect(const QUrl &url) {
+    Q_UNUSED(url);
+}
+
+QNetworkReply::NetworkError KQOAuthTransport::errorForStatusCode(int statusCode) {
+    if (statusCode < 400) {
+        return QNetworkReply::NoError;
+    }
+
+    switch (statusCode) {
+    case 401:
+        return QNetworkReply::AuthenticationRequiredError;
+    case 403:
+        return QNetworkReply::ContentAccessDenied;
+    case 404:
+        return QNetworkReply::ContentNotFoundError;
+    case 405:
+        return QNetworkReply::ContentOperationNotPermittedError;
+    case 407:
+        return QNetworkReply::ProxyAuthenticationRequiredError;
+    default:
+        break;
+    }
+
+#if QT_VERSION >= 0x050300
+    return statusCode < 500 ? QNetworkReply::UnknownContentError : QNetworkReply::UnknownServerError;
+#else
+    return QNetworkReply::ProtocolUnknownError;
+#endif
+}
+
+/////////////// KQOAuthNetworkTransport ////////////////
+
+KQOAuthNetworkTransport::KQOAuthNetworkTransport(QNetworkAccessManager *manager) :
+    manager(manager)
+{
+
+}
+
+void KQOAuthNetworkTransport::setNetworkManager(QNetworkAccessManager *networkManager) {
+    manager = networkManager;
+}
+
+QNetworkAccessManager *KQOAuthNetworkTransport::networkManager() const {
+    return manager;
+}
+
+QNetworkReply *KQOAuthNetworkTransport::get(const QNetworkRequest &request) {
+    return manager->get(request);
+}
+
+QNetworkReply *KQOAuthNetworkTransport::post(const QNetworkRequest &request, const QByteArray &data) {
+    return manager->post(request, data);
+}
+
+// QNetworkAccessManager keeps the connection in its pool, so the next real request
+// skips the DNS, TCP and TLS set up.
+void KQOAuthNetworkTransport::preconnect(const QUrl &url) {
+#if QT_VERSION >= 0x050200
+    if (url.scheme() == "https") {
+#ifndef QT_NO_SSL
+        manager->connectToHostEncrypted(url.host(), url.port(443));
+        return;
+#endif
+    } else {
+        manager->connectToHost(url.host(), url.port(80));
+        return;
+    }
+#endif
+
+    // No way to only connect, so a HEAD request does the same.
+    QNetworkReply *reply = manager->head(QNetworkRequest(url));
+    QObject::connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+}
@@ -0,0 +1,73 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHTRANSPORT_H
+#define KQOAUTHTRANSPORT_H
+
+#include <QNetworkReply>
+
+#include "kqoauthglobals.h"
+
+class QNetworkAccessManager;
+
+/**
+ * Sends the HTTP requests of KQOAuthManager. The manager signs the request and fills in
+ * the QNetworkRequest; the transport only delivers it and returns a QNetworkReply that
+ * emits finished() once the response is in, from the event loop and not from get() or
+ * post() themselves. The manager deletes the replies.
+ *
+ * Built in are QNetworkAccessManager (the default), the lean HTTP/1.1 client
+ * (KQOAuthManager::LeanHttpBackend) and KQOAuthLoopbackTransport for tests and benchmarks.
+ * Set your own with KQOAuthManager::setTransport().
+ */
+class KQOAUTH_EXPORT KQOAuthTransport
+{
+public:
+    virtual ~KQOAuthTransport();
+
+    virtual QNetworkReply *get(const QNetworkRequest &request) = 0;
+    virtual QNetworkReply *post(const QNetworkRequest &request, const QByteArray &data) = 0;
+
+    // Opens a connection to the host of 'url' ahead of time. Does nothing by default.
+    virtual void preconnect(const QUrl &url);
+
+    // The error QNetworkAccessManager gives for an HTTP status code, NoError below 400.
+    static QNetworkReply::NetworkError errorForStatusCode(int statusCode);
+};
+
+/**
+ * Transport over a QNetworkAccessManager.
+ */
+class KQOAUTH_EXPORT KQOAuthNetworkTransport : public KQOAuthTransport
+{
+public:
+    explicit KQOAuthNetworkTransport(QNetworkAccessManager *manager = 0);
+
+    void setNetworkManager(QNetworkAccessManager *manager);
+    QNetworkAccessManager *networkManager() const;
+
+    QNetworkReply *get(const QNetworkRequest &request);
+    QNetworkReply *post(const QNetworkRequest &request, const QByteArray &data);
+    void preconnect(const QUrl &url);
+
+private:
+    QNetworkAccessManager *manager;
+};
+
+#endif // KQOAUTHTRANSPORT_H
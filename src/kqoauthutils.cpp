@@ -20,24 +20,43 @@
 #include <QString>
 #include <QCryptographicHash>
 #include <QByteArray>
+#include <QUrl>
+#include <QtAlgorithms>
 
 #include <QtDebug>
 #include "kqoauthutils.h"
 
-QString KQOAuthUtils::hmac_sha1(const QString &message, const QString &key)
+namespace
 {
-    QByteArray keyBytes = key.toAscii();
-    int keyLength;              // Lenght of key word
     const int blockSize = 64;   // Both MD5 and SHA-1 have a block size of 64.
 
-    keyLength = keyBytes.size();
-    // If key is longer than block size, we need to hash the key
-    if (keyLength > blockSize) {
-        QCryptographicHash hash(QCryptographicHash::Sha1);
-        hash.addData(keyBytes);
-        keyBytes = hash.result();
+    QByteArray prepareKey(const QByteArray &key)
+    {
+        // If key is longer than block size, we need to hash the key
+        if (key.size() > blockSize) {
+            return QCryptographicHash::hash(key, QCryptographicHash::Sha1);
+        }
+
+        return key;
     }
+}
+
+QString KQOAuthUtils::hmac_sha1(const QString &message, const QString &key)
+{
+    return hmac_sha1_with_key(message.toAscii(), prepareKey(key.toAscii()));
+}
+
+QByteArray KQOAuthUtils::hmac_sha1_key(const QString &consumerSecret, const QString &tokenSecret)
+{
+    QByteArray key = QUrl::toPercentEncoding(consumerSecret);
+    key.append('&');
+    key.append(QUrl::toPercentEncoding(tokenSecret));
+
+    return prepareKey(key);
+}
 
+QString KQOAuthUtils::hmac_sha1_with_key(const QByteArray &message, const QByteArray &preparedKey)
+{
     /* http://tools.ietf.org/html/rfc2104  - (1) */
     // Create the opad and ipad for the hash function.
     QByteArray ipad;
@@ -46,8 +65,8 @@ QString KQOAuthUtils::hmac_sha1(const QString &message, const QString &key)
     ipad.fill( 0, blockSize);
     opad.fill( 0, blockSize);
 
-    ipad.replace(0, keyBytes.length(), keyBytes);
-    opad.replace(0, keyBytes.length(), keyBytes);
+    ipad.replace(0, preparedKey.length(), preparedKey);
+    opad.replace(0, preparedKey.length(), preparedKey);
 
     /* http://tools.ietf.org/html/rfc2104 - (2) & (5) */
     for (int i=0; i<64; i++) {
@@ -60,7 +79,7 @@ QString KQOAuthUtils::hmac_sha1(const QString &message, const QString &key)
 
     workArray.append(ipad, 64);
     /* http://tools.ietf.org/html/rfc2104 - (3) */
-    workArray.append(message.toAscii());
+    workArray.append(message);
 
 
     /* http://tools.ietf.org/html/rfc2104 - (4) */
@@ -77,3 +96,44 @@ QString KQOAuthUtils::hmac_sha1(const QString &message, const QString &key)
     sha1 = QCryptographicHash::hash(workArray, QCryptographicHash::Sha1);
     return QString(sha1.toBase64());
 }
+
+QByteArray KQOAuthUtils::signatureBaseString(const QString &method, const QUrl &url,
+                                             const QList< QPair<QString, QString> > &parameters)
+{
+    /* http://tools.ietf.org/html/rfc5849#section-3.4.1.2 */
+    // Lower case scheme, no user info, query or fragment, and no default port.
+    QUrl baseUrl(url);
+    baseUrl.setScheme(baseUrl.scheme().toLower());
+    if ((baseUrl.scheme() == "http" && baseUrl.port() == 80)
+        || (baseUrl.scheme() == "https" && baseUrl.port() == 443)) {
+        baseUrl.setPort(-1);
+    }
+
+    /* http://tools.ietf.org/html/rfc5849#section-3.4.1.3.2 */
+    // Sorted by the encoded names, then the encoded values, byte by byte.
+    QList< QPair<QByteArray, QByteArray> > encoded;
+    QPair<QString, QString> parameter;
+    foreach (parameter, parameters) {
+        encoded.append(qMakePair(QUrl::toPercentEncoding(parameter.first),
+                                 QUrl::toPercentEncoding(parameter.second)));
+    }
+    qSort(encoded);
+
+    QByteArray normalized;
+    for (int i = 0; i < encoded.size(); i++) {
+        if (i > 0) {
+            normalized.append('&');
+        }
+        normalized.append(encoded.at(i).first + '=' + encoded.at(i).second);
+    }
+
+    /* http://tools.ietf.org/html/rfc5849#section-3.4.1.1 */
+    QByteArray baseString = method.toUpper().toUtf8();
+    baseString.append('&');
+    baseString.append(QUrl::toPercentEncoding(baseUrl.toString(QUrl::RemoveUserInfo | QUrl::RemoveQuery
+                                                               | QUrl::RemoveFragment)));
+    baseString.append('&');
+    baseString.append(QUrl::toPercentEncoding(QString::fromLatin1(normalized)));
+
+    return baseString;
+}
@@ -20,14 +20,30 @@
 #ifndef KQOAUTHUTILS_H
 #define KQOAUTHUTILS_H
 
+#include <QList>
+#include <QPair>
+
 #include "kqoauthglobals.h"
 
 class QString;
+class QByteArray;
+class QUrl;
 class KQOAUTH_EXPORT KQOAuthUtils
 {
 public:
 
     static QString hmac_sha1(const QString &message, const QString &key);
+
+    // HMAC-SHA1 with a key prepared by hmac_sha1_key(), for signing many messages with the same key.
+    static QString hmac_sha1_with_key(const QByteArray &message, const QByteArray &preparedKey);
+    // The OAuth HMAC-SHA1 key for the given secrets, already hashed if it is longer than a block.
+    static QByteArray hmac_sha1_key(const QString &consumerSecret, const QString &tokenSecret);
+
+    // The signature base string of RFC 5849, section 3.4.1. Used both for signing and for
+    // verifying, so the two always agree. 'parameters' are all the parameters of the request,
+    // decoded and without oauth_signature; the query of 'url' is not looked at.
+    static QByteArray signatureBaseString(const QString &method, const QUrl &url,
+                                          const QList< QPair<QString, QString> > &parameters);
 };
 
 #endif // KQOAUTHUTILS_H
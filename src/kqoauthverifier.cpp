@@ -0,0 +1,290 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QDateTime>
+#include <QList>
+#include <QMutexLocker>
+#include <QPair>
+#include <QtDebug>
+
+#include "kqoauthverifier.h"
+#include "kqoauthverifier_p.h"
+#include "kqoauthformparser.h"
+#include "kqoauthutils.h"
+
+namespace
+{
+    const int defaultTimestampWindow = 300;
+    const int bucketSeconds = 10;
+    const int shardCount = 16;
+
+    // Takes as long for every pair of equally long inputs, wherever they differ.
+    bool constantTimeEquals(const QByteArray &left, const QByteArray &right) {
+        if (left.size() != right.size()) {
+            return false;
+        }
+
+        unsigned char difference = 0;
+        for (int i = 0; i < left.size(); i++) {
+            difference |= static_cast<unsigned char>(left.at(i) ^ right.at(i));
+        }
+        return difference == 0;
+    }
+
+    // Qt 4 has no explicit acquire load for atomic integers.
+    inline int loadAcquire(const QAtomicInt &value) {
+#if QT_VERSION >= 0x050000
+        return value.loadAcquire();
+#else
+        return const_cast<QAtomicInt &>(value).fetchAndAddAcquire(0);
+#endif
+    }
+}
+
+//////////// Nonce cache /////////
+
+KQOAuthNonceCache::KQOAuthNonceCache(int timestampWindow, int shardCount) :
+    shards(new Shard[shardCount]),
+    shardCount(shardCount)
+{
+    int bucketCount = bucketsFor(timestampWindow);
+    for (int i = 0; i < shardCount; i++) {
+        shards[i].buckets.resize(bucketCount);
+    }
+}
+
+KQOAuthNonceCache::~KQOAuthNonceCache() {
+    delete[] shards;
+}
+
+bool KQOAuthNonceCache::insert(const QByteArray &key, qint64 timestamp) {
+    Shard &shard = shards[qHash(key) % uint(shardCount)];
+    qint64 slot = timestamp / bucketSeconds;
+
+    QMutexLocker locker(&shard.mutex);
+    Bucket &bucket = shard.buckets[int(slot % shard.buckets.size())];
+    if (bucket.slot != slot) {
+        if (bucket.slot > slot) {
+            return false;
+        }
+        // The entries of the bucket are out of the window by now.
+        bucket.keys.clear();
+        bucket.slot = slot;
+    }
+
+    if (bucket.keys.contains(key)) {
+        return false;
+    }
+    bucket.keys.insert(key);
+    return true;
+}
+
+void KQOAuthNonceCache::resize(int timestampWindow) {
+    int bucketCount = bucketsFor(timestampWindow);
+
+    for (int i = 0; i < shardCount; i++) {
+        Shard &shard = shards[i];
+        QMutexLocker locker(&shard.mutex);
+        if (shard.buckets.size() == bucketCount) {
+            continue;
+        }
+
+        // Each bucket moves to the place of its slot in the new ring. When shrinking, the
+        // newer of two colliding buckets is kept; the older one is out of the new window.
+        QVector<Bucket> buckets(bucketCount);
+        for (int j = 0; j < shard.buckets.size(); j++) {
+            const Bucket &old = shard.buckets.at(j);
+            if (old.slot < 0) {
+                continue;
+            }
+
+            Bucket &target = buckets[int(old.slot % bucketCount)];
+            if (old.slot > target.slot) {
+                target = old;
+            }
+        }
+        shard.buckets = buckets;
+    }
+}
+
+// Accepted timestamps span twice the window; one more bucket for the partial ones.
+int KQOAuthNonceCache::bucketsFor(int timestampWindow) {
+    return 2 * timestampWindow / bucketSeconds + 2;
+}
+
+//////////// Private d_ptr implementation /////////
+
+KQOAuthVerifierPrivate::KQOAuthVerifierPrivate() :
+    timestampWindow(defaultTimestampWindow),
+    nonces(defaultTimestampWindow, shardCount)
+{
+
+}
+
+KQOAuthVerifierPrivate::~KQOAuthVerifierPrivate() {
+
+}
+
+/////////////// Public implementation ////////////////
+
+KQOAuthVerifier::KQOAuthVerifier() :
+    d_ptr(new KQOAuthVerifierPrivate)
+{
+
+}
+
+KQOAuthVerifier::~KQOAuthVerifier() {
+    delete d_ptr;
+}
+
+void KQOAuthVerifier::setTimestampWindow(int seconds) {
+    Q_D(KQOAuthVerifier);
+
+    if (seconds <= 0) {
+        qWarning() << "The timestamp window must be positive.";
+        return;
+    }
+
+    // The cache must always cover the window verify() uses: grown before the window
+    // is widened, and shrunk only after it is narrowed.
+    if (seconds > loadAcquire(d->timestampWindow)) {
+        d->nonces.resize(seconds);
+        d->timestampWindow.fetchAndStoreOrdered(seconds);
+    } else {
+        d->timestampWindow.fetchAndStoreOrdered(seconds);
+        d->nonces.resize(seconds);
+    }
+}
+
+int KQOAuthVerifier::timestampWindow() const {
+    Q_D(const KQOAuthVerifier);
+    return loadAcquire(d->timestampWindow);
+}
+
+KQOAuthParameters KQOAuthVerifier::parseAuthorizationHeader(const QByteArray &header) {
+    KQOAuthParameters parameters;
+
+    QByteArray value = header.trimmed();
+    if (value.left(6).toLower() != "oauth ") {
+        return parameters;
+    }
+
+    foreach (const QByteArray &item, value.mid(6).split(',')) {
+        QByteArray pair = item.trimmed();
+        int equals = pair.indexOf('=');
+        if (equals <= 0) {
+            continue;
+        }
+
+        QByteArray quoted = pair.mid(equals + 1).trimmed();
+        if (quoted.size() >= 2 && quoted.startsWith('"') && quoted.endsWith('"')) {
+            quoted = quoted.mid(1, quoted.size() - 2);
+        }
+
+        QString key = QUrl::fromPercentEncoding(pair.left(equals).trimmed());
+        if (key != "realm") {
+            parameters.insert(key, QUrl::fromPercentEncoding(quoted));
+        }
+    }
+
+    return parameters;
+}
+
+QByteArray KQOAuthVerifier::signatureBaseString(const QByteArray &method, const QUrl &url,
+                                                const KQOAuthParameters &parameters) {
+    KQOAuthParameters allParameters = parameters;
+#if QT_VERSION >= 0x050000
+    allParameters += KQOAuthFormParser::parseToMap(url.query(QUrl::FullyEncoded).toLatin1());
+#else
+    allParameters += KQOAuthFormParser::parseToMap(url.encodedQuery());
+#endif
+
+    QList< QPair<QString, QString> > pairs;
+    KQOAuthParameters::const_iterator it;
+    for (it = allParameters.constBegin(); it != allParameters.constEnd(); ++it) {
+        if (it.key() != OAUTH_KEY_SIGNATURE && it.key() != "realm") {
+            pairs.append(qMakePair(it.key(), it.value()));
+        }
+    }
+
+    // The same rules as KQOAuthRequest signs with.
+    return KQOAuthUtils::signatureBaseString(QString::fromLatin1(method), url, pairs);
+}
+
+KQOAuthVerifier::Result KQOAuthVerifier::verify(const QByteArray &method, const QUrl &url,
+                                                const KQOAuthParameters &oauthParameters,
+                                                const QString &consumerSecret, const QString &tokenSecret,
+                                                const KQOAuthParameters &formParameters) {
+    Q_D(KQOAuthVerifier);
+
+    QString signature = oauthParameters.value(OAUTH_KEY_SIGNATURE);
+    QString consumerKey = oauthParameters.value(OAUTH_KEY_CONSUMER_KEY);
+    QString timestampString = oauthParameters.value(OAUTH_KEY_TIMESTAMP);
+    QString nonce = oauthParameters.value(OAUTH_KEY_NONCE);
+    if (signature.isEmpty() || consumerKey.isEmpty() || timestampString.isEmpty() || nonce.isEmpty()
+        || !oauthParameters.contains(OAUTH_KEY_SIGNATURE_METHOD)) {
+        return ParameterAbsent;
+    }
+
+    if (oauthParameters.contains(OAUTH_KEY_VERSION) && oauthParameters.value(OAUTH_KEY_VERSION) != "1.0") {
+        return VersionRejected;
+    }
+
+    if (oauthParameters.value(OAUTH_KEY_SIGNATURE_METHOD) != "HMAC-SHA1") {
+        return SignatureMethodRejected;
+    }
+
+    bool ok = false;
+    qint64 timestamp = timestampString.toLongLong(&ok);
+    qint64 now = QDateTime::currentDateTime().toTime_t();
+    if (!ok || qAbs(now - timestamp) > loadAcquire(d->timestampWindow)) {
+        return TimestampRefused;
+    }
+
+    KQOAuthParameters parameters = oauthParameters;
+    parameters += formParameters;
+    QByteArray baseString = signatureBaseString(method, url, parameters);
+    QString expected = KQOAuthUtils::hmac_sha1_with_key(baseString,
+                                                        KQOAuthUtils::hmac_sha1_key(consumerSecret, tokenSecret));
+    if (!constantTimeEquals(expected.toLatin1(), signature.toLatin1())) {
+        return SignatureInvalid;
+    }
+
+    // Only nonces of correctly signed requests are recorded, so others cannot fill the cache.
+    QString token = oauthParameters.value(OAUTH_KEY_TOKEN);
+    QByteArray key = (consumerKey + '&' + token + '&' + timestampString + '&' + nonce).toUtf8();
+    if (!d->nonces.insert(key, timestamp)) {
+        return NonceUsed;
+    }
+
+    return Valid;
+}
+
+QByteArray KQOAuthVerifier::problem(Result result) {
+    switch (result) {
+    case Valid: return QByteArray();
+    case ParameterAbsent: return "parameter_absent";
+    case VersionRejected: return "version_rejected";
+    case SignatureMethodRejected: return "signature_method_rejected";
+    case TimestampRefused: return "timestamp_refused";
+    case SignatureInvalid: return "signature_invalid";
+    case NonceUsed: return "nonce_used";
+    }
+    return QByteArray();
+}
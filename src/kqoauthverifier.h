@@ -0,0 +1,96 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHVERIFIER_H
+#define KQOAUTHVERIFIER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QUrl>
+
+#include "kqoauthglobals.h"
+#include "kqoauthrequest.h"
+
+class KQOAuthVerifierPrivate;
+
+/**
+ * Checks incoming OAuth 1.0a requests on the service provider side.
+ *
+ * The signature base string is rebuilt by the same code KQOAuthRequest signs with,
+ * and the HMAC-SHA1 signature is compared in constant time. Nonces of accepted requests are
+ * remembered until their timestamp falls out of the accepted window, so a replayed
+ * request is refused. The nonce cache is split into shards with a lock each and
+ * expires a whole time bucket at once, so verify() may be called from many threads.
+ *
+ * Typical use:
+ *
+ *   KQOAuthParameters oauth = KQOAuthVerifier::parseAuthorizationHeader(header);
+ *   // Look up the secrets of oauth.value("oauth_consumer_key") and oauth.value("oauth_token").
+ *   if (verifier.verify("POST", url, oauth, consumerSecret, tokenSecret, formParameters)
+ *       != KQOAuthVerifier::Valid) {
+ *       // Answer 401 with "oauth_problem=" + KQOAuthVerifier::problem(result).
+ *   }
+ */
+class KQOAUTH_EXPORT KQOAuthVerifier
+{
+public:
+    enum Result {
+        Valid = 0,
+        ParameterAbsent,            // A required oauth_ parameter is missing.
+        VersionRejected,
+        SignatureMethodRejected,    // Only HMAC-SHA1 is supported.
+        TimestampRefused,
+        SignatureInvalid,
+        NonceUsed
+    };
+
+    KQOAuthVerifier();
+    ~KQOAuthVerifier();
+
+    // Seconds a timestamp may differ from the clock of this host. Defaults to 300.
+    // Nonces recorded so far are kept. May be called while other threads verify.
+    void setTimestampWindow(int seconds);
+    int timestampWindow() const;
+
+    // Returns the oauth_ parameters of an 'OAuth ...' Authorization header, decoded.
+    // The realm is left out. Empty if the header is not an OAuth header.
+    static KQOAuthParameters parseAuthorizationHeader(const QByteArray &header);
+
+    // The signature base string of a request. 'url' may carry a query, whose parameters
+    // are included. 'parameters' are the oauth_ and form body parameters, without
+    // oauth_signature.
+    static QByteArray signatureBaseString(const QByteArray &method, const QUrl &url,
+                                          const KQOAuthParameters &parameters);
+
+    // Checks the request and, if it is valid, records its nonce. 'formParameters' are the
+    // parameters of an application/x-www-form-urlencoded body. Thread safe.
+    Result verify(const QByteArray &method, const QUrl &url, const KQOAuthParameters &oauthParameters,
+                  const QString &consumerSecret, const QString &tokenSecret,
+                  const KQOAuthParameters &formParameters = KQOAuthParameters());
+
+    // The oauth_problem value for a result, as in the OAuth Problem Reporting extension.
+    static QByteArray problem(Result result);
+
+private:
+    KQOAuthVerifierPrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(KQOAuthVerifier);
+    Q_DISABLE_COPY(KQOAuthVerifier);
+};
+
+#endif // KQOAUTHVERIFIER_H
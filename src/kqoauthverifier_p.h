@@ -0,0 +1,84 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@gmail.com)
+ *         http://www.johanpaul.com
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KQOAUTHVERIFIER_P_H
+#define KQOAUTHVERIFIER_P_H
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QSet>
+#include <QVector>
+
+#include "kqoauthverifier.h"
+
+/**
+ * Remembers nonces by the timestamp they were sent with. Each shard keeps a ring of
+ * buckets that cover 'bucketSeconds' of timestamps each, enough to span the accepted
+ * window. A bucket is emptied as a whole when it is reused for newer timestamps, so
+ * entries expire without being scanned. The ring of each shard is only touched under
+ * the lock of the shard, so the window can be changed while others insert.
+ */
+class KQOAuthNonceCache {
+
+public:
+    KQOAuthNonceCache(int timestampWindow, int shardCount);
+    ~KQOAuthNonceCache();
+
+    // Records 'key' sent at 'timestamp'. Returns false if it was recorded already, or if
+    // the timestamp is older than the buckets kept.
+    bool insert(const QByteArray &key, qint64 timestamp);
+
+    // Resizes the rings for 'timestampWindow', keeping the nonces recorded so far.
+    void resize(int timestampWindow);
+
+private:
+    struct Bucket
+    {
+        Bucket() : slot(-1) {}
+
+        qint64 slot;            // timestamp / bucketSeconds of the entries.
+        QSet<QByteArray> keys;
+    };
+
+    struct Shard
+    {
+        QMutex mutex;
+        QVector<Bucket> buckets;
+        char padding[64];       // Keeps the locks of neighbouring shards on separate cache lines.
+    };
+
+    static int bucketsFor(int timestampWindow);
+
+    Shard *shards;
+    int shardCount;
+
+    Q_DISABLE_COPY(KQOAuthNonceCache);
+};
+
+class KQOAuthVerifierPrivate {
+
+public:
+    KQOAuthVerifierPrivate();
+    ~KQOAuthVerifierPrivate();
+
+    QAtomicInt timestampWindow;
+    KQOAuthNonceCache nonces;
+};
+
+#endif // KQOAUTHVERIFIER_P_H
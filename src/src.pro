@@ -6,6 +6,7 @@ VERSION = 0.97
 
 TEMPLATE = lib
 QT += network
+QT -= gui
 CONFIG += \
     create_prl
 
@@ -18,6 +19,15 @@ INC_DIR = ../include
 INCLUDEPATH += .
 
 PUBLIC_HEADERS += kqoauthmanager.h \
+                  kqoauththreadedmanager.h \
+                  kqoauthpendingreply.h \
+                  kqoauthawaitable.h \
+                  kqoauthcredentialregistry.h \
+                  kqoauthtokenstore.h \
+                  kqoauthsessioncache.h \
+                  kqoauthtransport.h \
+                  kqoauthloopbacktransport.h \
+                  kqoauthverifier.h \
                   kqoauthrequest.h \
                   kqoauthrequest_1.h \
                   kqoauthrequest_xauth.h \
@@ -28,7 +38,20 @@ PRIVATE_HEADERS +=  kqoauthrequest_p.h \
                     kqoauthauthreplyserver.h \
                     kqoauthauthreplyserver_p.h \
                     kqoauthutils.h \
-                    kqoauthrequest_xauth_p.h
+                    kqoauthrequest_xauth_p.h \
+                    kqoauthtimerwheel.h \
+                    kqoauthmanagerthread.h \
+                    kqoauththreadedmanager_p.h \
+                    kqoauthsubmissionqueue.h \
+                    kqoauthpendingreply_p.h \
+                    kqoauthcredentialregistry_p.h \
+                    kqoauthtokenstore_p.h \
+                    kqoauthsessioncache_p.h \
+                    kqoauthformparser.h \
+                    kqoauthhttpclient.h \
+                    kqoauthloopbacktransport_p.h \
+                    kqoauthperthread.h \
+                    kqoauthverifier_p.h
 
 HEADERS = \
     $$PUBLIC_HEADERS \
@@ -40,7 +63,20 @@ SOURCES += \
     kqoauthutils.cpp \
     kqoauthauthreplyserver.cpp \
     kqoauthrequest_1.cpp \
-    kqoauthrequest_xauth.cpp
+    kqoauthrequest_xauth.cpp \
+    kqoauthtimerwheel.cpp \
+    kqoauthmanagerthread.cpp \
+    kqoauththreadedmanager.cpp \
+    kqoauthsubmissionqueue.cpp \
+    kqoauthpendingreply.cpp \
+    kqoauthcredentialregistry.cpp \
+    kqoauthtokenstore.cpp \
+    kqoauthsessioncache.cpp \
+    kqoauthformparser.cpp \
+    kqoauthhttpclient.cpp \
+    kqoauthtransport.cpp \
+    kqoauthloopbacktransport.cpp \
+    kqoauthverifier.cpp
 
 DEFINES += KQOAUTH
 
@@ -0,0 +1,891 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@d-pointer.com)
+ *         http://www.d-pointer.com
+ *
+ *  KQOAuth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "bench_kqoauth.h"
+
+// Qt includes
+#include <QtDebug>
+#include <QTest>
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QFile>
+#include <QNetworkReply>
+#include <QTcpSocket>
+#include <QtAlgorithms>
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+#ifdef Q_OS_UNIX
+#include <time.h>
+#endif
+
+// Project includes
+#include "kqoauthrequest.h"
+#include "kqoauthmanager.h"
+#include <kqoauthsubmissionqueue.h>
+#include <kqoauthcredentialregistry.h>
+#include <kqoauthloopbacktransport.h>
+#include <kqoauthrequest_p.h>
+#include <kqoauthmanager_p.h>
+#include <kqoauthauthreplyserver_p.h>
+#include <kqoauthutils.h>
+
+namespace
+{
+    const int submissionsPerProducer = 10000;
+    const int managersForMemory = 1000;
+    const int requestsPerBurst = 100;
+    // Requests answered per measurement of the overhead benchmark, at least.
+    const int overheadRequests = 2000;
+
+    const QByteArray standInResponse("HTTP/1.1 200 OK\r\n"
+                                     "Content-Type: application/x-www-form-urlencoded\r\n"
+                                     "Content-Length: 4\r\n"
+                                     "Connection: keep-alive\r\n"
+                                     "\r\n"
+                                     "ok=1");
+
+    // Resident set size of the process in bytes, 0 if unknown.
+    qint64 residentSetSize() {
+#ifdef Q_OS_LINUX
+        QFile statm("/proc/self/statm");
+        if (statm.open(QIODevice::ReadOnly)) {
+            QList<QByteArray> fields = statm.readAll().split(' ');
+            if (fields.size() > 1) {
+                return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+            }
+        }
+#endif
+        return 0;
+    }
+
+    // CPU time of the process in microseconds, -1 if unknown.
+    qint64 processCpuTime() {
+#ifdef Q_OS_UNIX
+        timespec time;
+        if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) == 0) {
+            return qint64(time.tv_sec) * 1000000 + time.tv_nsec / 1000;
+        }
+#endif
+        return -1;
+    }
+
+    // An authorized POST request with 'parameterCount' additional parameters.
+    void setUpRequest(KQOAuthRequest *request, int parameterCount,
+                      const QUrl &url = QUrl("https://api.example.com/1/statuses/update.json")) {
+        request->initRequest(KQOAuthRequest::AuthorizedRequest, url);
+        request->setHttpMethod(KQOAuthRequest::POST);
+        request->setConsumerKey("consumer");
+        request->setConsumerSecretKey("consumerSecret");
+        request->setToken("token");
+        request->setTokenSecret("tokenSecret");
+
+        KQOAuthParameters parameters;
+        for (int i = 0; i < parameterCount; i++) {
+            parameters.insert(QString("parameter%1").arg(i), QString("value %1 & more/~").arg(i));
+        }
+        request->setAdditionalParameters(parameters);
+    }
+
+    // Text with about as many characters to escape as a status update has.
+    QString payload(int size) {
+        const QString pattern("Hello Ladies + Gentlemen, a signed OAuth request! ");
+        QString result;
+        result.reserve(size);
+        while (result.size() < size) {
+            result.append(pattern);
+        }
+        result.truncate(size);
+        return result;
+    }
+
+    // A form encoded reply such as a token endpoint or an OAuth callback sends.
+    QByteArray formData(int parameterCount) {
+        QByteArray result = "oauth_token=nnch734d00sl2jdk&oauth_token_secret=pfkkdhi9sl3r4s00";
+        for (int i = 0; i < parameterCount; i++) {
+            result.append("&parameter" + QByteArray::number(i) + "=value%20" + QByteArray::number(i));
+        }
+        return result;
+    }
+}
+
+SubmissionProducer::SubmissionProducer(KQOAuthSubmissionQueue *queue, QObject *receiver,
+                                       int count, QSemaphore *startSignal) :
+    queue(queue),
+    receiver(receiver),
+    count(count),
+    startSignal(startSignal)
+{
+
+}
+
+void SubmissionProducer::run() {
+    startSignal->acquire();
+
+    for (int i = 0; i < count; i++) {
+        if (queue) {
+            KQOAuthSubmission *submission = new KQOAuthSubmission;
+            submission->userData = i;
+            queue->enqueue(submission);
+        } else {
+            QMetaObject::invokeMethod(receiver, "submit", Qt::QueuedConnection,
+                                      Q_ARG(KQOAuthRequest*, 0),
+                                      Q_ARG(QVariant, QVariant(i)));
+        }
+    }
+}
+
+void SubmissionReceiver::submit(KQOAuthRequest *request, const QVariant &userData) {
+    Q_UNUSED(request)
+    Q_UNUSED(userData)
+    received++;
+}
+
+void BurstReceiver::onReply(KQOAuthManager::KQOAuthReply reply) {
+    latencies.append(clock->elapsed() - reply.userData.toLongLong());
+    emit received();
+}
+
+HttpStandIn::HttpStandIn(QAtomicInt *acceptedConnections) :
+    acceptedConnections(acceptedConnections)
+{
+    connect(this, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+}
+
+void HttpStandIn::onNewConnection() {
+    while (hasPendingConnections()) {
+        QTcpSocket *socket = nextPendingConnection();
+        if (acceptedConnections) {
+            acceptedConnections->fetchAndAddRelaxed(1);
+        }
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        buffers.insert(socket, QByteArray());
+
+        connect(socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+    }
+}
+
+void HttpStandIn::onReadyRead() {
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if (socket == 0 || !buffers.contains(socket)) {
+        return;
+    }
+
+    QByteArray &buffer = buffers[socket];
+    buffer.append(socket->readAll());
+
+    // Answers the complete requests at once, pipelined ones included.
+    QByteArray responses;
+    forever {
+        int headEnd = buffer.indexOf("\r\n\r\n");
+        if (headEnd < 0) {
+            break;
+        }
+
+        int length = 0;
+        QByteArray head = buffer.left(headEnd).toLower();
+        int header = head.indexOf("\r\ncontent-length:");
+        if (header >= 0) {
+            int valueStart = header + 17;
+            int valueEnd = head.indexOf("\r\n", valueStart);
+            length = head.mid(valueStart, valueEnd < 0 ? -1 : valueEnd - valueStart).trimmed().toInt();
+        }
+
+        if (buffer.size() < headEnd + 4 + length) {
+            break;
+        }
+        buffer.remove(0, headEnd + 4 + length);
+        // preconnect() sends a HEAD request with Qt older than 5.2.
+        if (head.startsWith("head ")) {
+            responses.append(standInResponse.left(standInResponse.indexOf("\r\n\r\n") + 4));
+        } else {
+            responses.append(standInResponse);
+        }
+    }
+
+    if (!responses.isEmpty()) {
+        socket->write(responses);
+    }
+}
+
+void HttpStandIn::onDisconnected() {
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if (socket == 0) {
+        return;
+    }
+
+    buffers.remove(socket);
+    socket->deleteLater();
+}
+
+quint16 HttpStandInThread::startListening() {
+    start();
+    listening.acquire();
+    return port;
+}
+
+int HttpStandInThread::acceptedConnections() {
+    return accepted.fetchAndAddOrdered(0);
+}
+
+void HttpStandInThread::run() {
+    HttpStandIn server(&accepted);
+    server.listen(QHostAddress::LocalHost, 0);
+    port = server.serverPort();
+    listening.release();
+
+    exec();
+}
+
+OverheadDriver::OverheadDriver(const QUrl &url, bool useManager, int inFlight) :
+    failed(0),
+    url(url),
+    useManager(useManager),
+    inFlight(inFlight),
+    total(0),
+    sent(0),
+    completed(0)
+{
+    sendTimes.resize(inFlight);
+
+    if (useManager) {
+        for (int i = 0; i < inFlight; i++) {
+            requests.append(new KQOAuthRequest);
+        }
+        connect(&manager, SIGNAL(replyReceived(KQOAuthManager::KQOAuthReply)),
+                this, SLOT(onManagerReply(KQOAuthManager::KQOAuthReply)));
+        return;
+    }
+
+    // The headers and body the manager would send for the same request.
+    KQOAuthRequest request;
+    setUpRequest(&request, 1, url);
+
+    QByteArray authHeader = "OAuth ";
+    QList<QByteArray> parameters = request.requestParameters();
+    for (int i = 0; i < parameters.size(); i++) {
+        if (i > 0) {
+            authHeader.append(", ");
+        }
+        authHeader.append(parameters.at(i));
+    }
+
+    signedRequest.setUrl(url);
+    signedRequest.setRawHeader("Authorization", authHeader);
+    signedRequest.setHeader(QNetworkRequest::ContentTypeHeader, request.contentType());
+    body = request.requestBody();
+}
+
+OverheadDriver::~OverheadDriver() {
+    qDeleteAll(requests);
+}
+
+void OverheadDriver::run(int total) {
+    this->total = total;
+    sent = 0;
+    completed = 0;
+    failed = 0;
+    latencies.clear();
+    clock.start();
+
+    for (int slot = 0; slot < qMin(inFlight, total); slot++) {
+        send(slot);
+    }
+
+    while (completed < total) {
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+}
+
+void OverheadDriver::send(int slot) {
+    sendTimes[slot] = clock.nsecsElapsed() / 1000;
+    sent++;
+
+    if (useManager) {
+        KQOAuthRequest *request = requests.at(slot);
+        setUpRequest(request, 1, url);
+        manager.executeRequest(request, slot);
+    } else {
+        QNetworkRequest request(signedRequest);
+        request.setAttribute(QNetworkRequest::User, slot);
+        QNetworkReply *reply = network.post(request, body);
+        connect(reply, SIGNAL(finished()), this, SLOT(onNetworkReply()));
+    }
+}
+
+void OverheadDriver::onManagerReply(KQOAuthManager::KQOAuthReply reply) {
+    complete(reply.userData.toInt(), reply.error == KQOAuthManager::NoError && reply.statusCode == 200);
+}
+
+void OverheadDriver::onNetworkReply() {
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    if (reply == 0) {
+        return;
+    }
+
+    reply->readAll();
+    int slot = reply->request().attribute(QNetworkRequest::User).toInt();
+    bool ok = reply->error() == QNetworkReply::NoError;
+    reply->deleteLater();
+
+    complete(slot, ok);
+}
+
+void OverheadDriver::complete(int slot, bool ok) {
+    latencies.append(clock.nsecsElapsed() / 1000 - sendTimes.at(slot));
+    if (!ok) {
+        failed++;
+    }
+    completed++;
+
+    if (sent < total) {
+        send(slot);
+    }
+}
+
+void Bench_KQOAuth::initTestCase() {
+    qRegisterMetaType<KQOAuthRequest *>("KQOAuthRequest*");
+}
+
+void Bench_KQOAuth::addProducerRows() {
+    QTest::addColumn<int>("producers");
+
+    QTest::newRow("1 producer") << 1;
+    QTest::newRow("4 producers") << 4;
+    QTest::newRow("16 producers") << 16;
+}
+
+void Bench_KQOAuth::bench_submissionQueue_data() {
+    addProducerRows();
+}
+
+void Bench_KQOAuth::bench_submissionQueue() {
+    QFETCH(int, producers);
+
+    const int total = producers * submissionsPerProducer;
+
+    QBENCHMARK {
+        KQOAuthSubmissionQueue queue;
+        QSemaphore startSignal;
+        QList<SubmissionProducer *> threads;
+        for (int i = 0; i < producers; i++) {
+            threads.append(new SubmissionProducer(&queue, 0, submissionsPerProducer, &startSignal));
+            threads.last()->start();
+        }
+
+        startSignal.release(producers);
+
+        // Drain like KQOAuthManager does, but spin instead of waiting for the wake-up event.
+        int received = 0;
+        while (received < total) {
+            queue.beginDrain();
+            KQOAuthSubmission *submission;
+            while ((submission = queue.dequeue()) != 0) {
+                delete submission;
+                received++;
+            }
+        }
+
+        foreach (SubmissionProducer *thread, threads) {
+            thread->wait();
+        }
+        qDeleteAll(threads);
+    }
+}
+
+void Bench_KQOAuth::bench_queuedInvocation_data() {
+    addProducerRows();
+}
+
+// The baseline: what a cross-thread executeRequest() costs with queued slot calls.
+void Bench_KQOAuth::bench_queuedInvocation() {
+    QFETCH(int, producers);
+
+    const int total = producers * submissionsPerProducer;
+
+    QBENCHMARK {
+        SubmissionReceiver receiver;
+        QSemaphore startSignal;
+        QList<SubmissionProducer *> threads;
+        for (int i = 0; i < producers; i++) {
+            threads.append(new SubmissionProducer(0, &receiver, submissionsPerProducer, &startSignal));
+            threads.last()->start();
+        }
+
+        startSignal.release(producers);
+
+        while (receiver.received < total) {
+            QCoreApplication::sendPostedEvents(&receiver, QEvent::MetaCall);
+        }
+
+        foreach (SubmissionProducer *thread, threads) {
+            thread->wait();
+        }
+        qDeleteAll(threads);
+    }
+}
+
+void Bench_KQOAuth::bench_managerCreation() {
+    QBENCHMARK {
+        KQOAuthManager manager;
+    }
+}
+
+void Bench_KQOAuth::bench_managerMemory() {
+    qint64 before = residentSetSize();
+    if (before == 0) {
+#if QT_VERSION >= 0x050000
+        QSKIP("Resident set size is not available on this platform.");
+#else
+        QSKIP("Resident set size is not available on this platform.", SkipSingle);
+#endif
+    }
+
+    QList<KQOAuthManager *> managers;
+    for (int i = 0; i < managersForMemory; i++) {
+        managers.append(new KQOAuthManager);
+    }
+
+    qint64 after = residentSetSize();
+    qDebug() << "Memory per manager:" << (after - before) / managersForMemory << "bytes";
+
+    qDeleteAll(managers);
+}
+
+void Bench_KQOAuth::bench_http2Burst_data() {
+    QTest::addColumn<bool>("http2");
+
+    QTest::newRow("http/1.1") << false;
+    QTest::newRow("http/2") << true;
+}
+
+// Needs a live https service, given in KQOAUTH_BENCH_URL. The signature is not checked
+// by the service, so an error reply is timed as well as a successful one.
+void Bench_KQOAuth::bench_http2Burst() {
+    QFETCH(bool, http2);
+
+    QUrl endpoint(QString::fromLocal8Bit(qgetenv("KQOAUTH_BENCH_URL")));
+    if (!endpoint.isValid() || endpoint.scheme() != "https") {
+#if QT_VERSION >= 0x050000
+        QSKIP("Set KQOAUTH_BENCH_URL to an https URL to run this benchmark.");
+#else
+        QSKIP("Set KQOAUTH_BENCH_URL to an https URL to run this benchmark.", SkipSingle);
+#endif
+    }
+
+    KQOAuthCredentialRegistry registry;
+    registry.insert("bench", "consumer", "consumerSecret", "token", "tokenSecret");
+    KQOAuthCredentials credentials = registry.credentials("bench");
+
+    KQOAuthManager manager;
+    manager.setHttp2Enabled(http2);
+    manager.preconnect(endpoint);
+
+    QElapsedTimer clock;
+    clock.start();
+    BurstReceiver receiver(&clock);
+    connect(&manager, SIGNAL(replyReceived(KQOAuthManager::KQOAuthReply)),
+            &receiver, SLOT(onReply(KQOAuthManager::KQOAuthReply)));
+
+    QEventLoop loop;
+    connect(&receiver, SIGNAL(received()), &loop, SLOT(quit()));
+
+    QBENCHMARK {
+        receiver.latencies.clear();
+        for (int i = 0; i < requestsPerBurst; i++) {
+            manager.sendAuthorizedRequest(credentials, endpoint, KQOAuthParameters(), clock.elapsed());
+        }
+        while (receiver.latencies.size() < requestsPerBurst) {
+            loop.exec();
+        }
+    }
+
+    qSort(receiver.latencies);
+    qDebug() << "Latency p50:" << receiver.latencies.at(requestsPerBurst / 2) << "ms"
+             << "p99:" << receiver.latencies.at(requestsPerBurst * 99 / 100) << "ms";
+}
+
+// The manager alone: signing, dispatch and reply handling, with an in-memory transport.
+void Bench_KQOAuth::bench_managerLoopback() {
+    KQOAuthCredentialRegistry registry;
+    registry.insert("bench", "consumer", "consumerSecret", "token", "tokenSecret");
+    KQOAuthCredentials credentials = registry.credentials("bench");
+
+    KQOAuthLoopbackTransport transport;
+    transport.setReply(QString(), 200, "{\"ok\":true}", "application/json");
+
+    KQOAuthManager manager;
+    manager.setTransport(&transport);
+
+    QElapsedTimer clock;
+    clock.start();
+    BurstReceiver receiver(&clock);
+    connect(&manager, SIGNAL(replyReceived(KQOAuthManager::KQOAuthReply)),
+            &receiver, SLOT(onReply(KQOAuthManager::KQOAuthReply)));
+
+    QEventLoop loop;
+    connect(&receiver, SIGNAL(received()), &loop, SLOT(quit()));
+
+    QUrl endpoint("https://api.example.com/1/statuses/update.json");
+    KQOAuthParameters parameters;
+    parameters.insert("status", "setting up my twitter");
+
+    QBENCHMARK {
+        receiver.latencies.clear();
+        for (int i = 0; i < requestsPerBurst; i++) {
+            manager.sendAuthorizedRequest(credentials, endpoint, parameters, clock.elapsed());
+        }
+        while (receiver.latencies.size() < requestsPerBurst) {
+            loop.exec();
+        }
+    }
+
+    qSort(receiver.latencies);
+    qDebug() << "Latency p50:" << receiver.latencies.at(requestsPerBurst / 2) << "ms"
+             << "p99:" << receiver.latencies.at(requestsPerBurst * 99 / 100) << "ms";
+}
+
+void Bench_KQOAuth::bench_sharedNetworkManager_data() {
+    QTest::addColumn<int>("managers");
+    QTest::addColumn<bool>("shared");
+
+    const int managerCounts[] = { 10, 100 };
+    for (int i = 0; i < 2; i++) {
+        int managers = managerCounts[i];
+        QTest::newRow(QString("%1 managers, own network managers").arg(managers).toLatin1().constData())
+                << managers << false;
+        QTest::newRow(QString("%1 managers, shared network manager").arg(managers).toLatin1().constData())
+                << managers << true;
+    }
+}
+
+// Many managers of one thread talking to the same service, each with a network access
+// manager of its own, or all sharing the thread's one with setUseSharedNetworkManager().
+// Reports the connections the service accepted, that is the handshakes made, and the
+// latency of the requests, connection set up included.
+void Bench_KQOAuth::bench_sharedNetworkManager() {
+    QFETCH(int, managers);
+    QFETCH(bool, shared);
+
+    HttpStandInThread standIn;
+    quint16 port = standIn.startListening();
+    QUrl endpoint(QString("http://127.0.0.1:%1/1/statuses/update.json").arg(port));
+
+    KQOAuthCredentialRegistry registry;
+    registry.insert("bench", "consumer", "consumerSecret", "token", "tokenSecret");
+    KQOAuthCredentials credentials = registry.credentials("bench");
+
+    QElapsedTimer clock;
+    clock.start();
+    BurstReceiver receiver(&clock);
+
+    QList<KQOAuthManager *> clients;
+    for (int i = 0; i < managers; i++) {
+        KQOAuthManager *manager = new KQOAuthManager;
+        manager->setUseSharedNetworkManager(shared);
+        connect(manager, SIGNAL(replyReceived(KQOAuthManager::KQOAuthReply)),
+                &receiver, SLOT(onReply(KQOAuthManager::KQOAuthReply)));
+        clients.append(manager);
+    }
+
+    QEventLoop loop;
+    connect(&receiver, SIGNAL(received()), &loop, SLOT(quit()));
+
+    // Each manager sends a few requests at once, as an application serving one user would.
+    const int requestsPerManager = 4;
+    const int total = managers * requestsPerManager;
+    // The latencies of all the runs are kept, so the first one's handshakes count.
+    QBENCHMARK {
+        int expected = receiver.latencies.size() + total;
+        for (int i = 0; i < total; i++) {
+            clients.at(i % managers)->sendAuthorizedRequest(credentials, endpoint, KQOAuthParameters(),
+                                                            clock.elapsed());
+        }
+        while (receiver.latencies.size() < expected) {
+            loop.exec();
+        }
+    }
+
+    int connections = standIn.acceptedConnections();
+    qDeleteAll(clients);
+    standIn.quit();
+    standIn.wait();
+
+    int answered = receiver.latencies.size();
+    qDebug() << "Connections accepted:" << connections << "for" << answered << "requests";
+    qSort(receiver.latencies);
+    qDebug() << "Latency p50:" << receiver.latencies.at(answered / 2) << "ms"
+             << "p99:" << receiver.latencies.at(answered * 99 / 100) << "ms";
+}
+
+void Bench_KQOAuth::bench_firstByte_data() {
+    QTest::addColumn<bool>("lean");
+    QTest::addColumn<bool>("preconnected");
+
+    QTest::newRow("QNetworkAccessManager, cold") << false << false;
+    QTest::newRow("QNetworkAccessManager, preconnect()") << false << true;
+    QTest::newRow("lean backend, cold") << true << false;
+    QTest::newRow("lean backend, preconnect()") << true << true;
+}
+
+// Time to first byte of the first request of a new manager, with and without calling
+// preconnect() beforehand. The stand-in's reply is a few bytes, so the whole reply is
+// about as quick as its first byte. Each sample uses a new manager, so its connection
+// is cold unless preconnect() opened it.
+void Bench_KQOAuth::bench_firstByte() {
+    QFETCH(bool, lean);
+    QFETCH(bool, preconnected);
+
+    HttpStandInThread standIn;
+    quint16 port = standIn.startListening();
+    QUrl endpoint(QString("http://127.0.0.1:%1/1/statuses/update.json").arg(port));
+
+    KQOAuthCredentialRegistry registry;
+    registry.insert("bench", "consumer", "consumerSecret", "token", "tokenSecret");
+    KQOAuthCredentials credentials = registry.credentials("bench");
+
+    QElapsedTimer clock;
+    clock.start();
+    BurstReceiver receiver(&clock);
+    QEventLoop loop;
+    connect(&receiver, SIGNAL(received()), &loop, SLOT(quit()));
+
+    const int samples = 200;
+    QList<qint64> firstByte;    // Microseconds.
+    for (int i = 0; i < samples; i++) {
+        KQOAuthManager manager;
+        if (lean) {
+            manager.setHttpBackend(KQOAuthManager::LeanHttpBackend);
+        }
+        connect(&manager, SIGNAL(replyReceived(KQOAuthManager::KQOAuthReply)),
+                &receiver, SLOT(onReply(KQOAuthManager::KQOAuthReply)));
+
+        // Like an application that warms up while the user is still busy elsewhere.
+        if (preconnected) {
+            int accepted = standIn.acceptedConnections();
+            manager.preconnect(endpoint);
+            QElapsedTimer waited;
+            waited.start();
+            while (standIn.acceptedConnections() == accepted && waited.elapsed() < 5000) {
+                QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+            }
+            // Let the client see the connection as established, too.
+            QTest::qWait(10);
+        }
+
+        int expected = receiver.latencies.size() + 1;
+        qint64 sent = clock.nsecsElapsed();
+        manager.sendAuthorizedRequest(credentials, endpoint, KQOAuthParameters(), clock.elapsed());
+        while (receiver.latencies.size() < expected) {
+            loop.exec();
+        }
+        firstByte.append((clock.nsecsElapsed() - sent) / 1000);
+    }
+
+    standIn.quit();
+    standIn.wait();
+
+    qSort(firstByte);
+    qDebug() << "Time to first byte p50:" << firstByte.at(samples / 2) / 1000.0 << "ms"
+             << "p99:" << firstByte.at(samples * 99 / 100) / 1000.0 << "ms";
+}
+
+void Bench_KQOAuth::addParameterCountRows() {
+    QTest::addColumn<int>("parameterCount");
+
+    QTest::newRow("1 parameter") << 1;
+    QTest::newRow("10 parameters") << 10;
+    QTest::newRow("100 parameters") << 100;
+}
+
+void Bench_KQOAuth::addPayloadSizeRows() {
+    QTest::addColumn<int>("size");
+
+    QTest::newRow("16 bytes") << 16;
+    QTest::newRow("1 KiB") << 1024;
+    QTest::newRow("64 KiB") << 65536;
+}
+
+void Bench_KQOAuth::bench_hmacSha1_data() {
+    addPayloadSizeRows();
+}
+
+void Bench_KQOAuth::bench_hmacSha1() {
+    QFETCH(int, size);
+
+    QString message = payload(size);
+    QString key("consumerSecret&tokenSecret");
+
+    QBENCHMARK {
+        KQOAuthUtils::hmac_sha1(message, key);
+    }
+}
+
+void Bench_KQOAuth::bench_percentEncoding_data() {
+    addPayloadSizeRows();
+}
+
+void Bench_KQOAuth::bench_percentEncoding() {
+    QFETCH(int, size);
+
+    QString text = payload(size);
+
+    QBENCHMARK {
+        QUrl::toPercentEncoding(text);
+    }
+}
+
+void Bench_KQOAuth::bench_requestBaseString_data() {
+    addParameterCountRows();
+}
+
+void Bench_KQOAuth::bench_requestBaseString() {
+    QFETCH(int, parameterCount);
+
+    KQOAuthRequest request;
+    setUpRequest(&request, parameterCount);
+    request.d_ptr->prepareRequest();
+
+    QBENCHMARK {
+        request.d_ptr->requestBaseString();
+    }
+}
+
+void Bench_KQOAuth::bench_requestParameters_data() {
+    addParameterCountRows();
+}
+
+// Preparing, signing and formatting the Authorization header parameters.
+void Bench_KQOAuth::bench_requestParameters() {
+    QFETCH(int, parameterCount);
+
+    KQOAuthRequest request;
+    setUpRequest(&request, parameterCount);
+
+    QBENCHMARK {
+        request.d_ptr->requestParameters.clear();
+        request.requestParameters();
+    }
+}
+
+void Bench_KQOAuth::bench_requestBody_data() {
+    addParameterCountRows();
+}
+
+void Bench_KQOAuth::bench_requestBody() {
+    QFETCH(int, parameterCount);
+
+    KQOAuthRequest request;
+    setUpRequest(&request, parameterCount);
+
+    QBENCHMARK {
+        request.requestBody();
+    }
+}
+
+void Bench_KQOAuth::bench_createTokensFromResponse_data() {
+    addParameterCountRows();
+}
+
+void Bench_KQOAuth::bench_createTokensFromResponse() {
+    QFETCH(int, parameterCount);
+
+    KQOAuthManagerPrivate manager(0);
+    QByteArray response = formData(parameterCount);
+
+    QBENCHMARK {
+        manager.createTokensFromResponse(response);
+    }
+}
+
+void Bench_KQOAuth::bench_callbackQueryParsing_data() {
+    addParameterCountRows();
+}
+
+void Bench_KQOAuth::bench_callbackQueryParsing() {
+    QFETCH(int, parameterCount);
+
+    KQOAuthAuthReplyServerPrivate server(0);
+    QByteArray target = "/callback?" + formData(parameterCount);
+
+    QBENCHMARK {
+        server.parseQueryParams(target);
+    }
+}
+
+void Bench_KQOAuth::bench_managerOverhead_data() {
+    QTest::addColumn<bool>("useManager");
+    QTest::addColumn<int>("inFlight");
+
+    const int inFlightCounts[] = { 1, 100, 10000 };
+    for (int i = 0; i < 3; i++) {
+        int inFlight = inFlightCounts[i];
+        QTest::newRow(QString("QNetworkAccessManager, %1 in flight").arg(inFlight).toLatin1().constData())
+                << false << inFlight;
+        QTest::newRow(QString("KQOAuthManager, %1 in flight").arg(inFlight).toLatin1().constData())
+                << true << inFlight;
+    }
+}
+
+// What executeRequest() and the reply handling add on top of posting the same signed
+// request with QNetworkAccessManager. Compare the rows with the same number of requests
+// in flight. The CPU time is that of the whole process, stand-in included, which does
+// the same work for both.
+void Bench_KQOAuth::bench_managerOverhead() {
+    QFETCH(bool, useManager);
+    QFETCH(int, inFlight);
+
+    HttpStandInThread standIn;
+    quint16 port = standIn.startListening();
+    QUrl url(QString("http://127.0.0.1:%1/1/statuses/update.json").arg(port));
+
+    OverheadDriver driver(url, useManager, inFlight);
+    const int total = qMax(inFlight, overheadRequests);
+
+    // Opens the connections.
+    driver.run(qMin(inFlight, requestsPerBurst));
+
+    qint64 cpuTime = 0;
+    int runs = 0;
+    QBENCHMARK {
+        qint64 start = processCpuTime();
+        driver.run(total);
+        cpuTime += processCpuTime() - start;
+        runs++;
+    }
+
+    standIn.quit();
+    standIn.wait();
+
+    if (driver.failed > 0) {
+        qWarning() << driver.failed << "of" << total << "requests failed.";
+    }
+
+    if (processCpuTime() >= 0) {
+        qDebug() << "CPU time per request:" << cpuTime / (qint64(runs) * total) << "us";
+    }
+
+    qSort(driver.latencies);
+    qDebug() << "Latency p50:" << driver.latencies.at(total / 2) / 1000.0 << "ms"
+             << "p99:" << driver.latencies.at(total * 99 / 100) / 1000.0 << "ms";
+}
+
+QTEST_MAIN(Bench_KQOAuth)
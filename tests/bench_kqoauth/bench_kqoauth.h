@@ -0,0 +1,218 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@d-pointer.com)
+ *         http://www.d-pointer.com
+ *
+ *  KQOAuth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BENCH_KQOAUTH_H
+#define BENCH_KQOAUTH_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QObject>
+#include <QSemaphore>
+#include <QTcpServer>
+#include <QThread>
+#include <QVariant>
+#include <QVector>
+
+#include "kqoauthmanager.h"
+
+class KQOAuthRequest;
+class KQOAuthSubmissionQueue;
+
+// Submits 'count' requests from its own thread, either to a submission queue
+// or as queued calls to 'receiver'.
+class SubmissionProducer : public QThread
+{
+    Q_OBJECT
+public:
+    SubmissionProducer(KQOAuthSubmissionQueue *queue, QObject *receiver,
+                       int count, QSemaphore *startSignal);
+
+protected:
+    void run();
+
+private:
+    KQOAuthSubmissionQueue *queue;
+    QObject *receiver;
+    int count;
+    QSemaphore *startSignal;
+};
+
+class SubmissionReceiver : public QObject
+{
+    Q_OBJECT
+public:
+    SubmissionReceiver() : received(0) {}
+    int received;
+
+public Q_SLOTS:
+    void submit(KQOAuthRequest *request, const QVariant &userData);
+};
+
+// Collects the latencies of a burst of requests sent with the send time as user data.
+class BurstReceiver : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BurstReceiver(QElapsedTimer *clock) : clock(clock) {}
+    QList<qint64> latencies;
+
+Q_SIGNALS:
+    void received();
+
+public Q_SLOTS:
+    void onReply(KQOAuthManager::KQOAuthReply reply);
+
+private:
+    QElapsedTimer *clock;
+};
+
+// Local HTTP/1.1 stand-in for a service: answers every request with "ok=1" over
+// keep-alive connections, in a thread of its own so it does not share the event loop
+// of the clients.
+class HttpStandIn : public QTcpServer
+{
+    Q_OBJECT
+public:
+    // Counts the connections it accepts in 'acceptedConnections', if given.
+    explicit HttpStandIn(QAtomicInt *acceptedConnections = 0);
+
+private Q_SLOTS:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+
+private:
+    QHash<QTcpSocket *, QByteArray> buffers;
+    QAtomicInt *acceptedConnections;
+};
+
+class HttpStandInThread : public QThread
+{
+    Q_OBJECT
+public:
+    HttpStandInThread() : port(0), accepted(0) {}
+    // Starts the thread and returns once the stand-in listens.
+    quint16 startListening();
+    // Connections accepted so far, that is TCP handshakes the clients made.
+    int acceptedConnections();
+
+protected:
+    void run();
+
+private:
+    quint16 port;
+    QSemaphore listening;
+    QAtomicInt accepted;
+};
+
+// Keeps 'inFlight' requests running until a number of them are answered, either through
+// KQOAuthManager or with QNetworkAccessManager and a request signed beforehand, which is
+// what the manager sends on the wire.
+class OverheadDriver : public QObject
+{
+    Q_OBJECT
+public:
+    OverheadDriver(const QUrl &url, bool useManager, int inFlight);
+    ~OverheadDriver();
+
+    // Returns once 'total' requests are answered.
+    void run(int total);
+
+    QList<qint64> latencies;    // Microseconds.
+    int failed;
+
+private Q_SLOTS:
+    void onManagerReply(KQOAuthManager::KQOAuthReply reply);
+    void onNetworkReply();
+
+private:
+    void send(int slot);
+    void complete(int slot, bool ok);
+
+    QUrl url;
+    bool useManager;
+    int inFlight;
+
+    KQOAuthManager manager;
+    QList<KQOAuthRequest *> requests;   // One per slot for the manager.
+    QNetworkAccessManager network;
+    QNetworkRequest signedRequest;
+    QByteArray body;
+
+    QVector<qint64> sendTimes;
+    QElapsedTimer clock;
+    int total;
+    int sent;
+    int completed;
+};
+
+class Bench_KQOAuth : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void bench_submissionQueue_data();
+    void bench_submissionQueue();
+    void bench_queuedInvocation_data();
+    void bench_queuedInvocation();
+
+    void bench_managerCreation();
+    void bench_managerMemory();
+
+    void bench_http2Burst_data();
+    void bench_http2Burst();
+
+    void bench_managerLoopback();
+
+    void bench_sharedNetworkManager_data();
+    void bench_sharedNetworkManager();
+
+    void bench_firstByte_data();
+    void bench_firstByte();
+
+    void bench_managerOverhead_data();
+    void bench_managerOverhead();
+
+    void bench_hmacSha1_data();
+    void bench_hmacSha1();
+    void bench_percentEncoding_data();
+    void bench_percentEncoding();
+    void bench_requestBaseString_data();
+    void bench_requestBaseString();
+    void bench_requestParameters_data();
+    void bench_requestParameters();
+    void bench_requestBody_data();
+    void bench_requestBody();
+    void bench_createTokensFromResponse_data();
+    void bench_createTokensFromResponse();
+    void bench_callbackQueryParsing_data();
+    void bench_callbackQueryParsing();
+
+private:
+    void addProducerRows();
+    void addParameterCountRows();
+    void addPayloadSizeRows();
+};
+
+#endif // BENCH_KQOAUTH_H
@@ -0,0 +1,139 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@d-pointer.com)
+ *         http://www.d-pointer.com
+ *
+ *  KQOAuth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QFile>
+#include <QtAlgorithms>
+#include <QtDebug>
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+#include "loadgen.h"
+
+namespace
+{
+    // Resident set size of the process in bytes, 0 if unknown.
+    qint64 residentSetSize() {
+#ifdef Q_OS_LINUX
+        QFile statm("/proc/self/statm");
+        if (statm.open(QIODevice::ReadOnly)) {
+            QList<QByteArray> fields = statm.readAll().split(' ');
+            if (fields.size() > 1) {
+                return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+            }
+        }
+#endif
+        return 0;
+    }
+
+    double milliseconds(qint64 microseconds) {
+        return microseconds / 1000.0;
+    }
+}
+
+LoadGenerator::LoadGenerator(KQOAuthManager *manager, const QUrl &url,
+                             KQOAuthRequest::RequestHttpMethod method,
+                             const Credentials &credentials, int concurrency, int total) :
+    manager(manager),
+    url(url),
+    method(method),
+    credentials(credentials),
+    concurrency(qMax(1, qMin(concurrency, total))),
+    total(total),
+    sent(0),
+    completed(0),
+    failed(0),
+    baselineMemory(0),
+    loadedMemory(0)
+{
+    for (int i = 0; i < this->concurrency; i++) {
+        requests.append(new KQOAuthRequest);
+    }
+    sendTimes.resize(this->concurrency);
+    latencies.reserve(total);
+
+    connect(manager, SIGNAL(replyReceived(KQOAuthManager::KQOAuthReply)),
+            this, SLOT(onReply(KQOAuthManager::KQOAuthReply)));
+}
+
+LoadGenerator::~LoadGenerator() {
+    qDeleteAll(requests);
+}
+
+void LoadGenerator::start() {
+    baselineMemory = residentSetSize();
+    clock.start();
+
+    for (int slot = 0; slot < concurrency; slot++) {
+        send(slot);
+    }
+
+    // Everything is in flight now, and nothing has been answered yet.
+    loadedMemory = residentSetSize();
+}
+
+void LoadGenerator::send(int slot) {
+    KQOAuthRequest *request = requests.at(slot);
+    request->initRequest(KQOAuthRequest::AuthorizedRequest, url);
+    request->setHttpMethod(method);
+    request->setConsumerKey(credentials.consumerKey);
+    request->setConsumerSecretKey(credentials.consumerSecret);
+    request->setToken(credentials.token);
+    request->setTokenSecret(credentials.tokenSecret);
+
+    KQOAuthParameters parameters;
+    parameters.insert("sequence", QString::number(sent));
+    request->setAdditionalParameters(parameters);
+
+    sendTimes[slot] = clock.nsecsElapsed() / 1000;
+    sent++;
+    manager->executeRequest(request, slot);
+}
+
+void LoadGenerator::onReply(KQOAuthManager::KQOAuthReply reply) {
+    int slot = reply.userData.toInt();
+    latencies.append(clock.nsecsElapsed() / 1000 - sendTimes.at(slot));
+    if (reply.error != KQOAuthManager::NoError || reply.statusCode != 200) {
+        failed++;
+    }
+    completed++;
+
+    if (sent < total) {
+        send(slot);
+    } else if (completed == total) {
+        report();
+        emit done();
+    }
+}
+
+void LoadGenerator::report() {
+    double seconds = clock.nsecsElapsed() / 1e9;
+    qSort(latencies);
+
+    qDebug("requests:     %d (%d failed)", completed, failed);
+    qDebug("concurrency:  %d", concurrency);
+    qDebug("throughput:   %.0f requests/s", completed / seconds);
+    qDebug("latency p50:  %.2f ms", milliseconds(latencies.at(latencies.size() / 2)));
+    qDebug("latency p99:  %.2f ms", milliseconds(latencies.at(latencies.size() * 99 / 100)));
+    if (baselineMemory > 0) {
+        qDebug("memory:       %lld bytes per request in flight",
+               (loadedMemory - baselineMemory) / concurrency);
+    }
+}
@@ -0,0 +1,83 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@d-pointer.com)
+ *         http://www.d-pointer.com
+ *
+ *  KQOAuth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QUrl>
+#include <QVector>
+
+#include "kqoauthmanager.h"
+#include "kqoauthrequest.h"
+
+/**
+ * Keeps 'concurrency' signed requests in flight on one KQOAuthManager until 'total' requests
+ * have been answered, then prints the requests per second, the latency percentiles and
+ * the memory taken per request in flight.
+ */
+class LoadGenerator : public QObject
+{
+    Q_OBJECT
+public:
+    struct Credentials
+    {
+        QString consumerKey;
+        QString consumerSecret;
+        QString token;
+        QString tokenSecret;
+    };
+
+    LoadGenerator(KQOAuthManager *manager, const QUrl &url, KQOAuthRequest::RequestHttpMethod method,
+                  const Credentials &credentials, int concurrency, int total);
+    ~LoadGenerator();
+
+    void start();
+
+Q_SIGNALS:
+    void done();
+
+private Q_SLOTS:
+    void onReply(KQOAuthManager::KQOAuthReply reply);
+
+private:
+    void send(int slot);
+    void report();
+
+    KQOAuthManager *manager;
+    QUrl url;
+    KQOAuthRequest::RequestHttpMethod method;
+    Credentials credentials;
+    int concurrency;
+    int total;
+
+    QList<KQOAuthRequest *> requests;       // One per slot, reused once its reply is in.
+    QVector<qint64> sendTimes;              // Microseconds, per slot.
+    QVector<qint64> latencies;              // Microseconds.
+    QElapsedTimer clock;
+    int sent;
+    int completed;
+    int failed;
+    qint64 baselineMemory;
+    qint64 loadedMemory;
+};
+
+#endif // LOADGEN_H
@@ -0,0 +1,75 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@d-pointer.com)
+ *         http://www.d-pointer.com
+ *
+ *  KQOAuth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QCoreApplication>
+#include <QStringList>
+#include <QtDebug>
+
+#include "loadgen.h"
+
+namespace
+{
+    QString option(const QStringList &arguments, const QString &name, const QString &defaultValue) {
+        int index = arguments.indexOf(name);
+        if (index < 0 || index + 1 >= arguments.size()) {
+            return defaultValue;
+        }
+        return arguments.at(index + 1);
+    }
+}
+
+// Run against tests/mockprovider:
+// loadgen [--url http://127.0.0.1:8080/api/resource] [--concurrency 100] [--requests 10000]
+//         [--backend nam|lean] [--method post|get]
+//         [--consumer-key consumer] [--consumer-secret consumerSecret]
+//         [--token token] [--token-secret tokenSecret]
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QStringList arguments = app.arguments();
+
+    QUrl url(option(arguments, "--url", "http://127.0.0.1:8080/api/resource"));
+    int concurrency = option(arguments, "--concurrency", "100").toInt();
+    int total = option(arguments, "--requests", "10000").toInt();
+    if (!url.isValid() || concurrency <= 0 || total <= 0) {
+        qWarning() << "Invalid arguments.";
+        return 1;
+    }
+
+    LoadGenerator::Credentials credentials;
+    credentials.consumerKey = option(arguments, "--consumer-key", "consumer");
+    credentials.consumerSecret = option(arguments, "--consumer-secret", "consumerSecret");
+    credentials.token = option(arguments, "--token", "token");
+    credentials.tokenSecret = option(arguments, "--token-secret", "tokenSecret");
+
+    KQOAuthManager manager;
+    if (option(arguments, "--backend", "nam") == "lean") {
+        manager.setHttpBackend(KQOAuthManager::LeanHttpBackend);
+    }
+
+    KQOAuthRequest::RequestHttpMethod method = KQOAuthRequest::POST;
+    if (option(arguments, "--method", "post") == "get") {
+        method = KQOAuthRequest::GET;
+    }
+
+    LoadGenerator generator(&manager, url, method, credentials, concurrency, total);
+    QObject::connect(&generator, SIGNAL(done()), &app, SLOT(quit()));
+    generator.start();
+
+    return app.exec();
+}
@@ -0,0 +1,57 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@d-pointer.com)
+ *         http://www.d-pointer.com
+ *
+ *  KQOAuth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QCoreApplication>
+#include <QHostAddress>
+#include <QStringList>
+#include <QtDebug>
+
+#include "mockprovider.h"
+
+namespace
+{
+    QString option(const QStringList &arguments, const QString &name, const QString &defaultValue) {
+        int index = arguments.indexOf(name);
+        if (index < 0 || index + 1 >= arguments.size()) {
+            return defaultValue;
+        }
+        return arguments.at(index + 1);
+    }
+}
+
+// mockprovider [--port 8080] [--consumer-key consumer] [--consumer-secret consumerSecret]
+//              [--token token] [--token-secret tokenSecret]
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QStringList arguments = app.arguments();
+
+    MockProvider provider(option(arguments, "--consumer-key", "consumer"),
+                          option(arguments, "--consumer-secret", "consumerSecret"));
+    provider.addAccessToken(option(arguments, "--token", "token"),
+                            option(arguments, "--token-secret", "tokenSecret"));
+
+    quint16 port = option(arguments, "--port", "8080").toUShort();
+    if (!provider.listen(QHostAddress::LocalHost, port)) {
+        qWarning() << "Cannot listen on port" << port << ":" << provider.errorString();
+        return 1;
+    }
+
+    qDebug() << "Mock OAuth provider at" << QString("http://127.0.0.1:%1/").arg(provider.serverPort());
+    return app.exec();
+}
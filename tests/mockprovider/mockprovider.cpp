@@ -0,0 +1,266 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@d-pointer.com)
+ *         http://www.d-pointer.com
+ *
+ *  KQOAuth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QStringList>
+#include <QTcpSocket>
+#include <QUrl>
+#include <QUuid>
+#include <QtDebug>
+
+#include "mockprovider.h"
+#include <kqoauthformparser.h>
+
+namespace
+{
+    QByteArray encode(const QString &value) {
+        return QUrl::toPercentEncoding(value);
+    }
+}
+
+MockProvider::MockProvider(const QString &consumerKey, const QString &consumerSecret, QObject *parent) :
+    QTcpServer(parent),
+    consumerKey(consumerKey),
+    consumerSecret(consumerSecret),
+    requests(0),
+    rejected(0)
+{
+    connect(this, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+}
+
+void MockProvider::addAccessToken(const QString &token, const QString &tokenSecret) {
+    accessTokens.insert(token, tokenSecret);
+}
+
+void MockProvider::onNewConnection() {
+    while (hasPendingConnections()) {
+        QTcpSocket *socket = nextPendingConnection();
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        buffers.insert(socket, QByteArray());
+
+        connect(socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+    }
+}
+
+void MockProvider::onReadyRead() {
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if (socket == 0 || !buffers.contains(socket)) {
+        return;
+    }
+
+    QByteArray &buffer = buffers[socket];
+    buffer.append(socket->readAll());
+
+    // Pipelined requests are answered in order.
+    HttpRequest request;
+    bool malformed = false;
+    while (takeRequest(buffer, &request, &malformed)) {
+        requests++;
+        socket->write(handle(request));
+        if (!request.keepAlive) {
+            socket->disconnectFromHost();
+            return;
+        }
+    }
+
+    if (malformed) {
+        socket->write(response(400, "Bad request", false));
+        socket->disconnectFromHost();
+    }
+}
+
+void MockProvider::onDisconnected() {
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if (socket == 0) {
+        return;
+    }
+
+    buffers.remove(socket);
+    socket->deleteLater();
+}
+
+bool MockProvider::takeRequest(QByteArray &buffer, HttpRequest *request, bool *malformed) {
+    int headEnd = buffer.indexOf("\r\n\r\n");
+    if (headEnd < 0) {
+        return false;
+    }
+
+    QList<QByteArray> lines = buffer.left(headEnd).split('\n');
+    QList<QByteArray> requestLine = lines.takeFirst().trimmed().split(' ');
+    if (requestLine.size() != 3 || !requestLine.at(2).startsWith("HTTP/1.")) {
+        *malformed = true;
+        return false;
+    }
+
+    request->method = requestLine.at(0);
+    QByteArray target = requestLine.at(1);
+    int question = target.indexOf('?');
+    request->path = target.left(question);
+    request->query = question < 0 ? QByteArray() : target.mid(question + 1);
+
+    request->headers.clear();
+    foreach (const QByteArray &line, lines) {
+        int colon = line.indexOf(':');
+        if (colon > 0) {
+            request->headers.insert(line.left(colon).trimmed().toLower(), line.mid(colon + 1).trimmed());
+        }
+    }
+
+    QByteArray connection = request->headers.value("connection").toLower();
+    request->keepAlive = requestLine.at(2) == "HTTP/1.1" ? !connection.contains("close")
+                                                          : connection.contains("keep-alive");
+
+    int length = request->headers.value("content-length", "0").toInt();
+    if (buffer.size() < headEnd + 4 + length) {
+        return false;
+    }
+
+    request->body = buffer.mid(headEnd + 4, length);
+    buffer.remove(0, headEnd + 4 + length);
+    return true;
+}
+
+QByteArray MockProvider::handle(const HttpRequest &request) {
+    QMultiMap<QString, QString> oauth;
+    QByteArray problem;
+
+    if (request.path == "/oauth/request_token") {
+        problem = verify(request, 0, &oauth);
+        if (problem.isEmpty() && !oauth.contains("oauth_callback")) {
+            problem = "parameter_absent";
+        }
+        if (problem.isEmpty()) {
+            QString token = newToken();
+            QString secret = newToken();
+            temporaryTokens.insert(token, secret);
+            callbacks.insert(token, oauth.value("oauth_callback"));
+            return response(200, "oauth_token=" + encode(token) + "&oauth_token_secret=" + encode(secret)
+                                 + "&oauth_callback_confirmed=true", request.keepAlive);
+        }
+
+    } else if (request.path == "/oauth/authorize") {
+        // No user here, so every known token is authorized right away.
+        QString token = KQOAuthFormParser::parseToMap(request.query).value("oauth_token");
+        if (!temporaryTokens.contains(token)) {
+            return response(404, "Unknown token", request.keepAlive);
+        }
+
+        QString verifier = newToken();
+        verifiers.insert(token, verifier);
+
+        QString callback = callbacks.value(token);
+        QByteArray result = "oauth_token=" + encode(token) + "&oauth_verifier=" + encode(verifier);
+        if (callback == "oob") {
+            return response(200, result, request.keepAlive);
+        }
+        QByteArray location = callback.toUtf8() + (callback.contains('?') ? '&' : '?') + result;
+        return response(302, QByteArray(), request.keepAlive, "Location: " + location + "\r\n");
+
+    } else if (request.path == "/oauth/access_token") {
+        problem = verify(request, &temporaryTokens, &oauth);
+        QString token = oauth.value("oauth_token");
+        if (problem.isEmpty() && (!verifiers.contains(token)
+                                  || verifiers.value(token) != oauth.value("oauth_verifier"))) {
+            problem = "permission_denied";
+        }
+        if (problem.isEmpty()) {
+            temporaryTokens.remove(token);
+            callbacks.remove(token);
+            verifiers.remove(token);
+
+            QString accessToken = newToken();
+            QString secret = newToken();
+            accessTokens.insert(accessToken, secret);
+            return response(200, "oauth_token=" + encode(accessToken) + "&oauth_token_secret=" + encode(secret),
+                            request.keepAlive);
+        }
+
+    } else {
+        problem = verify(request, &accessTokens, &oauth);
+        if (problem.isEmpty()) {
+            return response(200, "ok=1", request.keepAlive);
+        }
+    }
+
+    rejected++;
+    return response(401, "oauth_problem=" + problem, request.keepAlive);
+}
+
+QByteArray MockProvider::verify(const HttpRequest &request, const QHash<QString, QString> *tokenSecrets,
+                                QMultiMap<QString, QString> *oauthParameters) {
+    KQOAuthParameters oauth = KQOAuthVerifier::parseAuthorizationHeader(request.headers.value("authorization"));
+    *oauthParameters = oauth;
+
+    if (oauth.value("oauth_consumer_key") != consumerKey) {
+        return "consumer_key_unknown";
+    }
+
+    QString tokenSecret;
+    if (tokenSecrets) {
+        QString token = oauth.value("oauth_token");
+        if (!tokenSecrets->contains(token)) {
+            return "token_rejected";
+        }
+        tokenSecret = tokenSecrets->value(token);
+    } else if (oauth.contains("oauth_token")) {
+        return "token_rejected";
+    }
+
+    KQOAuthParameters formParameters;
+    if (request.headers.value("content-type").startsWith("application/x-www-form-urlencoded")) {
+        formParameters = KQOAuthFormParser::parseToMap(request.body);
+    }
+
+    QByteArray target = request.path;
+    if (!request.query.isEmpty()) {
+        target += '?' + request.query;
+    }
+    QUrl url = QUrl::fromEncoded("http://" + request.headers.value("host") + target);
+
+    return KQOAuthVerifier::problem(verifier.verify(request.method, url, oauth, consumerSecret, tokenSecret,
+                                                    formParameters));
+}
+
+QByteArray MockProvider::response(int statusCode, const QByteArray &body, bool keepAlive,
+                                  const QByteArray &extraHeaders) {
+    QByteArray reason = "OK";
+    switch (statusCode) {
+    case 302: reason = "Found"; break;
+    case 400: reason = "Bad Request"; break;
+    case 401: reason = "Unauthorized"; break;
+    case 404: reason = "Not Found"; break;
+    default: break;
+    }
+
+    QByteArray result;
+    result.reserve(128 + extraHeaders.size() + body.size());
+    result.append("HTTP/1.1 " + QByteArray::number(statusCode) + ' ' + reason + "\r\n");
+    result.append("Content-Type: application/x-www-form-urlencoded\r\n");
+    result.append("Content-Length: " + QByteArray::number(body.size()) + "\r\n");
+    result.append(keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n");
+    result.append(extraHeaders);
+    result.append("\r\n");
+    result.append(body);
+    return result;
+}
+
+QString MockProvider::newToken() {
+    QString uuid = QUuid::createUuid().toString();
+    return uuid.mid(1, uuid.size() - 2).remove('-');
+}
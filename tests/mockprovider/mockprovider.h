@@ -0,0 +1,98 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@d-pointer.com)
+ *         http://www.d-pointer.com
+ *
+ *  KQOAuth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MOCKPROVIDER_H
+#define MOCKPROVIDER_H
+
+#include <QHash>
+#include <QMultiMap>
+#include <QTcpServer>
+
+#include <kqoauthverifier.h>
+
+class QTcpSocket;
+
+/**
+ * OAuth 1.0a service provider for offline tests and load generation. Serves
+ *
+ *   POST /oauth/request_token   temporary credentials
+ *   GET  /oauth/authorize       authorizes a temporary token right away and redirects
+ *                               to its callback with the verifier
+ *   POST /oauth/access_token    token credentials
+ *   any other path              a protected resource, answering "ok=1"
+ *
+ * over HTTP/1.1 with keep-alive. Every signed request is checked like a real provider
+ * would: consumer key, token, verifier, and with KQOAuthVerifier the signature, timestamp
+ * and nonce. Failures get a 401
+ * with an oauth_problem.
+ */
+class MockProvider : public QTcpServer
+{
+    Q_OBJECT
+public:
+    MockProvider(const QString &consumerKey, const QString &consumerSecret, QObject *parent = 0);
+
+    // Access token that the protected resources accept without the three-legged flow.
+    void addAccessToken(const QString &token, const QString &tokenSecret);
+
+    int requestCount() const { return requests; }
+    int rejectedCount() const { return rejected; }
+
+private Q_SLOTS:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+
+private:
+    struct HttpRequest
+    {
+        QByteArray method;
+        QByteArray path;
+        QByteArray query;
+        QByteArray body;
+        QHash<QByteArray, QByteArray> headers;     // Names in lower case.
+        bool keepAlive;
+    };
+
+    bool takeRequest(QByteArray &buffer, HttpRequest *request, bool *malformed);
+    QByteArray handle(const HttpRequest &request);
+    // Returns the oauth_problem, empty if the request is fine. Without 'tokenSecrets' the request
+    // must not carry a token.
+    QByteArray verify(const HttpRequest &request, const QHash<QString, QString> *tokenSecrets,
+                      QMultiMap<QString, QString> *oauthParameters);
+
+    static QByteArray response(int statusCode, const QByteArray &body, bool keepAlive,
+                               const QByteArray &extraHeaders = QByteArray());
+    static QString newToken();
+
+    QString consumerKey;
+    QString consumerSecret;
+    QHash<QTcpSocket *, QByteArray> buffers;
+    KQOAuthVerifier verifier;
+
+    QHash<QString, QString> temporaryTokens;    // Token to secret.
+    QHash<QString, QString> callbacks;          // Temporary token to callback URL.
+    QHash<QString, QString> verifiers;          // Authorized temporary token to verifier.
+    QHash<QString, QString> accessTokens;       // Token to secret.
+
+    int requests;
+    int rejected;
+};
+
+#endif // MOCKPROVIDER_H
@@ -0,0 +1,22 @@
+TARGET = mockprovider
+TEMPLATE = app
+
+QT += network
+QT -= gui
+CONFIG += console
+
+macx {
+    CONFIG -= app_bundle
+    LIBS += -F../../lib -framework kqoauth
+}
+else:unix {
+  LIBS += -L../../lib -lkqoauth
+}
+else:windows {
+  LIBS += -L../../lib -lkqoauthd0
+}
+
+INCLUDEPATH += . ../../src
+HEADERS += mockprovider.h
+SOURCES += mockprovider.cpp \
+           main.cpp
@@ -0,0 +1,125 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@d-pointer.com)
+ *         http://www.d-pointer.com
+ *
+ *  KQOAuth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QStringList>
+#include <QtAlgorithms>
+#include <QtDebug>
+
+#include <stdio.h>
+#ifdef Q_OS_LINUX
+#  include <unistd.h>
+#endif
+
+#include "kqoauthmanager.h"
+#include "kqoauthrequest.h"
+#ifdef STARTUP_PROBE_GUI
+#  include "kqoauthgui.h"
+#endif
+
+namespace
+{
+    // Resident set size of the process in bytes, 0 if unknown.
+    qint64 residentSetSize() {
+#ifdef Q_OS_LINUX
+        QFile statm("/proc/self/statm");
+        if (statm.open(QIODevice::ReadOnly)) {
+            QList<QByteArray> fields = statm.readAll().split(' ');
+            if (fields.size() > 1) {
+                return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+            }
+        }
+#endif
+        return 0;
+    }
+
+    // What an application does before it gets to its event loop: set up a manager and
+    // sign the first request. Prints the resident set size afterwards.
+    int startUp() {
+#ifdef STARTUP_PROBE_GUI
+        KQOAuthGui::install();
+#endif
+        KQOAuthManager manager;
+        KQOAuthRequest request;
+        request.initRequest(KQOAuthRequest::AuthorizedRequest, QUrl("https://api.example.com/1/statuses/update.json"));
+        request.setConsumerKey("consumer");
+        request.setConsumerSecretKey("consumerSecret");
+        request.setToken("token");
+        request.setTokenSecret("tokenSecret");
+        if (request.requestParameters().isEmpty()) {
+            return 1;
+        }
+
+        // Read by the parent process from our standard output.
+        printf("rss %lld\n", static_cast<long long>(residentSetSize()));
+        return 0;
+    }
+}
+
+// startupprobe_core and startupprobe_gui are the same program, linked against the core
+// library only and together with kqoauthgui. Run as
+//   startupprobe_core --runs 50
+// it starts itself that many times and prints the median and p90 wall clock time from
+// process start to exit, and the resident set size after start-up.
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QStringList arguments = app.arguments();
+
+    int runsIndex = arguments.indexOf("--runs");
+    if (runsIndex < 0) {
+        return startUp();
+    }
+
+    int runs = arguments.value(runsIndex + 1).toInt();
+    if (runs <= 0) {
+        qWarning() << "Invalid arguments.";
+        return 1;
+    }
+
+    QList<qint64> startupTimes;
+    qint64 rss = 0;
+    for (int i = 0; i < runs; i++) {
+        QProcess probe;
+        QElapsedTimer clock;
+        clock.start();
+        probe.start(app.applicationFilePath(), QStringList());
+        if (!probe.waitForFinished(30000) || probe.exitCode() != 0) {
+            qWarning() << "The probe did not start up.";
+            return 1;
+        }
+        startupTimes.append(clock.nsecsElapsed() / 1000);
+
+        QByteArray output = probe.readAllStandardOutput().trimmed();
+        if (output.startsWith("rss ")) {
+            rss = output.mid(4).toLongLong();
+        }
+    }
+
+    qSort(startupTimes);
+    qDebug("%s: %d runs", qPrintable(QFileInfo(app.applicationFilePath()).fileName()), runs);
+    qDebug("startup p50:  %.2f ms", startupTimes.at(runs / 2) / 1000.0);
+    qDebug("startup p90:  %.2f ms", startupTimes.at(runs * 9 / 10) / 1000.0);
+    qDebug("rss:          %lld KiB", static_cast<long long>(rss / 1024));
+
+    return 0;
+}
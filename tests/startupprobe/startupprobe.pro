@@ -0,0 +1,4 @@
+TEMPLATE = subdirs
+
+# The same probe, linked against the core library only and together with kqoauthgui.
+SUBDIRS += startupprobe_core.pro startupprobe_gui.pro
@@ -0,0 +1,23 @@
+TARGET = startupprobe_core
+TEMPLATE = app
+
+QT += network
+QT -= gui
+CONFIG += console
+
+OBJECTS_DIR = tmp_core
+MOC_DIR = tmp_core
+
+macx {
+    CONFIG -= app_bundle
+    LIBS += -F../../lib -framework kqoauth
+}
+else:unix {
+  LIBS += -L../../lib -lkqoauth
+}
+else:windows {
+  LIBS += -L../../lib -lkqoauthd0
+}
+
+INCLUDEPATH += . ../../src
+SOURCES += main.cpp
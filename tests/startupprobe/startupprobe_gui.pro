@@ -0,0 +1,24 @@
+TARGET = startupprobe_gui
+TEMPLATE = app
+
+DEFINES += STARTUP_PROBE_GUI
+
+QT += gui network
+CONFIG += console
+
+OBJECTS_DIR = tmp_gui
+MOC_DIR = tmp_gui
+
+macx {
+    CONFIG -= app_bundle
+    LIBS += -F../../lib -framework kqoauth -L../../lib -lkqoauthgui
+}
+else:unix {
+  LIBS += -L../../lib -lkqoauthgui -lkqoauth
+}
+else:windows {
+  LIBS += -L../../lib -lkqoauthd0 -lkqoauthguid0
+}
+
+INCLUDEPATH += . ../../src ../../gui
+SOURCES += main.cpp
@@ -0,0 +1,126 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@d-pointer.com)
+ *         http://www.d-pointer.com
+ *
+ *  KQOAuth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+
+#include "allocationcounter.h"
+
+#if defined(__GLIBC__)
+
+extern "C" {
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *pointer, size_t size);
+    void __libc_free(void *pointer);
+}
+
+namespace
+{
+    // Per thread, so the threads of Qt do not disturb the counts.
+    __thread bool counting = false;
+    __thread qint64 allocationCount = 0;
+    __thread qint64 byteCount = 0;
+    __thread qint64 freeCount = 0;
+}
+
+// These take the place of the allocator functions of the C library for the whole process.
+extern "C" void *malloc(size_t size) __THROW {
+    if (counting) {
+        allocationCount++;
+        byteCount += size;
+    }
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) __THROW {
+    if (counting) {
+        allocationCount++;
+        byteCount += count * size;
+    }
+    return __libc_calloc(count, size);
+}
+
+// A realloc() is counted as an allocation of the new size, since it usually moves the block.
+extern "C" void *realloc(void *pointer, size_t size) __THROW {
+    if (counting) {
+        allocationCount++;
+        byteCount += size;
+    }
+    return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void *pointer) __THROW {
+    if (counting && pointer) {
+        freeCount++;
+    }
+    __libc_free(pointer);
+}
+
+bool AllocationCounter::isAvailable() {
+    return true;
+}
+
+void AllocationCounter::start() {
+    allocationCount = 0;
+    byteCount = 0;
+    freeCount = 0;
+    counting = true;
+}
+
+void AllocationCounter::stop() {
+    counting = false;
+}
+
+qint64 AllocationCounter::allocations() {
+    return allocationCount;
+}
+
+qint64 AllocationCounter::bytes() {
+    return byteCount;
+}
+
+qint64 AllocationCounter::frees() {
+    return freeCount;
+}
+
+#else
+
+bool AllocationCounter::isAvailable() {
+    return false;
+}
+
+void AllocationCounter::start() {
+}
+
+void AllocationCounter::stop() {
+}
+
+qint64 AllocationCounter::allocations() {
+    return 0;
+}
+
+qint64 AllocationCounter::bytes() {
+    return 0;
+}
+
+qint64 AllocationCounter::frees() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,45 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@d-pointer.com)
+ *         http://www.d-pointer.com
+ *
+ *  KQOAuth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+/**
+ * Counts the heap allocations the calling thread makes between start() and stop().
+ * malloc(), calloc(), realloc() and free() of the whole process are replaced by
+ * counting versions, so the allocations of Qt and libkqoauth are seen as well as
+ * those of operator new. Only available with glibc.
+ */
+class AllocationCounter
+{
+public:
+    static bool isAvailable();
+
+    // Resets the counts.
+    static void start();
+    static void stop();
+
+    static qint64 allocations();
+    static qint64 bytes();
+    static qint64 frees();
+};
+
+#endif // ALLOCATIONCOUNTER_H
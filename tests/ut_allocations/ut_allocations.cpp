@@ -0,0 +1,248 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@d-pointer.com)
+ *         http://www.d-pointer.com
+ *
+ *  KQOAuth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ut_allocations.h"
+
+// Qt includes
+#include <QtDebug>
+#include <QTest>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStringList>
+#include <QtAlgorithms>
+
+// Project includes
+#include "kqoauthrequest.h"
+#include "kqoauthmanager.h"
+#include <kqoauthloopbacktransport.h>
+
+#include "allocationcounter.h"
+
+namespace
+{
+    // The budgets per signed request are in budgets.txt. With KQOAUTH_RECORD_BUDGETS set
+    // the measurements are written there instead, plus this margin in percent. The
+    // measured numbers are printed on every run.
+    const int recordingMargin = 10;
+
+    // The first requests fill caches and create objects on demand.
+    const int warmUpRounds = 10;
+    const int measuredRounds = 100;
+
+    void setUpRequest(KQOAuthRequest *request) {
+        request->initRequest(KQOAuthRequest::AuthorizedRequest,
+                             QUrl("https://api.example.com/1/statuses/update.json"));
+        request->setHttpMethod(KQOAuthRequest::POST);
+        request->setConsumerKey("consumer");
+        request->setConsumerSecretKey("consumerSecret");
+        request->setToken("token");
+        request->setTokenSecret("tokenSecret");
+
+        KQOAuthParameters parameters;
+        parameters.insert("status", "setting up my twitter");
+        request->setAdditionalParameters(parameters);
+    }
+
+    struct Usage
+    {
+        Usage() : allocations(0), bytes(0), frees(0) {}
+
+        void add() {
+            allocations += AllocationCounter::allocations();
+            bytes += AllocationCounter::bytes();
+            frees += AllocationCounter::frees();
+        }
+
+        qint64 allocations;
+        qint64 bytes;
+        qint64 frees;
+    };
+
+    QByteArray describe(const char *name, const Usage &usage) {
+        return QString("%1: %2 allocations, %3 bytes, %4 frees per request")
+               .arg(name)
+               .arg(usage.allocations / double(measuredRounds), 0, 'f', 1)
+               .arg(usage.bytes / measuredRounds)
+               .arg(usage.frees / double(measuredRounds), 0, 'f', 1)
+               .toLatin1();
+    }
+
+    // Lines of 'name value'; '#' starts a comment.
+    QHash<QByteArray, qint64> readBudgets(QFile &file) {
+        QHash<QByteArray, qint64> budgets;
+        while (!file.atEnd()) {
+            QByteArray line = file.readLine().trimmed();
+            if (line.isEmpty() || line.startsWith('#')) {
+                continue;
+            }
+
+            QList<QByteArray> fields = line.simplified().split(' ');
+            bool ok = false;
+            qint64 value = fields.size() == 2 ? fields.at(1).toLongLong(&ok) : 0;
+            if (ok) {
+                budgets.insert(fields.at(0), value);
+            } else {
+                qWarning() << "Ignoring budget line" << line;
+            }
+        }
+        return budgets;
+    }
+}
+
+void ReplyCounter::onReply(KQOAuthManager::KQOAuthReply reply) {
+    Q_UNUSED(reply)
+    received++;
+}
+
+void Ut_Allocations::initTestCase() {
+    if (!AllocationCounter::isAvailable()) {
+#if QT_VERSION >= 0x050000
+        QSKIP("Allocations can only be counted with glibc.");
+#else
+        QSKIP("Allocations can only be counted with glibc.", SkipAll);
+#endif
+    }
+
+    recording = !qgetenv("KQOAUTH_RECORD_BUDGETS").isEmpty();
+    if (recording) {
+        return;
+    }
+
+    QFile file(BUDGETS_FILE);
+    QVERIFY2(file.open(QIODevice::ReadOnly), "Cannot read " BUDGETS_FILE);
+    budgets = readBudgets(file);
+}
+
+void Ut_Allocations::cleanupTestCase() {
+    if (!recording || recorded.isEmpty()) {
+        return;
+    }
+
+    QFile file(BUDGETS_FILE);
+    QByteArray header;
+    if (file.open(QIODevice::ReadOnly)) {
+        // Keep the explanation at the top, but not the note that nothing was recorded yet.
+        while (!file.atEnd()) {
+            QByteArray line = file.readLine();
+            if (!line.startsWith('#') || line.contains("Not recorded")) {
+                break;
+            }
+            header += line;
+        }
+        file.close();
+    }
+
+    QList<QByteArray> names = recorded.keys();
+    qSort(names);
+
+    QVERIFY2(file.open(QIODevice::WriteOnly | QIODevice::Truncate), "Cannot write " BUDGETS_FILE);
+    file.write(header);
+    foreach (const QByteArray &name, names) {
+        file.write(name + ' ' + QByteArray::number(recorded.value(name)) + '\n');
+    }
+    qDebug() << "Recorded the budgets to" << BUDGETS_FILE;
+}
+
+void Ut_Allocations::check(const char *name, qint64 allocations, qint64 bytes, const QByteArray &description) {
+    QByteArray allocationsKey = QByteArray(name) + ".allocations";
+    QByteArray bytesKey = QByteArray(name) + ".bytes";
+
+    // Per request, rounded up.
+    allocations = (allocations + measuredRounds - 1) / measuredRounds;
+    bytes = (bytes + measuredRounds - 1) / measuredRounds;
+
+    if (recording) {
+        recorded.insert(allocationsKey, allocations + (allocations * recordingMargin + 99) / 100);
+        recorded.insert(bytesKey, bytes + (bytes * recordingMargin + 99) / 100);
+        return;
+    }
+
+    QVERIFY2(budgets.contains(allocationsKey) && budgets.contains(bytesKey),
+             QByteArray("No budget for " + QByteArray(name) + " in " BUDGETS_FILE).constData());
+    QByteArray message = description + QByteArray(", budgets ")
+                       + QByteArray::number(budgets.value(allocationsKey)) + " allocations, "
+                       + QByteArray::number(budgets.value(bytesKey)) + " bytes";
+    QVERIFY2(allocations <= budgets.value(allocationsKey), message.constData());
+    QVERIFY2(bytes <= budgets.value(bytesKey), message.constData());
+}
+
+void Ut_Allocations::ut_requestParameters() {
+    KQOAuthRequest request;
+    Usage usage;
+
+    for (int i = 0; i < warmUpRounds + measuredRounds; i++) {
+        setUpRequest(&request);
+
+        AllocationCounter::start();
+        request.requestParameters();
+        AllocationCounter::stop();
+
+        if (i >= warmUpRounds) {
+            usage.add();
+        }
+    }
+
+    QByteArray description = describe("requestParameters()", usage);
+    qDebug() << description.constData();
+    check("requestParameters", usage.allocations, usage.bytes, description);
+}
+
+// From executeRequest() until the reply has been handled and deleted, with an in-memory
+// transport so that no network threads are involved.
+void Ut_Allocations::ut_executeRequest() {
+    KQOAuthLoopbackTransport transport;
+    transport.setReply(QString(), 200, "ok=1");
+
+    KQOAuthManager manager;
+    manager.setTransport(&transport);
+
+    ReplyCounter counter;
+    connect(&manager, SIGNAL(replyReceived(KQOAuthManager::KQOAuthReply)),
+            &counter, SLOT(onReply(KQOAuthManager::KQOAuthReply)));
+
+    KQOAuthRequest request;
+    Usage usage;
+    QElapsedTimer clock;
+
+    for (int i = 0; i < warmUpRounds + measuredRounds; i++) {
+        setUpRequest(&request);
+        int expected = counter.received + 1;
+        clock.start();
+
+        AllocationCounter::start();
+        manager.executeRequest(&request);
+        while (counter.received < expected && clock.elapsed() < 5000) {
+            QCoreApplication::processEvents();
+        }
+        QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+        AllocationCounter::stop();
+
+        QCOMPARE(counter.received, expected);
+        if (i >= warmUpRounds) {
+            usage.add();
+        }
+    }
+
+    QByteArray description = describe("executeRequest()", usage);
+    qDebug() << description.constData();
+    check("executeRequest", usage.allocations, usage.bytes, description);
+}
+
+QTEST_MAIN(Ut_Allocations)
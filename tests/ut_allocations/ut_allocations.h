@@ -0,0 +1,61 @@
+/**
+ * KQOAuth - An OAuth authentication library for Qt.
+ *
+ * Author: Johan Paul (johan.paul@d-pointer.com)
+ *         http://www.d-pointer.com
+ *
+ *  KQOAuth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  KQOAuth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with KQOAuth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UT_ALLOCATIONS_H
+#define UT_ALLOCATIONS_H
+
+#include <QHash>
+#include <QObject>
+
+#include "kqoauthmanager.h"
+
+class ReplyCounter : public QObject
+{
+    Q_OBJECT
+public:
+    ReplyCounter() : received(0) {}
+    int received;
+
+public Q_SLOTS:
+    void onReply(KQOAuthManager::KQOAuthReply reply);
+};
+
+// Checks the heap traffic of signing and sending a request against the budgets
+// in ut_allocations.cpp.
+class Ut_Allocations : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void ut_requestParameters();
+    void ut_executeRequest();
+
+private:
+    // Compares the measurement with the budget, or records it.
+    void check(const char *name, qint64 allocations, qint64 bytes, const QByteArray &description);
+
+    QHash<QByteArray, qint64> budgets;
+    QHash<QByteArray, qint64> recorded;
+    bool recording;
+};
+
+#endif // UT_ALLOCATIONS_H
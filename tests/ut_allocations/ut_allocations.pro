@@ -0,0 +1,29 @@
+TARGET = ut_allocations
+TEMPLATE = app
+
+DEFINES += UNIT_TEST
+# The budgets checked against, kept next to the sources so that recording updates them.
+DEFINES += BUDGETS_FILE=\\\"$$PWD/budgets.txt\\\"
+
+QT += testlib network
+QT -= gui
+CONFIG += crypto
+
+macx {
+    CONFIG -= app_bundle    
+    LIBS += -F../../lib -framework kqoauth
+}
+else:unix {
+  # the second argument (after colon) is for
+  # being able to run make check from the root source directory
+  LIBS += -L../../lib -lkqoauth
+}
+else:windows {
+  LIBS += -L../../lib -lkqoauthd0
+}
+
+INCLUDEPATH += . ../../src
+HEADERS += ut_allocations.h \
+           allocationcounter.h
+SOURCES += ut_allocations.cpp \
+           allocationcounter.cpp
@@ -22,13 +22,33 @@
 // Qt includes
 #include <QtDebug>
 #include <QTest>
+#include <QThread>
+#include <QDir>
+#include <QFile>
 #include <QUrl>
+#include <QPointer>
+#include <QSet>
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <QTcpSocket>
 
 // Project includes
 #include "kqoauthrequest.h"
 #include "kqoauthmanager.h"
 #include <kqoauthrequest_p.h>
 #include <kqoauthutils.h>
+#include <kqoauthtimerwheel.h>
+#include <kqoauthsubmissionqueue.h>
+#include <kqoauthcredentialregistry.h>
+#include <kqoauthtokenstore.h>
+#include <kqoauthsessioncache.h>
+#include <kqoauthhttpclient.h>
+#include <kqoauthloopbacktransport.h>
+#include <kqoauthverifier.h>
+#include <kqoauthauthreplyserver.h>
+#include <kqoauthformparser.h>
+#include <kqoauththreadedmanager.h>
+#include <kqoauthpendingreply.h>
 
 const QString Ut_KQOAuth::twitterExampleBaseString = QString("POST&https%3A%2F%2Fapi.twitter.com%2Foauth%2Frequest_token&oauth_callback%3Dhttp%253A%252F%252Flocalhost%253A3005%252Fthe_dance%252Fprocess_callback%253Fservice_provider_id%253D11%26oauth_consumer_key%3DGDdmIQH6jhtmLUypg82g%26oauth_nonce%3DQP70eNmVz8jvdPevU3oJD2AfF7R7odC2XJcn4XlZJqk%26oauth_signature_method%3DHMAC-SHA1%26oauth_timestamp%3D1272323042%26oauth_version%3D1.0");
 const QString Ut_KQOAuth::googleBaseString = QString("POST&http%3A%2F%2Fapi.twitter.com%2F1%2Fstatuses%2Fupdate.xml&oauth_consumer_key%3D9PqhX2sX7DlmjNJ5j2Q%26oauth_nonce%3D9275bae57071b54b6077a9d5561d45ad%26oauth_signature_method%3DHMAC-SHA1%26oauth_timestamp%3D1288513281%26oauth_token%3D210109965-FPE2myUlNMCix2l5dyo9AlUvPu3VvIOvCTbd1CvJ%26oauth_version%3D1.0%26status%3Dsetting%2520up%2520my%2520twitter");
@@ -179,4 +199,1186 @@ void Ut_KQOAuth::ut_convert_verifier() {
     QVERIFY(storedVerifier == "=RwO3QvpqQ5dL7jP");
 }
 
+void Ut_KQOAuth::ut_timer_wheel() {
+    KQOAuthTimerWheel wheel(10);
+    wheel.schedule(1, 25, 0);
+    wheel.schedule(2, 30, 0);
+    wheel.schedule(3, 100000, 0);   // Lives on one of the coarser levels.
+    QCOMPARE(wheel.count(), 3);
+
+    QVERIFY(wheel.cancel(2));
+    QVERIFY(!wheel.cancel(2));
+
+    QVERIFY(wheel.advance(20).isEmpty());
+
+    QList<quint64> expired = wheel.advance(40);
+    QCOMPARE(expired.size(), 1);
+    QCOMPARE(expired.first(), quint64(1));
+
+    // Follow the wakeups the manager would use; the far timer must not fire early.
+    qint64 now = 40;
+    expired.clear();
+    while (expired.isEmpty() && wheel.nextWakeup() >= 0) {
+        now = wheel.nextWakeup();
+        expired = wheel.advance(now);
+    }
+
+    QCOMPARE(expired.size(), 1);
+    QCOMPARE(expired.first(), quint64(3));
+    QVERIFY(now >= 100000);
+    QVERIFY(now < 100000 + 10);
+    QVERIFY(wheel.isEmpty());
+    QCOMPARE(wheel.nextWakeup(), qint64(-1));
+}
+
+void Ut_KQOAuth::ut_submission_queue() {
+    KQOAuthSubmissionQueue queue;
+    QVERIFY(queue.dequeue() == 0);
+
+    // Only the first submission of a batch asks for a wake-up.
+    for (int i = 0; i < 3; i++) {
+        KQOAuthSubmission *submission = new KQOAuthSubmission;
+        submission->userData = i;
+        QCOMPARE(queue.enqueue(submission), i == 0);
+    }
+
+    queue.beginDrain();
+    for (int i = 0; i < 3; i++) {
+        KQOAuthSubmission *submission = queue.dequeue();
+        QVERIFY(submission != 0);
+        QCOMPARE(submission->userData.toInt(), i);
+        delete submission;
+    }
+    QVERIFY(queue.dequeue() == 0);
+
+    // After draining started, the next submission wakes the consumer again.
+    QVERIFY(queue.enqueue(new KQOAuthSubmission));
+}
+
+namespace
+{
+    // Calls executeBlocking() from outside the manager's thread.
+    class BlockingCaller : public QThread
+    {
+    public:
+        BlockingCaller(KQOAuthManager *manager, KQOAuthRequest *request, int timeout = 5000) :
+            manager(manager), request(request), timeout(timeout) {}
+
+        void run() {
+            reply = manager->executeBlocking(request, timeout, QVariant(42));
+        }
+
+        KQOAuthManager *manager;
+        KQOAuthRequest *request;
+        int timeout;
+        KQOAuthManager::KQOAuthReply reply;
+    };
+}
+
+void Ut_KQOAuth::ut_execute_blocking() {
+    KQOAuthManager manager;
+
+    // Would deadlock on the manager's own thread.
+    KQOAuthManager::KQOAuthReply reply = manager.executeBlocking(r, 1000);
+    QCOMPARE(reply.error, KQOAuthManager::ManagerError);
+
+    // Requests failing before they reach the network complete the call right away.
+    BlockingCaller caller(&manager, 0);
+    caller.start();
+    for (int i = 0; i < 500 && !caller.isFinished(); i++) {
+        QTest::qWait(10);
+    }
+    QVERIFY(caller.wait(1000));
+    QCOMPARE(caller.reply.error, KQOAuthManager::RequestError);
+    QCOMPARE(caller.reply.userData.toInt(), 42);
+}
+
+void Ut_KQOAuth::ut_execute_blocking_timeout() {
+    KQOAuthLoopbackTransport transport;
+    transport.setReply(QString(), 200, "ok=1");
+    KQOAuthManager manager;
+    manager.setTransport(&transport);
+
+    KQOAuthRequest *request = new KQOAuthRequest;
+    request->initRequest(KQOAuthRequest::AuthorizedRequest, QUrl("https://api.example.com/1/statuses/update.json"));
+    request->setConsumerKey("consumer");
+    request->setConsumerSecretKey("consumerSecret");
+    request->setToken("token");
+    request->setTokenSecret("tokenSecret");
+
+    // The manager's thread is blocked in wait() here, so the call times out while its
+    // submission is still queued.
+    BlockingCaller caller(&manager, request, 100);
+    caller.start();
+    QVERIFY(caller.wait(5000));
+    QCOMPARE(caller.reply.error, KQOAuthManager::RequestTimeout);
+    QCOMPARE(caller.reply.userData.toInt(), 42);
+
+    // The caller owns the request again and the manager must not touch it.
+    delete request;
+    qRegisterMetaType<KQOAuthManager::KQOAuthReply>();
+    QSignalSpy replies(&manager, SIGNAL(replyReceived(KQOAuthManager::KQOAuthReply)));
+    QTest::qWait(100);
+    QCOMPARE(transport.requestCount(), 0);
+    QCOMPARE(replies.count(), 0);
+}
+
+void Ut_KQOAuth::ut_execute_blocking_manager_deleted() {
+    KQOAuthLoopbackTransport transport;
+    transport.setReply(QString(), 200, "ok=1");
+    transport.setLatency(60000);
+    KQOAuthManager *manager = new KQOAuthManager;
+    manager->setTransport(&transport);
+
+    KQOAuthRequest *request = new KQOAuthRequest;
+    request->initRequest(KQOAuthRequest::AuthorizedRequest, QUrl("https://api.example.com/1/statuses/update.json"));
+    request->setConsumerKey("consumer");
+    request->setConsumerSecretKey("consumerSecret");
+    request->setToken("token");
+    request->setTokenSecret("tokenSecret");
+
+    // The first call is sent and waits for its reply.
+    BlockingCaller sent(manager, request, 0);
+    sent.start();
+    for (int i = 0; i < 500 && transport.requestCount() == 0; i++) {
+        QTest::qWait(10);
+    }
+    QCOMPARE(transport.requestCount(), 1);
+
+    // The second one is still queued, since we do not run the event loop.
+    BlockingCaller queued(manager, request, 0);
+    queued.start();
+    QTest::qSleep(200);
+    QVERIFY(queued.isRunning());
+
+    delete manager;
+
+    QVERIFY(sent.wait(5000));
+    QCOMPARE(sent.reply.error, KQOAuthManager::ManagerError);
+    QCOMPARE(sent.reply.userData.toInt(), 42);
+    QVERIFY(queued.wait(5000));
+    QCOMPARE(queued.reply.error, KQOAuthManager::ManagerError);
+    QCOMPARE(queued.reply.userData.toInt(), 42);
+    QCOMPARE(transport.requestCount(), 1);
+
+    delete request;
+}
+
+namespace
+{
+    // Submits its requests to a KQOAuthThreadedManager from a thread of its own.
+    class Submitter : public QThread
+    {
+    public:
+        Submitter(KQOAuthThreadedManager *manager, const QList<KQOAuthRequest *> &requests, int firstId) :
+            manager(manager), requests(requests), firstId(firstId) {}
+
+        void run() {
+            for (int i = 0; i < requests.size(); i++) {
+                manager->executeRequest(requests.at(i), QVariant(firstId + i));
+            }
+        }
+
+        KQOAuthThreadedManager *manager;
+        QList<KQOAuthRequest *> requests;
+        int firstId;
+    };
+}
+
+void Ut_KQOAuth::ut_threaded_manager() {
+    qRegisterMetaType<KQOAuthManager::KQOAuthReply>();
+
+    KQOAuthLoopbackTransport transport;
+    transport.setReply("/1/resource", 200, "resource");
+
+    ReplyReceiver receiver;
+    KQOAuthThreadedManager manager(2, &transport);
+    connect(&manager, SIGNAL(replyReceived(KQOAuthManager::KQOAuthReply)),
+            &receiver, SLOT(onReply(KQOAuthManager::KQOAuthReply)));
+
+    const int submitterCount = 3;
+    const int requestsPerSubmitter = 10;
+    QList<KQOAuthRequest *> requests;
+    QList<Submitter *> submitters;
+    for (int s = 0; s < submitterCount; s++) {
+        QList<KQOAuthRequest *> own;
+        for (int i = 0; i < requestsPerSubmitter; i++) {
+            KQOAuthRequest *request = new KQOAuthRequest;
+            request->initRequest(KQOAuthRequest::AuthorizedRequest, QUrl("https://api.example.com/1/resource"));
+            request->setConsumerKey("consumer");
+            request->setConsumerSecretKey("consumerSecret");
+            request->setToken("token");
+            request->setTokenSecret("tokenSecret");
+            own.append(request);
+        }
+        requests += own;
+        submitters.append(new Submitter(&manager, own, s * requestsPerSubmitter));
+    }
+
+    // Fails validation on a worker thread, and still gets its reply.
+    KQOAuthRequest *invalid = new KQOAuthRequest;
+    invalid->initRequest(KQOAuthRequest::AuthorizedRequest, QUrl("https://api.example.com/1/resource"));
+    requests.append(invalid);
+
+    foreach (Submitter *submitter, submitters) {
+        submitter->start();
+    }
+    manager.executeRequest(invalid, QVariant(-1));
+    manager.executeRequest(0, QVariant(-2));
+    foreach (Submitter *submitter, submitters) {
+        QVERIFY(submitter->wait(5000));
+    }
+
+    const int expected = submitterCount * requestsPerSubmitter + 2;
+    for (int i = 0; i < 500 && receiver.replies.count() < expected; i++) {
+        QTest::qWait(10);
+    }
+    QCOMPARE(receiver.replies.count(), expected);
+
+    QSet<int> ids;
+    for (int i = 0; i < receiver.replies.count(); i++) {
+        QVERIFY(receiver.threads.at(i) == QThread::currentThread());
+
+        const KQOAuthManager::KQOAuthReply &reply = receiver.replies.at(i);
+        int id = reply.userData.toInt();
+        ids.insert(id);
+        if (id == -1) {
+            QCOMPARE(reply.error, KQOAuthManager::RequestValidationError);
+        } else if (id == -2) {
+            QCOMPARE(reply.error, KQOAuthManager::RequestError);
+        } else {
+            QCOMPARE(reply.error, KQOAuthManager::NoError);
+            QCOMPARE(reply.data, QByteArray("resource"));
+        }
+    }
+    QCOMPARE(ids.size(), expected);
+    QCOMPARE(transport.requestCount(), submitterCount * requestsPerSubmitter);
+
+    qDeleteAll(submitters);
+    qDeleteAll(requests);
+}
+
+void Ut_KQOAuth::ut_credential_registry() {
+    // The prepared key signs like the plain secrets, also when it has to be hashed.
+    QByteArray key = KQOAuthUtils::hmac_sha1_key("1NYYhpIw1fXItywS9Bw6gGRmkRyF9zB54UXkTGcI8",
+                                                 "CBP6yupjMl1VLEuN5EMcWm43QLf1MCO4jeSFr7jhOI");
+    QCOMPARE(KQOAuthUtils::hmac_sha1_with_key(googleBaseString.toAscii(), key),
+             QString("csX8BwnX35BbUlX9PqYxmvXI/KM="));
+
+    KQOAuthCredentialRegistry registry;
+    registry.insert("alice", "consumer", "consumerSecret", "aliceToken", "aliceSecret");
+    registry.insert("bob", "consumer", "consumerSecret", QString::fromUtf8("b\xc3\xb6" "bToken"), "bobSecret");
+    QCOMPARE(registry.count(), 2);
+
+    KQOAuthCredentials bob = registry.credentials("bob");
+    QVERIFY(bob.isValid());
+    QCOMPARE(bob.consumerKey(), QString("consumer"));
+    QCOMPARE(bob.token(), QString::fromUtf8("b\xc3\xb6" "bToken"));
+
+    QVERIFY(!registry.credentials("carol").isValid());
+
+    // Handles outlive the registry entry.
+    QVERIFY(registry.remove("bob"));
+    QVERIFY(!registry.contains("bob"));
+    QCOMPARE(bob.token(), QString::fromUtf8("b\xc3\xb6" "bToken"));
+}
+
+void Ut_KQOAuth::ut_token_store() {
+    QString fileName = QDir::temp().filePath("ut_kqoauth_tokens");
+    QFile::remove(fileName);
+    QFile::remove(fileName + ".log");
+
+    KQOAuthTokenStore::Tokens tokens;
+    tokens.token = "token";
+    tokens.tokenSecret = "secret";
+    tokens.consumerKey = "consumer";
+    tokens.consumerSecret = "consumerSecret";
+
+    {
+        KQOAuthTokenStore store(fileName);
+        store.setCompactionThreshold(4);
+        QVERIFY(store.open());
+        QVERIFY(!store.contains("user0"));
+
+        // Crosses the compaction threshold, so some accounts end up in the snapshot.
+        for (int i = 0; i < 10; i++) {
+            tokens.token = QString("token%1").arg(i);
+            QVERIFY(store.saveTokens(QString("user%1").arg(i), tokens));
+        }
+        QVERIFY(store.removeTokens("user3"));
+        QVERIFY(!store.removeTokens("nobody"));
+    }
+
+    KQOAuthTokenStore store(fileName);
+    QVERIFY(store.open());
+    QVERIFY(!store.contains("user3"));
+    for (int i = 0; i < 10; i++) {
+        if (i != 3) {
+            QCOMPARE(store.tokens(QString("user%1").arg(i)).token, QString("token%1").arg(i));
+        }
+    }
+    QCOMPARE(store.tokens("user9").consumerSecret, QString("consumerSecret"));
+
+    QVERIFY(store.compact());
+    QCOMPARE(store.tokens("user5").token, QString("token5"));
+
+    // Restored tokens authorize the manager.
+    KQOAuthManager manager;
+    QVERIFY(!manager.isAuthorized());
+    manager.setTokenStore(&store, "user5");
+    QVERIFY(manager.isAuthorized());
+    manager.setTokenStore(0, QString());
+
+    store.close();
+    QFile::remove(fileName);
+    QFile::remove(fileName + ".log");
+}
+
+void Ut_KQOAuth::ut_form_parser() {
+    QMultiMap<QString, QString> tokens = KQOAuthFormParser::parseToMap(
+            QByteArray("oauth_token=ab%2Fcd&&oauth_token_secret=s%C3%B6cret&oauth_callback_confirmed=true"));
+    QCOMPARE(tokens.size(), 3);
+    QCOMPARE(tokens.value("oauth_token"), QString("ab/cd"));
+    QCOMPARE(tokens.value("oauth_token_secret"), QString::fromUtf8("s\xc3\xb6" "cret"));
+    QCOMPARE(tokens.value("oauth_callback_confirmed"), QString("true"));
+
+    // Keys without values, extra '=' and malformed escapes.
+    tokens = KQOAuthFormParser::parseToMap(QByteArray("flag&a=b=c&bad=%zz%4"));
+    QCOMPARE(tokens.size(), 3);
+    QVERIFY(tokens.contains("flag"));
+    QCOMPARE(tokens.value("a"), QString("b=c"));
+    QCOMPARE(tokens.value("bad"), QString("%zz%4"));
+
+    // Fields longer than one scan block.
+    QString longValue(100, QChar('x'));
+    tokens = KQOAuthFormParser::parseToMap(QByteArray("first=") + longValue.toAscii() + "&second=%41");
+    QCOMPARE(tokens.value("first"), longValue);
+    QCOMPARE(tokens.value("second"), QString("A"));
+}
+
+void Ut_KQOAuth::ut_shared_network_manager() {
+    KQOAuthManager first;
+    KQOAuthManager second;
+    QVERIFY(first.networkManager() == 0);
+
+    first.setUseSharedNetworkManager(true);
+    second.setUseSharedNetworkManager(true);
+    QVERIFY(first.networkManager() != 0);
+    QVERIFY(first.networkManager() == second.networkManager());
+
+    // Opting out leaves the shared manager to the others.
+    first.setUseSharedNetworkManager(false);
+    QVERIFY(first.networkManager() == 0);
+    QVERIFY(second.networkManager() != 0);
+}
+
+void Ut_KQOAuth::ut_session_cache() {
+    QString fileName = QDir::temp().filePath("ut_kqoauth_sessions");
+    QFile::remove(fileName);
+
+    {
+        KQOAuthSessionCache cache(fileName);
+        QVERIFY(cache.load());
+        QCOMPARE(cache.count(), 0);
+        QVERIFY(cache.sessionTicket("api.twitter.com").isEmpty());
+
+        cache.setSessionTicket("API.twitter.com", QByteArray("ticket\0one", 10));
+        cache.setSessionTicket("example.com", "two");
+        cache.removeSessionTicket("example.com");
+        QCOMPARE(cache.count(), 1);
+
+        QCOMPARE(cache.offeredCount(), 0);
+        QCOMPARE(cache.averageHandshakeTime(true), qint64(-1));
+        QCOMPARE(cache.savedHandshakeTime(), qint64(0));
+    }   // Saved on destruction.
+
+    KQOAuthSessionCache cache(fileName);
+    QVERIFY(cache.load());
+    QCOMPARE(cache.count(), 1);
+    QCOMPARE(cache.sessionTicket("api.twitter.com"), QByteArray("ticket\0one", 10));
+
+    // The file starts with the magic and the format version, in big endian.
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.read(8), QByteArray("KQTS\0\0\0\2", 8));
+    file.close();
+
+    // A cache of another format version is refused and left alone.
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write(QByteArray("KQTS\0\0\0\1\0\0\0\0", 12));
+    file.close();
+    KQOAuthSessionCache older(fileName);
+    QVERIFY(!older.load());
+    QCOMPARE(older.count(), 0);
+
+    // As is a file that is not a session cache.
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write("oauth_token=a&oauth_token_secret=b");
+    file.close();
+    KQOAuthSessionCache other(fileName);
+    QVERIFY(!other.load());
+
+    QFile::remove(fileName);
+}
+
+namespace
+{
+    bool waitForReply(QNetworkReply *reply) {
+        for (int i = 0; i < 500 && !reply->isFinished(); i++) {
+            QTest::qWait(10);
+        }
+        return reply->isFinished();
+    }
+
+    // Reads from 'peer' until 'count' request heads are in.
+    QByteArray readRequests(QTcpSocket *peer, int count) {
+        QByteArray received;
+        for (int i = 0; i < 500 && received.count("\r\n\r\n") < count; i++) {
+            QTest::qWait(10);
+            received += peer->readAll();
+        }
+        return received;
+    }
+}
+
+void Ut_KQOAuth::ut_lean_http_client() {
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QUrl base(QString("http://127.0.0.1:%1/").arg(server.serverPort()));
+
+    KQOAuthHttpClient client;
+    QNetworkRequest request(base.resolved(QUrl("first?a=b")));
+    request.setRawHeader("Authorization", "OAuth oauth_token=\"x\"");
+    QNetworkReply *first = client.get(request);
+
+    for (int i = 0; i < 500 && !server.hasPendingConnections(); i++) {
+        QTest::qWait(10);
+    }
+    QTcpSocket *peer = server.nextPendingConnection();
+    QVERIFY(peer);
+
+    QByteArray received = readRequests(peer, 1);
+    QVERIFY(received.startsWith("GET /first?a=b HTTP/1.1\r\n"));
+    QVERIFY(received.contains("\r\nAuthorization: OAuth oauth_token=\"x\"\r\n"));
+
+    peer->write("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 5\r\n\r\nhello");
+    QVERIFY(waitForReply(first));
+    QCOMPARE(first->error(), QNetworkReply::NoError);
+    QCOMPARE(first->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QCOMPARE(first->header(QNetworkRequest::ContentTypeHeader).toString(), QString("text/plain"));
+    QCOMPARE(first->readAll(), QByteArray("hello"));
+
+    // The connection is known to stay open now, so these two share it.
+    QNetworkReply *second = client.get(QNetworkRequest(base.resolved(QUrl("second"))));
+    QNetworkReply *third = client.get(QNetworkRequest(base.resolved(QUrl("third"))));
+    received = readRequests(peer, 2);
+    QVERIFY(received.startsWith("GET /second HTTP/1.1\r\n"));
+    QVERIFY(received.contains("GET /third HTTP/1.1\r\n"));
+    QVERIFY(!server.hasPendingConnections());
+    QCOMPARE(client.connectionCount(), 1);
+
+    peer->write("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n2\r\nde\r\n0\r\n\r\n"
+                "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+    QVERIFY(waitForReply(third));
+    QVERIFY(second->isFinished());
+    QCOMPARE(second->readAll(), QByteArray("abcde"));
+    QCOMPARE(third->error(), QNetworkReply::ContentNotFoundError);
+    QCOMPARE(third->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 404);
+}
+
+void Ut_KQOAuth::ut_lean_http_client_retry() {
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QUrl base(QString("http://127.0.0.1:%1/").arg(server.serverPort()));
+
+    KQOAuthHttpClient client;
+    client.setMaximumConnectionsPerHost(1);
+    QNetworkReply *first = client.get(QNetworkRequest(base.resolved(QUrl("first"))));
+    for (int i = 0; i < 500 && !server.hasPendingConnections(); i++) {
+        QTest::qWait(10);
+    }
+    QTcpSocket *peer = server.nextPendingConnection();
+    QVERIFY(peer);
+    readRequests(peer, 1);
+    peer->write("HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n");
+    QVERIFY(waitForReply(first));
+
+    // The server drops the connection with two requests unanswered. They are sent again
+    // on a new connection, in their original order.
+    QNetworkReply *second = client.get(QNetworkRequest(base.resolved(QUrl("second"))));
+    QNetworkReply *third = client.get(QNetworkRequest(base.resolved(QUrl("third"))));
+    QCOMPARE(readRequests(peer, 2).count("GET /"), 2);
+    peer->close();
+
+    for (int i = 0; i < 500 && !server.hasPendingConnections(); i++) {
+        QTest::qWait(10);
+    }
+    peer = server.nextPendingConnection();
+    QVERIFY(peer);
+    QVERIFY(readRequests(peer, 1).startsWith("GET /second HTTP/1.1\r\n"));
+
+    // Nothing is readable before the whole response is in.
+    peer->write("HTTP/1.1 200 OK\r\nContent-Length: 6\r\n\r\nsec");
+    QTest::qWait(50);
+    QVERIFY(!second->isFinished());
+    QCOMPARE(second->bytesAvailable(), qint64(0));
+    peer->write("ond");
+    QVERIFY(waitForReply(second));
+    QCOMPARE(second->bytesAvailable(), qint64(6));
+    QCOMPARE(second->readAll(), QByteArray("second"));
+
+    QVERIFY(readRequests(peer, 1).startsWith("GET /third HTTP/1.1\r\n"));
+    peer->write("HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n");
+    QVERIFY(waitForReply(third));
+    QCOMPARE(third->error(), QNetworkReply::NoError);
+}
+
+void Ut_KQOAuth::ut_shared_network_manager_cookies() {
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QUrl base(QString("http://127.0.0.1:%1/").arg(server.serverPort()));
+
+    KQOAuthManager first;
+    KQOAuthManager second;
+    first.setUseSharedNetworkManager(true);
+    second.setUseSharedNetworkManager(true);
+
+    QNetworkReply *reply = first.networkManager()->get(QNetworkRequest(base.resolved(QUrl("first"))));
+    for (int i = 0; i < 500 && !server.hasPendingConnections(); i++) {
+        QTest::qWait(10);
+    }
+    QTcpSocket *peer = server.nextPendingConnection();
+    QVERIFY(peer);
+    QVERIFY(readRequests(peer, 1).startsWith("GET /first HTTP/1.1\r\n"));
+    peer->write("HTTP/1.1 200 OK\r\nSet-Cookie: session=first\r\nContent-Length: 0\r\n\r\n");
+    QVERIFY(waitForReply(reply));
+    reply->deleteLater();
+
+    // Same connection pool, but the cookie of the first service is not sent for the second.
+    reply = second.networkManager()->get(QNetworkRequest(base.resolved(QUrl("second"))));
+    QByteArray received = readRequests(peer, 1);
+    QVERIFY(received.startsWith("GET /second HTTP/1.1\r\n"));
+    QVERIFY(!received.contains("Cookie:"));
+    QVERIFY(!server.hasPendingConnections());
+    peer->write("HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n");
+    QVERIFY(waitForReply(reply));
+    reply->deleteLater();
+}
+
+void Ut_KQOAuth::ut_loopback_transport() {
+    KQOAuthLoopbackTransport transport;
+    transport.setReply("/oauth/request_token", 200, "oauth_token=abc&oauth_token_secret=def&oauth_callback_confirmed=true");
+
+    KQOAuthManager manager;
+    manager.setTransport(&transport);
+    QSignalSpy tokens(&manager, SIGNAL(temporaryTokenReceived(QString,QString)));
+
+    r->initRequest(KQOAuthRequest::TemporaryCredentials, QUrl("https://api.example.com/oauth/request_token"));
+    r->setConsumerKey("consumer");
+    r->setConsumerSecretKey("consumerSecret");
+    r->setCallbackUrl(QUrl("http://localhost:4242"));
+    manager.executeRequest(r);
+
+    for (int i = 0; i < 500 && tokens.count() == 0; i++) {
+        QTest::qWait(10);
+    }
+    QCOMPARE(tokens.count(), 1);
+    QCOMPARE(tokens.at(0).at(0).toString(), QString("abc"));
+    QCOMPARE(tokens.at(0).at(1).toString(), QString("def"));
+
+    QCOMPARE(transport.requestCount(), 1);
+    QVERIFY(transport.lastRequest().rawHeader("Authorization").startsWith("OAuth "));
+    QVERIFY(manager.networkManager() == 0);
+}
+
+void Ut_KQOAuth::ut_pending_reply() {
+    qRegisterMetaType<KQOAuthManager::KQOAuthReply>();
+
+    KQOAuthLoopbackTransport transport;
+    transport.setReply("/1/first", 200, "first");
+    transport.setReply("/1/second", 200, "second");
+
+    KQOAuthManager manager;
+    manager.setTransport(&transport);
+
+    KQOAuthRequest second;
+    second.initRequest(KQOAuthRequest::AuthorizedRequest, QUrl("https://api.example.com/1/second"));
+    r->initRequest(KQOAuthRequest::AuthorizedRequest, QUrl("https://api.example.com/1/first"));
+    foreach (KQOAuthRequest *request, QList<KQOAuthRequest *>() << r << &second) {
+        request->setConsumerKey("consumer");
+        request->setConsumerSecretKey("consumerSecret");
+        request->setToken("token");
+        request->setTokenSecret("tokenSecret");
+    }
+
+    ReplyReceiver firstReceiver;
+    ReplyReceiver chainedReceiver;
+    ReplyReceiver secondReceiver;
+    QPointer<KQOAuthPendingReply> first = manager.executeRequest(r, &firstReceiver, SLOT(onReply(KQOAuthManager::KQOAuthReply)), QVariant(1));
+    QVERIFY(first->then(&chainedReceiver, SLOT(onReply(KQOAuthManager::KQOAuthReply))) == first);
+    QPointer<KQOAuthPendingReply> handle = manager.executeRequest(&second, &secondReceiver, SLOT(onReply(KQOAuthManager::KQOAuthReply)), QVariant(2));
+
+    for (int i = 0; i < 500 && (firstReceiver.replies.isEmpty() || secondReceiver.replies.isEmpty()); i++) {
+        QTest::qWait(10);
+    }
+
+    // Each handle only fires for its own request.
+    QCOMPARE(firstReceiver.replies.count(), 1);
+    QCOMPARE(firstReceiver.replies.at(0).data, QByteArray("first"));
+    QCOMPARE(firstReceiver.replies.at(0).userData.toInt(), 1);
+    QCOMPARE(chainedReceiver.replies.count(), 1);
+    QCOMPARE(chainedReceiver.replies.at(0).userData.toInt(), 1);
+    QCOMPARE(secondReceiver.replies.count(), 1);
+    QCOMPARE(secondReceiver.replies.at(0).data, QByteArray("second"));
+    QCOMPARE(secondReceiver.replies.at(0).userData.toInt(), 2);
+
+    // The handles delete themselves once they are done.
+    QTest::qWait(10);
+    QVERIFY(first.isNull());
+    QVERIFY(handle.isNull());
+
+    // A request failing validation completes from the event loop, not from executeRequest().
+    KQOAuthRequest invalid;
+    invalid.initRequest(KQOAuthRequest::AuthorizedRequest, QUrl("https://api.example.com/1/first"));
+    ReplyReceiver failedReceiver;
+    handle = manager.executeRequest(&invalid, &failedReceiver, SLOT(onReply(KQOAuthManager::KQOAuthReply)), QVariant(3));
+    QVERIFY(!handle.isNull());
+    QVERIFY(!handle->isFinished());
+    QVERIFY(failedReceiver.replies.isEmpty());
+
+    for (int i = 0; i < 500 && failedReceiver.replies.isEmpty(); i++) {
+        QTest::qWait(10);
+    }
+    QCOMPARE(failedReceiver.replies.count(), 1);
+    QCOMPARE(failedReceiver.replies.at(0).error, KQOAuthManager::RequestValidationError);
+    QCOMPARE(failedReceiver.replies.at(0).userData.toInt(), 3);
+    QTest::qWait(10);
+    QVERIFY(handle.isNull());
+    QCOMPARE(transport.requestCount(), 2);
+}
+
+#ifdef KQOAUTH_HAVE_COROUTINES
+namespace
+{
+    // Runs until its first co_await when called and frees itself when it returns.
+    struct DetachedTask
+    {
+        struct promise_type
+        {
+            DetachedTask get_return_object() { return DetachedTask(); }
+            std::suspend_never initial_suspend() { return std::suspend_never(); }
+            std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+    // Gets the temporary token, then uses it for the next request. 'signalsSeen' records how
+    // many replyReceived() signals had been emitted whenever the coroutine was resumed.
+    DetachedTask tokenThenResource(KQOAuthManager *manager, KQOAuthRequest *request,
+                                   QSignalSpy *replySignals, QList<KQOAuthManager::KQOAuthReply> *replies,
+                                   QList<int> *signalsSeen) {
+        request->initRequest(KQOAuthRequest::TemporaryCredentials, QUrl("https://api.example.com/oauth/request_token"));
+        request->setConsumerKey("consumer");
+        request->setConsumerSecretKey("consumerSecret");
+        request->setCallbackUrl(QUrl("http://localhost:4242"));
+        KQOAuthManager::KQOAuthReply reply = co_await manager->send(request);
+        signalsSeen->append(replySignals->count());
+        replies->append(reply);
+
+        request->initRequest(KQOAuthRequest::AuthorizedRequest, QUrl("https://api.example.com/1/resource"));
+        request->setConsumerKey("consumer");
+        request->setConsumerSecretKey("consumerSecret");
+        request->setToken("abc");
+        request->setTokenSecret("def");
+        reply = co_await manager->send(request, QVariant(2));
+        signalsSeen->append(replySignals->count());
+        replies->append(reply);
+    }
+
+    // Sets the flag when the coroutine frame holding it is destroyed.
+    struct FrameGuard
+    {
+        explicit FrameGuard(bool *destroyed) : destroyed(destroyed) {}
+        ~FrameGuard() { *destroyed = true; }
+        bool *destroyed;
+    };
+
+    DetachedTask awaitResource(KQOAuthManager *manager, KQOAuthRequest *request,
+                               QList<KQOAuthManager::KQOAuthReply> *replies, bool *frameDestroyed) {
+        FrameGuard guard(frameDestroyed);
+        KQOAuthManager::KQOAuthReply reply = co_await manager->send(request, QVariant(3));
+        replies->append(reply);
+    }
+}
+#endif
+
+void Ut_KQOAuth::ut_coroutine_send() {
+#ifndef KQOAUTH_HAVE_COROUTINES
+#  if QT_VERSION >= 0x050000
+    QSKIP("The compiler does not support coroutines.");
+#  else
+    QSKIP("The compiler does not support coroutines.", SkipSingle);
+#  endif
+#else
+    qRegisterMetaType<KQOAuthManager::KQOAuthReply>();
+
+    KQOAuthLoopbackTransport transport;
+    transport.setReply("/oauth/request_token", 200, "oauth_token=abc&oauth_token_secret=def&oauth_callback_confirmed=true");
+    transport.setReply("/1/resource", 200, "resource");
+
+    KQOAuthManager manager;
+    manager.setTransport(&transport);
+    QSignalSpy replySignals(&manager, SIGNAL(replyReceived(KQOAuthManager::KQOAuthReply)));
+
+    QList<KQOAuthManager::KQOAuthReply> replies;
+    QList<int> signalsSeen;
+    tokenThenResource(&manager, r, &replySignals, &replies, &signalsSeen);
+    QVERIFY(replies.isEmpty());
+
+    for (int i = 0; i < 500 && replies.count() < 2; i++) {
+        QTest::qWait(10);
+    }
+    QCOMPARE(replies.count(), 2);
+    QCOMPARE(int(replies.at(0).error), int(KQOAuthManager::NoError));
+    QVERIFY(replies.at(0).data.contains("oauth_token=abc"));
+    QCOMPARE(int(replies.at(1).error), int(KQOAuthManager::NoError));
+    QCOMPARE(replies.at(1).data, QByteArray("resource"));
+    QCOMPARE(replies.at(1).userData.toInt(), 2);
+    QCOMPARE(transport.requestCount(), 2);
+
+    // The coroutine is resumed only after the manager is done with the reply.
+    QCOMPARE(signalsSeen, QList<int>() << 1 << 2);
+#endif
+}
+
+void Ut_KQOAuth::ut_coroutine_manager_deleted() {
+#ifndef KQOAUTH_HAVE_COROUTINES
+#  if QT_VERSION >= 0x050000
+    QSKIP("The compiler does not support coroutines.");
+#  else
+    QSKIP("The compiler does not support coroutines.", SkipSingle);
+#  endif
+#else
+    KQOAuthLoopbackTransport transport;
+    transport.setReply("/1/resource", 200, "resource");
+    transport.setLatency(60000);
+
+    KQOAuthManager *manager = new KQOAuthManager;
+    manager->setTransport(&transport);
+
+    // A request that cannot be sent does not suspend the coroutine.
+    QList<KQOAuthManager::KQOAuthReply> replies;
+    bool frameDestroyed = false;
+    awaitResource(manager, 0, &replies, &frameDestroyed);
+    QCOMPARE(replies.count(), 1);
+    QCOMPARE(int(replies.at(0).error), int(KQOAuthManager::RequestError));
+    QCOMPARE(replies.at(0).userData.toInt(), 3);
+    QVERIFY(frameDestroyed);
+
+    r->initRequest(KQOAuthRequest::AuthorizedRequest, QUrl("https://api.example.com/1/resource"));
+    r->setConsumerKey("consumer");
+    r->setConsumerSecretKey("consumerSecret");
+    r->setToken("abc");
+    r->setTokenSecret("def");
+
+    replies.clear();
+    frameDestroyed = false;
+    awaitResource(manager, r, &replies, &frameDestroyed);
+    QTest::qWait(50);
+    QVERIFY(replies.isEmpty());
+    QVERIFY(!frameDestroyed);
+
+    // The waiting coroutine is resumed, runs to its end and frees its frame.
+    delete manager;
+    QCOMPARE(replies.count(), 1);
+    QCOMPARE(int(replies.at(0).error), int(KQOAuthManager::ManagerError));
+    QCOMPARE(replies.at(0).userData.toInt(), 3);
+    QVERIFY(frameDestroyed);
+#endif
+}
+
+void Ut_KQOAuth::ut_verifier() {
+    r->initRequest(KQOAuthRequest::AuthorizedRequest, QUrl("http://api.example.com/1/statuses/update.json"));
+    r->setHttpMethod(KQOAuthRequest::POST);
+    r->setConsumerKey("consumer");
+    r->setConsumerSecretKey("consumerSecret");
+    r->setToken("token");
+    r->setTokenSecret("tokenSecret");
+    KQOAuthParameters body;
+    body.insert("status", "Hello Ladies + Gentlemen, a signed OAuth request!");
+    r->setAdditionalParameters(body);
+
+    QByteArray header = "OAuth realm=\"Example\"";
+    foreach (const QByteArray &field, r->requestParameters()) {
+        header.append(", " + field);
+    }
+
+    KQOAuthParameters oauth = KQOAuthVerifier::parseAuthorizationHeader(header);
+    QCOMPARE(oauth.value("oauth_consumer_key"), QString("consumer"));
+    QCOMPARE(oauth.value("oauth_token"), QString("token"));
+    QVERIFY(!oauth.contains("realm"));
+
+    KQOAuthVerifier verifier;
+    QUrl url = r->requestEndpoint();
+    QCOMPARE(int(verifier.verify("POST", url, oauth, "consumerSecret", "tokenSecret", body)),
+             int(KQOAuthVerifier::Valid));
+    QCOMPARE(int(verifier.verify("POST", url, oauth, "consumerSecret", "tokenSecret", body)),
+             int(KQOAuthVerifier::NonceUsed));
+    QCOMPARE(KQOAuthVerifier::problem(KQOAuthVerifier::NonceUsed), QByteArray("nonce_used"));
+
+    // Changing the window does not make recorded nonces usable again.
+    verifier.setTimestampWindow(600);
+    QCOMPARE(int(verifier.verify("POST", url, oauth, "consumerSecret", "tokenSecret", body)),
+             int(KQOAuthVerifier::NonceUsed));
+    verifier.setTimestampWindow(60);
+    QCOMPARE(verifier.timestampWindow(), 60);
+    QCOMPARE(int(verifier.verify("POST", url, oauth, "consumerSecret", "tokenSecret", body)),
+             int(KQOAuthVerifier::NonceUsed));
+    verifier.setTimestampWindow(300);
+
+    // Forged requests are refused before their nonce is recorded.
+    oauth.replace("oauth_nonce", "other");
+    QCOMPARE(int(verifier.verify("POST", url, oauth, "consumerSecret", "otherSecret", body)),
+             int(KQOAuthVerifier::SignatureInvalid));
+    KQOAuthParameters tampered;
+    tampered.insert("status", "Tampered");
+    QCOMPARE(int(verifier.verify("POST", url, oauth, "consumerSecret", "tokenSecret", tampered)),
+             int(KQOAuthVerifier::SignatureInvalid));
+
+    KQOAuthParameters stale = oauth;
+    stale.replace("oauth_timestamp", "1000");
+    QCOMPARE(int(verifier.verify("POST", url, stale, "consumerSecret", "tokenSecret", body)),
+             int(KQOAuthVerifier::TimestampRefused));
+    oauth.remove("oauth_signature");
+    QCOMPARE(int(verifier.verify("POST", url, oauth, "consumerSecret", "tokenSecret", body)),
+             int(KQOAuthVerifier::ParameterAbsent));
+}
+
+void Ut_KQOAuth::ut_verifier_matches_request_data() {
+    QTest::addColumn<QUrl>("endpoint");
+    QTest::addColumn<QString>("name");
+    QTest::addColumn<QString>("value");
+    QTest::addColumn<QByteArray>("baseUri");
+
+    QTest::newRow("plain")
+            << QUrl("http://api.example.com/1/update.json") << QString("status") << QString("hi")
+            << QByteArray("http%3A%2F%2Fapi.example.com%2F1%2Fupdate.json");
+    QTest::newRow("explicit http port")
+            << QUrl("http://api.example.com:80/1/update.json") << QString("status") << QString("hi")
+            << QByteArray("http%3A%2F%2Fapi.example.com%2F1%2Fupdate.json");
+    QTest::newRow("explicit https port")
+            << QUrl("https://api.example.com:443/1/update.json") << QString("status") << QString("hi")
+            << QByteArray("https%3A%2F%2Fapi.example.com%2F1%2Fupdate.json");
+    QTest::newRow("other port")
+            << QUrl("http://api.example.com:8080/1/update.json") << QString("status") << QString("hi")
+            << QByteArray("http%3A%2F%2Fapi.example.com%3A8080%2F1%2Fupdate.json");
+    // Sorted before 'z' once encoded, after it when decoded.
+    QTest::newRow("non-ASCII name")
+            << QUrl("http://api.example.com/1/update.json") << QString::fromUtf8("\xc3\xa4") << QString("1")
+            << QByteArray("http%3A%2F%2Fapi.example.com%2F1%2Fupdate.json");
+    QTest::newRow("non-ASCII value")
+            << QUrl("http://api.example.com/1/update.json") << QString("z") << QString::fromUtf8("\xc3\xa4")
+            << QByteArray("http%3A%2F%2Fapi.example.com%2F1%2Fupdate.json");
+    QTest::newRow("braces and bar")
+            << QUrl("http://api.example.com/1/update.json") << QString("{a|b}") << QString("{|}")
+            << QByteArray("http%3A%2F%2Fapi.example.com%2F1%2Fupdate.json");
+}
+
+void Ut_KQOAuth::ut_verifier_matches_request() {
+    QFETCH(QUrl, endpoint);
+    QFETCH(QString, name);
+    QFETCH(QString, value);
+    QFETCH(QByteArray, baseUri);
+
+    r->initRequest(KQOAuthRequest::AuthorizedRequest, endpoint);
+    r->setHttpMethod(KQOAuthRequest::POST);
+    r->setConsumerKey("consumer");
+    r->setConsumerSecretKey("consumerSecret");
+    r->setToken("token");
+    r->setTokenSecret("tokenSecret");
+    KQOAuthParameters body;
+    body.insert(name, value);
+    body.insert("z", "last");
+    r->setAdditionalParameters(body);
+
+    QByteArray header = "OAuth ";
+    foreach (const QByteArray &field, r->requestParameters()) {
+        header.append(field + ", ");
+    }
+    header.chop(2);
+
+    // What the service gets, signed by KQOAuthRequest, must check out.
+    KQOAuthParameters oauth = KQOAuthVerifier::parseAuthorizationHeader(header);
+    KQOAuthVerifier verifier;
+    QCOMPARE(int(verifier.verify("POST", endpoint, oauth, "consumerSecret", "tokenSecret", body)),
+             int(KQOAuthVerifier::Valid));
+
+    QByteArray baseString = KQOAuthVerifier::signatureBaseString("POST", endpoint, oauth + body);
+    QCOMPARE(baseString.split('&').value(1), baseUri);
+}
+
+namespace
+{
+    QTcpSocket *connectToServer(const QTcpServer &server) {
+        QTcpSocket *socket = new QTcpSocket;
+        socket->connectToHost(QHostAddress::LocalHost, server.serverPort());
+        socket->waitForConnected(5000);
+        return socket;
+    }
+
+    // Reads from 'peer' until 'count' responses have started.
+    QByteArray readResponses(QTcpSocket *peer, int count) {
+        QByteArray received;
+        for (int i = 0; i < 500 && received.count("HTTP/1.1 ") < count; i++) {
+            QTest::qWait(10);
+            received += peer->readAll();
+        }
+        return received;
+    }
+
+    bool waitForDisconnected(QTcpSocket *peer) {
+        for (int i = 0; i < 500 && peer->state() != QAbstractSocket::UnconnectedState; i++) {
+            QTest::qWait(10);
+        }
+        return peer->state() == QAbstractSocket::UnconnectedState;
+    }
+}
+
+void Ut_KQOAuth::ut_callback_server() {
+    KQOAuthAuthReplyServer server(0);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    VerificationReceiver first;
+    VerificationReceiver second;
+    server.registerFlow("a", &first);
+    server.registerFlow("b", &second);
+    QCOMPARE(server.flowCount(), 2);
+
+    QTcpSocket *browser = connectToServer(server);
+
+    // Pipelined: the favicon and the HEAD request come before the real callback. Neither
+    // of them completes the flow.
+    browser->write("GET /favicon.ico HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                   "HEAD /?oauth_token=a&oauth_verifier=v HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                   "GET /?oauth_token=a&oauth_verifier=v HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    QByteArray received = readResponses(browser, 3);
+    QVERIFY(received.startsWith("HTTP/1.1 404 Not Found\r\n"));
+    QCOMPARE(received.count("HTTP/1.1 200 OK\r\n"), 2);
+    QCOMPARE(received.count("<HTML></HTML>"), 1);   // No body for HEAD.
+    QCOMPARE(first.responses.size(), 1);
+    QCOMPARE(first.responses.at(0).value("oauth_verifier"), QString("v"));
+    QVERIFY(second.responses.isEmpty());
+
+    // A request split over several reads, on the same connection.
+    browser->write("GET /?oauth_tok");
+    QTest::qWait(20);
+    browser->write("en=b&oauth_verifier=w HTTP/1.1\r\nHo");
+    QTest::qWait(20);
+    browser->write("st: localhost\r\n\r\n");
+    received = readResponses(browser, 1);
+    QVERIFY(received.startsWith("HTTP/1.1 200 OK\r\n"));
+    QCOMPARE(second.responses.size(), 1);
+    QCOMPARE(second.responses.at(0).value("oauth_verifier"), QString("w"));
+    QCOMPARE(first.responses.size(), 1);
+    QCOMPARE(server.flowCount(), 0);
+
+    // Delivered flows are gone.
+    browser->write("GET /?oauth_token=a&oauth_verifier=v HTTP/1.1\r\nConnection: close\r\n\r\n");
+    received = readResponses(browser, 1);
+    QVERIFY(received.startsWith("HTTP/1.1 404 Not Found\r\n"));
+    QVERIFY(waitForDisconnected(browser));
+    QCOMPARE(first.responses.size(), 1);
+    delete browser;
+
+    // A denial names the token as 'denied', or has no verifier. Both end the flow.
+    VerificationReceiver denied;
+    VerificationReceiver unverified;
+    server.registerFlow("c", &denied);
+    server.registerFlow("d", &unverified);
+    browser = connectToServer(server);
+    browser->write("GET /?denied=c HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                   "GET /?oauth_token=d HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    received = readResponses(browser, 2);
+    QCOMPARE(received.count("HTTP/1.1 200 OK\r\n"), 2);
+    QCOMPARE(denied.responses.size(), 1);
+    QCOMPARE(denied.responses.at(0).value("denied"), QString("c"));
+    QVERIFY(denied.responses.at(0).value("oauth_verifier").isEmpty());
+    QCOMPARE(unverified.responses.size(), 1);
+    QVERIFY(unverified.responses.at(0).value("oauth_verifier").isEmpty());
+    QCOMPARE(server.flowCount(), 0);
+    delete browser;
+
+    // Idle and preconnected sockets are closed.
+    server.setIdleTimeout(100);
+    QTcpSocket *idle = connectToServer(server);
+    QVERIFY(waitForDisconnected(idle));
+    delete idle;
+}
+
+void Ut_KQOAuth::ut_callback_server_rejects_input_data() {
+    QTest::addColumn<QByteArray>("input");
+    QTest::addColumn<QByteArray>("status");
+
+    QTest::newRow("garbage") << QByteArray("\x01\x02 garbage\r\n\r\n") << QByteArray("400");
+    QTest::newRow("content length near INT_MAX")
+            << QByteArray("GET /?oauth_token=a HTTP/1.1\r\nContent-Length: 2147483647\r\n\r\n")
+            << QByteArray("413");
+    QTest::newRow("content length overflowing")
+            << QByteArray("GET /?oauth_token=a HTTP/1.1\r\nContent-Length: 99999999999999999999999\r\n\r\n")
+            << QByteArray("400");
+    QTest::newRow("negative content length")
+            << QByteArray("GET /?oauth_token=a HTTP/1.1\r\nContent-Length: -5\r\n\r\n")
+            << QByteArray("400");
+    QTest::newRow("body over 4 KiB")
+            << QByteArray("GET /?oauth_token=a HTTP/1.1\r\nContent-Length: 4097\r\n\r\n")
+            << QByteArray("413");
+    QTest::newRow("header over 16 KiB") << QByteArray("GET /").append(QByteArray(17000, 'a'))
+                                        << QByteArray("431");
+}
+
+void Ut_KQOAuth::ut_callback_server_rejects_input() {
+    QFETCH(QByteArray, input);
+    QFETCH(QByteArray, status);
+
+    KQOAuthAuthReplyServer server(0);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    VerificationReceiver receiver;
+    server.registerFlow("a", &receiver);
+
+    QTcpSocket *browser = connectToServer(server);
+    browser->write(input);
+
+    QByteArray received = readResponses(browser, 1);
+    QVERIFY(received.startsWith("HTTP/1.1 " + status + ' '));
+    QVERIFY(waitForDisconnected(browser));
+    QVERIFY(receiver.responses.isEmpty());
+    QCOMPARE(server.flowCount(), 1);
+    delete browser;
+}
+
+void Ut_KQOAuth::ut_shared_callback_server() {
+    KQOAuthLoopbackTransport transport;
+    transport.setReply("/oauth/request_token", 200, "oauth_token=first&oauth_token_secret=s&oauth_callback_confirmed=true");
+
+    KQOAuthAuthReplyServer *server = KQOAuthAuthReplyServer::sharedServer();
+    int flows = server->flowCount();
+
+    KQOAuthManager *first = new KQOAuthManager;
+    first->setTransport(&transport);
+    first->setHandleUserAuthorization(true);
+    QSignalSpy firstTokens(first, SIGNAL(temporaryTokenReceived(QString,QString)));
+
+    r->initRequest(KQOAuthRequest::TemporaryCredentials, QUrl("https://api.example.com/oauth/request_token"));
+    r->setConsumerKey("consumer");
+    r->setConsumerSecretKey("consumerSecret");
+    first->executeRequest(r);
+    for (int i = 0; i < 500 && firstTokens.count() == 0; i++) {
+        QTest::qWait(10);
+    }
+    QCOMPARE(firstTokens.count(), 1);
+
+    QVERIFY(server->isListening());
+    QCOMPARE(server->serverAddress(), QHostAddress(QHostAddress::LocalHost));
+    quint16 port = server->serverPort();
+    QByteArray callback = "oauth_callback=\"http%3A%2F%2Flocalhost%3A" + QByteArray::number(port) + '"';
+    QVERIFY(transport.lastRequest().rawHeader("Authorization").contains(callback));
+    QCOMPARE(server->flowCount(), flows + 1);
+
+    // A second manager of the thread gets the same listener, whatever port it asks for.
+    transport.setReply("/oauth/request_token", 200, "oauth_token=second&oauth_token_secret=s&oauth_callback_confirmed=true");
+    KQOAuthManager second;
+    second.setTransport(&transport);
+    second.setHandleUserAuthorization(true);
+    second.setCallbackPort(port + 1);
+    QSignalSpy secondTokens(&second, SIGNAL(temporaryTokenReceived(QString,QString)));
+
+    r->initRequest(KQOAuthRequest::TemporaryCredentials, QUrl("https://api.example.com/oauth/request_token"));
+    r->setConsumerKey("consumer");
+    r->setConsumerSecretKey("consumerSecret");
+    second.executeRequest(r);
+    for (int i = 0; i < 500 && secondTokens.count() == 0; i++) {
+        QTest::qWait(10);
+    }
+    QCOMPARE(secondTokens.count(), 1);
+
+    QCOMPARE(server->serverPort(), port);
+    QVERIFY(transport.lastRequest().rawHeader("Authorization").contains(callback));
+    QCOMPARE(server->flowCount(), flows + 2);
+
+    // The flows of a manager go away with it.
+    delete first;
+    QCOMPARE(server->flowCount(), flows + 1);
+}
+
+void Ut_KQOAuth::ut_automatic_flow() {
+    qRegisterMetaType<KQOAuthManager::KQOAuthReply>();
+
+    KQOAuthLoopbackTransport transport;
+    transport.setLatency(50);
+    transport.setReply("/oauth/request_token", 200, "oauth_token=flow&oauth_token_secret=flowSecret&oauth_callback_confirmed=true");
+    transport.setReply("/oauth/access_token", 200, "oauth_token=access&oauth_token_secret=accessSecret");
+    transport.setReply("/1/resource", 200, "resource");
+
+    KQOAuthManager manager;
+    manager.setTransport(&transport);
+    manager.setAutomaticFlow(QUrl("https://api.example.com/oauth/authorize"),
+                             QUrl("https://api.example.com/oauth/access_token"));
+    QSignalSpy pages(&manager, SIGNAL(authorizationPageRequested(QUrl)));
+    QSignalSpy verifications(&manager, SIGNAL(authorizationReceived(QString,QString)));
+    QSignalSpy accessTokens(&manager, SIGNAL(accessTokenReceived(QString,QString)));
+    QSignalSpy replies(&manager, SIGNAL(replyReceived(KQOAuthManager::KQOAuthReply)));
+
+    r->initRequest(KQOAuthRequest::TemporaryCredentials, QUrl("https://api.example.com/oauth/request_token"));
+    r->setConsumerKey("consumer");
+    r->setConsumerSecretKey("consumerSecret");
+    manager.executeRequest(r);
+    for (int i = 0; i < 500 && pages.count() == 0; i++) {
+        QTest::qWait(10);
+    }
+    QCOMPARE(pages.count(), 1);
+    QVERIFY(pages.at(0).at(0).toUrl().toString().contains("oauth_token=flow"));
+
+    // A request failing while the user is in the browser must not spoil the flow.
+    KQOAuthRequest failing;
+    failing.initRequest(KQOAuthRequest::AuthorizedRequest, QUrl("https://api.example.com/1/missing"));
+    failing.setConsumerKey("consumer");
+    failing.setConsumerSecretKey("consumerSecret");
+    failing.setToken("token");
+    failing.setTokenSecret("tokenSecret");
+    manager.executeRequest(&failing);
+    for (int i = 0; i < 500 && replies.count() < 2; i++) {
+        QTest::qWait(10);
+    }
+    QCOMPARE(replies.count(), 2);
+    QVERIFY(manager.lastError() != KQOAuthManager::NoError);
+
+    // The browser comes back with the verifier, and the exchange goes out right away.
+    QTcpSocket *browser = connectToServer(*KQOAuthAuthReplyServer::sharedServer());
+    browser->write("GET /?oauth_token=flow&oauth_verifier=ver HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    QVERIFY(readResponses(browser, 1).startsWith("HTTP/1.1 200 OK\r\n"));
+    QCOMPARE(verifications.count(), 1);
+    QCOMPARE(transport.requestCount(), 3);
+    QCOMPARE(transport.lastRequest().url().path(), QString("/oauth/access_token"));
+    delete browser;
+
+    // Another request goes out while the access token is on its way.
+    KQOAuthRequest other;
+    other.initRequest(KQOAuthRequest::AuthorizedRequest, QUrl("https://api.example.com/1/resource"));
+    other.setConsumerKey("consumer");
+    other.setConsumerSecretKey("consumerSecret");
+    other.setToken("token");
+    other.setTokenSecret("tokenSecret");
+    manager.executeRequest(&other);
+
+    for (int i = 0; i < 500 && (accessTokens.count() == 0 || replies.count() < 4); i++) {
+        QTest::qWait(10);
+    }
+    QCOMPARE(accessTokens.count(), 1);
+    QCOMPARE(accessTokens.at(0).at(0).toString(), QString("access"));
+    QCOMPARE(accessTokens.at(0).at(1).toString(), QString("accessSecret"));
+    QVERIFY(manager.isAuthorized());
+    QCOMPARE(replies.count(), 4);
+}
+
 QTEST_MAIN(Ut_KQOAuth)
@@ -20,10 +20,43 @@
 #ifndef UT_KQOAUTH_H
 #define UT_KQOAUTH_H
 
+#include <QList>
+#include <QMultiMap>
 #include <QObject>
+#include <QString>
+#include <QThread>
+
+#include "kqoauthmanager.h"
 
 class KQOAuthRequest;
 class KQOAuthRequestPrivate;
+
+// Stands in for a manager waiting for the callback of its flow.
+class VerificationReceiver : public QObject
+{
+    Q_OBJECT
+public:
+    QList< QMultiMap<QString, QString> > responses;
+
+public Q_SLOTS:
+    void onVerificationReceived(QMultiMap<QString, QString> response) { responses.append(response); }
+};
+
+// Collects replies, and the threads they were delivered in.
+class ReplyReceiver : public QObject
+{
+    Q_OBJECT
+public:
+    QList<KQOAuthManager::KQOAuthReply> replies;
+    QList<QThread *> threads;
+
+public Q_SLOTS:
+    void onReply(KQOAuthManager::KQOAuthReply reply) {
+        replies.append(reply);
+        threads.append(QThread::currentThread());
+    }
+};
+
 class Ut_KQOAuth : public QObject
 {
     Q_OBJECT
@@ -41,6 +74,32 @@ private Q_SLOTS:
     void ut_basestring_with_percent_encoding();
     void ut_basestring_with_percent_encoding_data();
     void ut_convert_verifier();
+    void ut_timer_wheel();
+    void ut_submission_queue();
+    void ut_execute_blocking();
+    void ut_execute_blocking_timeout();
+    void ut_execute_blocking_manager_deleted();
+    void ut_threaded_manager();
+    void ut_credential_registry();
+    void ut_token_store();
+    void ut_form_parser();
+    void ut_shared_network_manager();
+    void ut_session_cache();
+    void ut_lean_http_client();
+    void ut_lean_http_client_retry();
+    void ut_shared_network_manager_cookies();
+    void ut_loopback_transport();
+    void ut_pending_reply();
+    void ut_coroutine_send();
+    void ut_coroutine_manager_deleted();
+    void ut_verifier();
+    void ut_verifier_matches_request_data();
+    void ut_verifier_matches_request();
+    void ut_callback_server();
+    void ut_shared_callback_server();
+    void ut_automatic_flow();
+    void ut_callback_server_rejects_input_data();
+    void ut_callback_server_rejects_input();
 
 private:
     KQOAuthRequest *r;